@@ -112,7 +112,7 @@ watch test_clfft(Context &ctx, cl_float2 *data, size_t n, size_t m, size_t runs,
         w.toc();
     }
 
-    if(dump_plan) std::cerr << fft.plan;
+    if(dump_plan) std::cerr << *fft.plan;
     return w;
 }
 
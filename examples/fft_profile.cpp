@@ -19,7 +19,7 @@ void profile(Context &ctx, std::vector<size_t> size) {
     for(size_t i = 0 ; i < repeats ; i++) {
         prof.tic_cl("init");
         FFT<cl_float2> fft(ctx, size);
-        fft.plan.profile = &prof;
+        fft.plan->profile = &prof;
         prof.toc("init");
         for(size_t j = 0 ; j < runs ; j++)
             b = fft(a);
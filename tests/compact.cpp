@@ -0,0 +1,156 @@
+#define BOOST_TEST_MODULE Compact
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+#include <vexcl/vector.hpp>
+#include <vexcl/compact.hpp>
+#include "context_setup.hpp"
+
+BOOST_AUTO_TEST_CASE(copy_if)
+{
+    const size_t n = 1000 * 1000;
+
+    std::vector<int> x = random_vector<int>(n);
+    vex::vector<int> X(ctx, x);
+    vex::vector<int> Y(ctx, n);
+
+    size_t m = vex::copy_if(2 * X, X > 50, Y);
+
+    std::vector<int> y;
+    for(size_t i = 0; i < n; ++i)
+        if (x[i] > 50) y.push_back(2 * x[i]);
+
+    BOOST_REQUIRE_EQUAL(m, y.size());
+
+    std::vector<int> z(n);
+    vex::copy(Y, z);
+
+    BOOST_CHECK(std::equal(y.begin(), y.end(), z.begin()));
+}
+
+BOOST_AUTO_TEST_CASE(remove_if)
+{
+    const size_t n = 1000 * 1000;
+
+    std::vector<double> x = random_vector<double>(n);
+    vex::vector<double> X(ctx, x);
+
+    size_t m = vex::remove_if(X, X < 0.25);
+
+    x.erase(std::remove_if(x.begin(), x.end(), [](double v) { return v < 0.25; }), x.end());
+
+    BOOST_REQUIRE_EQUAL(m, x.size());
+
+    std::vector<double> y(n);
+    vex::copy(X, y);
+
+    BOOST_CHECK(std::equal(x.begin(), x.end(), y.begin()));
+}
+
+BOOST_AUTO_TEST_CASE(partition)
+{
+    const size_t n = 1000 * 1000;
+
+    std::vector<int> x = random_vector<int>(n);
+    vex::vector<int> X(ctx, x);
+
+    size_t m = vex::partition(X, X % 3 == 0);
+
+    auto mid = std::stable_partition(x.begin(), x.end(), [](int v) { return v % 3 == 0; });
+
+    BOOST_CHECK_EQUAL(m, static_cast<size_t>(mid - x.begin()));
+
+    check_sample(X, [&](size_t idx, int v) { BOOST_CHECK_EQUAL(v, x[idx]); });
+}
+
+// Several queues on the same device partition the vectors, so that the
+// elements selected on one device are written into the partitions of the
+// others even with a single compute device.
+std::vector<vex::command_queue> partitioned_queues() {
+    std::vector<vex::command_queue> q;
+    q.push_back(ctx.queue(0));
+    q.push_back(vex::backend::duplicate_queue(ctx.queue(0)));
+    q.push_back(vex::backend::duplicate_queue(ctx.queue(0)));
+    return q;
+}
+
+BOOST_AUTO_TEST_CASE(partitioned_copy_if)
+{
+    std::vector<vex::command_queue> q = partitioned_queues();
+
+    // The smaller vector has partitions of a few elements.
+    const size_t sizes[] = {100 * 1000, 17};
+
+    for(size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); ++k) {
+        const size_t n = sizes[k];
+
+        std::vector<int> x = random_vector<int>(n);
+        vex::vector<int> X(q, x);
+        vex::vector<int> Y(q, n);
+
+        Y = -1;
+
+        size_t m = vex::copy_if(2 * X, X > 50, Y);
+
+        std::vector<int> y;
+        for(size_t i = 0; i < n; ++i)
+            if (x[i] > 50) y.push_back(2 * x[i]);
+
+        BOOST_REQUIRE_EQUAL(m, y.size());
+
+        std::vector<int> z(n);
+        vex::copy(Y, z);
+
+        BOOST_CHECK(std::equal(y.begin(), y.end(), z.begin()));
+
+        // Elements past the selected ones are left intact.
+        for(size_t i = m; i < n; ++i) BOOST_CHECK_EQUAL(z[i], -1);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(partitioned_partition)
+{
+    std::vector<vex::command_queue> q = partitioned_queues();
+
+    const size_t sizes[] = {100 * 1000, 17};
+
+    for(size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); ++k) {
+        const size_t n = sizes[k];
+
+        std::vector<int> x = random_vector<int>(n);
+        vex::vector<int> X(q, x);
+
+        size_t m = vex::partition(X, X % 3 == 0);
+
+        auto mid = std::stable_partition(x.begin(), x.end(), [](int v) { return v % 3 == 0; });
+
+        BOOST_REQUIRE_EQUAL(m, static_cast<size_t>(mid - x.begin()));
+
+        std::vector<int> y(n);
+        vex::copy(X, y);
+
+        BOOST_CHECK(std::equal(x.begin(), x.end(), y.begin()));
+    }
+}
+
+BOOST_AUTO_TEST_CASE(unique)
+{
+    const size_t n = 1000 * 1000;
+
+    std::vector<int> x = random_vector<int>(n);
+    std::sort(x.begin(), x.end());
+
+    vex::vector<int> X(ctx, x);
+
+    size_t m = vex::unique(X);
+
+    x.erase(std::unique(x.begin(), x.end()), x.end());
+
+    BOOST_REQUIRE_EQUAL(m, x.size());
+
+    std::vector<int> y(n);
+    vex::copy(X, y);
+
+    BOOST_CHECK(std::equal(x.begin(), x.end(), y.begin()));
+}
+
+BOOST_AUTO_TEST_SUITE_END()
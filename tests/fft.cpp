@@ -28,7 +28,7 @@ BOOST_AUTO_TEST_CASE(check_correctness)
     std::vector<cl::CommandQueue> queue(1, ctx.queue(0));
 
     vex::vector<cl_float>  in  (queue, N);
-    vex::vector<cl_float2> out (queue, N);
+    vex::vector<cl_float2> out (queue, N / 2 + 1);
     vex::vector<cl_float>  back(queue, N);
 
     vex::Random<cl_float> rnd;
@@ -46,6 +46,207 @@ BOOST_AUTO_TEST_CASE(check_correctness)
     BOOST_CHECK(std::sqrt(sum(pow(in - back, 2.0f)) / N) < 1e-3);
 }
 
+BOOST_AUTO_TEST_CASE(fused_kernel)
+{
+    const size_t batch = 16, N = 720;
+    std::vector<cl::CommandQueue> queue(1, ctx.queue(0));
+
+    vex::vector<cl_double2> in (queue, random_vector<cl_double2>(batch * N));
+    vex::vector<cl_double2> out(queue, batch * N);
+    vex::vector<cl_double2> ref(queue, batch * N);
+
+    vex::FFT<cl_double2> fused(queue, {batch, N}, {vex::fft::none, vex::fft::forward});
+    vex::FFT<cl_double2> multi(queue, {batch, N}, {vex::fft::none, vex::fft::forward},
+            vex::fft::planner(25, false));
+
+    out = fused(in);
+    ref = multi(in);
+
+    vex::Reductor<double, vex::SUM> sum(queue);
+
+    BOOST_CHECK_SMALL(std::sqrt(sum(dot(out - ref, out - ref)) / sum(dot(ref, ref))), 1e-8);
+}
+
+BOOST_AUTO_TEST_CASE(plan_cache)
+{
+    const size_t N = 1024;
+    std::vector<cl::CommandQueue> queue(1, ctx.queue(0));
+
+    const void *released;
+    {
+        vex::FFT<cl_double2> fft(queue, N);
+        released = fft.plan.get();
+    }
+
+    vex::FFT<cl_double2> fft1(queue, N);
+    vex::FFT<cl_double2> fft2(queue, N);
+
+    // Unused plan is reused, but live FFT objects do not share plans.
+    BOOST_CHECK_EQUAL(fft1.plan.get(), released);
+    BOOST_CHECK(fft2.plan != fft1.plan);
+
+    vex::vector<cl_double2> in (queue, random_vector<cl_double2>(N));
+    vex::vector<cl_double2> out(queue, N);
+
+    out = fft1(in) - fft2(in);
+
+    vex::Reductor<double, vex::SUM> sum(queue);
+    BOOST_CHECK_SMALL(sum(dot(out, out)), 1e-16);
+
+    // Measured plan gives the same result.
+    vex::FFT<cl_double2> fft3(queue, N, vex::fft::forward, vex::fft::planner(25, true, true));
+
+    out = fft1(in) - fft3(in);
+    BOOST_CHECK_SMALL(std::sqrt(sum(dot(out, out))) / N, 1e-8);
+}
+
+BOOST_AUTO_TEST_CASE(multi_device)
+{
+    std::vector<cl::CommandQueue> queue(1, ctx.queue(0));
+
+    // Several queues on the same device partition the vectors, so that the
+    // distributed transform is exercised even with a single compute device.
+    std::vector<cl::CommandQueue> q;
+    q.push_back(ctx.queue(0));
+    q.push_back(vex::backend::duplicate_queue(ctx.queue(0)));
+    // Blocks for a queue in another context are staged through host memory.
+    {
+        cl::Device dev = ctx.queue(0).getInfo<CL_QUEUE_DEVICE>();
+        q.push_back(cl::CommandQueue(cl::Context(dev), dev));
+    }
+
+    vex::Reductor<double, vex::SUM> sum(queue);
+
+    const size_t shapes[][2] = {{1, 1200}, {60, 45}};
+
+    for(size_t s = 0; s < 2; ++s) {
+        std::vector<size_t> n;
+        if (shapes[s][0] > 1) n.push_back(shapes[s][0]);
+        n.push_back(shapes[s][1]);
+
+        const size_t N = shapes[s][0] * shapes[s][1];
+
+        std::vector<cl_double2> x = random_vector<cl_double2>(N);
+
+        vex::vector<cl_double2> X(q, x);
+        vex::vector<cl_double2> Y(q, N);
+        vex::vector<cl_double2> Z(q, N);
+
+        vex::FFT<cl_double2> fft (q, n);
+        vex::FFT<cl_double2> ifft(q, n, vex::fft::inverse);
+
+        Y = fft(X);
+        Z = ifft(Y);
+
+        // Reference transform on a single device.
+        vex::vector<cl_double2> x1(queue, x);
+        vex::vector<cl_double2> y1(queue, N);
+        vex::FFT<cl_double2> fft1(queue, n);
+        y1 = fft1(x1);
+
+        std::vector<cl_double2> y(N);
+        vex::copy(Y, y);
+        vex::vector<cl_double2> y2(queue, y);
+
+        BOOST_CHECK_SMALL(std::sqrt(sum(dot(y2 - y1, y2 - y1)) / sum(dot(y1, y1))), 1e-8);
+
+        check_sample(Z, [&](size_t idx, cl_double2 v) {
+            BOOST_CHECK_SMALL(v.s[0] - x[idx].s[0], 1e-8);
+            BOOST_CHECK_SMALL(v.s[1] - x[idx].s[1], 1e-8);
+        });
+    }
+}
+
+BOOST_AUTO_TEST_CASE(fft_convolution)
+{
+    const size_t n = 100000;
+    std::vector<cl::CommandQueue> queue(1, ctx.queue(0));
+
+    std::vector<double> x = random_vector<double>(n);
+
+    vex::vector<double> X(queue, x);
+    vex::vector<double> Y(queue, n);
+    vex::vector<double> Z(queue, n);
+
+    vex::Reductor<double, vex::MAX> max(queue);
+
+    // Short filter is applied directly, long one with FFT.
+    const unsigned width[] = {7, 301};
+
+    for(size_t w = 0; w < 2; ++w) {
+        std::vector<double> f = random_vector<double>(width[w]);
+        const unsigned center = width[w] / 3;
+
+        vex::convolution<double> C(queue, f, center);
+
+        Y = C * X;
+
+        check_sample(Y, [&](size_t i, double v) {
+            double sum = 0;
+            for(size_t k = 0; k < f.size(); ++k) {
+                ptrdiff_t j = static_cast<ptrdiff_t>(i) - k + center;
+                j = std::min<ptrdiff_t>(n - 1, std::max<ptrdiff_t>(0, j));
+                sum += f[k] * x[j];
+            }
+            BOOST_CHECK_CLOSE(v, sum, 1e-6);
+        });
+
+        // Correlation is the same as the stencil.
+        vex::convolution<double> R(queue, f, center, vex::fft::correlate);
+        vex::stencil<double> S(queue, f, center);
+
+        Y = 2 * (R * X);
+        Z = 2 * (S * X);
+
+        BOOST_CHECK_SMALL(max(fabs(Y - Z)), 1e-8);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(half_spectrum)
+{
+    std::vector<cl::CommandQueue> queue(1, ctx.queue(0));
+
+    const size_t shapes[][2] = {{12, 16}, {9, 15}, {1, 30}};
+
+    for(size_t s = 0; s < 3; ++s) {
+        const size_t ny = shapes[s][0], nx = shapes[s][1], nh = nx / 2 + 1;
+        const size_t n  = ny * nx;
+
+        std::vector<double> x = random_vector<double>(n);
+
+        vex::vector<double>     in  (queue, x);
+        vex::vector<cl_double2> out (queue, ny * nh);
+        vex::vector<double>     back(queue, n);
+
+        vex::FFT<double, cl_double2> fft (queue, {ny, nx});
+        vex::FFT<cl_double2, double> ifft(queue, {ny, nx}, vex::fft::inverse);
+
+        out  = fft (in );
+        back = ifft(out);
+
+        check_sample(out, [&](size_t idx, cl_double2 v) {
+            const size_t ky = idx / nh, kx = idx % nh;
+
+            double re = 0, im = 0;
+            for(size_t i = 0; i < ny; ++i)
+                for(size_t j = 0; j < nx; ++j) {
+                    double phi = -2 * M_PI * (
+                            static_cast<double>(ky * i % ny) / ny +
+                            static_cast<double>(kx * j % nx) / nx);
+                    re += x[i * nx + j] * cos(phi);
+                    im += x[i * nx + j] * sin(phi);
+                }
+
+            BOOST_CHECK_SMALL(v.s[0] - re, 1e-8);
+            BOOST_CHECK_SMALL(v.s[1] - im, 1e-8);
+        });
+
+        check_sample(back, [&](size_t idx, double v) {
+            BOOST_CHECK_CLOSE(v, x[idx], 1e-8);
+        });
+    }
+}
+
 #ifdef HAVE_FFTW
 
 void test(const vex::Context &ctx, std::vector<size_t> ns, size_t batch) {
@@ -80,6 +80,159 @@ BOOST_AUTO_TEST_CASE(kernel_generator_with_user_function)
             BOOST_CHECK_CLOSE(y, sin(x) * sin(x), 1e-8);
             });
 }
+
+BOOST_AUTO_TEST_CASE(kernel_save_load)
+{
+    typedef vex::symbolic<double> sym_state;
+
+    const size_t n  = 1024;
+
+    std::ostringstream body;
+    vex::generator::set_recorder(body);
+
+    sym_state sym_x(sym_state::VectorParameter, sym_state::Const);
+    sym_state sym_y(sym_state::VectorParameter);
+
+    VEX_FUNCTION(sin2, double(double), "double s = sin(prm1); return s * s;");
+
+    sym_y = sin2(sym_x);
+
+    std::stringstream saved;
+    vex::generator::build_kernel(
+            ctx, "test_saved", body.str(), sym_x, sym_y).save(saved);
+
+    std::string format = saved.str();
+
+    vex::generator::Kernel<2> kernel(ctx, saved);
+
+    vex::vector<double> X(ctx, random_vector<double>(n));
+    vex::vector<double> Y(ctx, n);
+
+    kernel(X, Y);
+
+    check_sample(X, Y, [&](size_t, double x, double y) {
+            BOOST_CHECK_CLOSE(y, sin(x) * sin(x), 1e-8);
+            });
+
+    // Arguments are checked against the saved parameter types.
+    vex::vector<float> F(ctx, n);
+    BOOST_CHECK_THROW(kernel(X, F), std::runtime_error);
+
+    // Wrong number of parameters.
+    {
+        std::istringstream is(format);
+        BOOST_CHECK_THROW((vex::generator::Kernel<3>(ctx, is)), std::runtime_error);
+    }
+
+    // Unknown format version.
+    {
+        std::string unknown = format;
+        unknown.replace(0, format.find('\n'), "vexcl-generator-kernel 0 2");
+
+        std::istringstream is(unknown);
+        BOOST_CHECK_THROW((vex::generator::Kernel<2>(ctx, is)), std::runtime_error);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(kernel_control_flow)
+{
+    typedef vex::symbolic<double> sym_state;
+    typedef vex::symbolic<int>    sym_int;
+
+    const size_t n  = 1024;
+
+    std::ostringstream body;
+    vex::generator::set_recorder(body);
+
+    sym_state sym_x(sym_state::VectorParameter, sym_state::Const);
+    sym_state sym_y(sym_state::VectorParameter);
+    sym_int   sym_m(sym_int::ScalarParameter);
+
+    // Newton iterations for square root with a data-dependent stop.
+    sym_state s;
+    sym_int   i;
+
+    s = sym_x;
+
+    vex::generator::if_(sym_x > 0.0);
+        vex::generator::for_(i, 0, sym_m);
+            vex::generator::if_(fabs(s * s - sym_x) < 1e-12 * sym_x);
+                vex::generator::break_();
+            vex::generator::end_if();
+
+            s = 0.5 * (s + sym_x / s);
+        vex::generator::end_for();
+    vex::generator::else_();
+        s = 0.0;
+    vex::generator::end_if();
+
+    sym_y = if_else(s > 1.0, s, 1.0);
+
+    auto kernel = vex::generator::build_kernel(
+            ctx, "newton_sqrt", body.str(), sym_x, sym_y, sym_m);
+
+    std::vector<double> x = random_vector<double>(n);
+    for(size_t j = 0; j < n; ++j) x[j] = 100 * x[j] - 10;
+
+    vex::vector<double> X(ctx, x);
+    vex::vector<double> Y(ctx, n);
+
+    kernel(X, Y, 100);
+
+    check_sample(X, Y, [&](size_t, double a, double b) {
+            BOOST_CHECK_CLOSE(b, std::max(a > 0 ? sqrt(a) : 0.0, 1.0), 1e-8);
+            });
+}
+
+BOOST_AUTO_TEST_CASE(kernel_reduction)
+{
+    typedef vex::symbolic<double> sym_state;
+
+    const size_t n  = 1024;
+    const double dt = 0.01;
+
+    std::ostringstream body;
+    vex::generator::set_recorder(body);
+
+    sym_state sym_x(sym_state::VectorParameter);
+    sym_state old;
+
+    vex::symbolic_reduction<double, vex::MAX> sym_err;
+    vex::symbolic_reduction<double, vex::SUM> sym_sum;
+
+    old = sym_x;
+    runge_kutta_2(sys_func<sym_state>, sym_x, dt);
+
+    sym_err = fabs(sym_x - old);
+    sym_sum = sym_x;
+
+    auto kernel = vex::generator::build_kernel(
+            ctx, "rk2_reduce", body.str(), sym_x, sym_err, sym_sum);
+
+    std::vector<double> x = random_vector<double>(n);
+    vex::vector<double> X(ctx, x);
+
+    double err = 0, sum = 0;
+    kernel(X, &err, &sum);
+
+    double host_err = 0, host_sum = 0;
+    for(size_t i = 0; i < n; ++i) {
+        double s = x[i];
+        runge_kutta_2(sys_func<double>, s, dt);
+
+        host_err  = std::max(host_err, fabs(s - x[i]));
+        host_sum += s;
+    }
+
+    BOOST_CHECK_CLOSE(err, host_err, 1e-8);
+    BOOST_CHECK_CLOSE(sum, host_sum, 1e-8);
+
+    // Results are only accepted through pointers of the reduction type.
+    float ferr;
+    BOOST_CHECK_THROW(kernel(X, &ferr, &sum), std::runtime_error);
+    BOOST_CHECK_THROW(kernel(X, X, &sum), std::runtime_error);
+}
+
 BOOST_AUTO_TEST_CASE(function_generator)
 {
     typedef vex::symbolic<double> sym_state;
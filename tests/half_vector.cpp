@@ -0,0 +1,80 @@
+#define BOOST_TEST_MODULE HalfVector
+#include <cmath>
+#include <limits>
+#include <boost/test/unit_test.hpp>
+#include <vexcl/vector.hpp>
+#include <vexcl/reductor.hpp>
+#include <vexcl/half_vector.hpp>
+#include "context_setup.hpp"
+
+BOOST_AUTO_TEST_CASE(half_conversion)
+{
+    const float inf = std::numeric_limits<float>::infinity();
+
+    BOOST_CHECK_EQUAL(vex::float_to_half(0.0f),    0x0000);
+    BOOST_CHECK_EQUAL(vex::float_to_half(-0.0f),   0x8000);
+    BOOST_CHECK_EQUAL(vex::float_to_half(1.0f),    0x3c00);
+    BOOST_CHECK_EQUAL(vex::float_to_half(-2.0f),   0xc000);
+    BOOST_CHECK_EQUAL(vex::float_to_half(65504.0f), 0x7bff);
+    BOOST_CHECK_EQUAL(vex::float_to_half(1e6f),    0x7c00);
+    BOOST_CHECK_EQUAL(vex::float_to_half(inf),     0x7c00);
+    BOOST_CHECK_EQUAL(vex::float_to_half(std::ldexp(1.0f, -24)), 0x0001);
+
+    // Ties are rounded to even.
+    BOOST_CHECK_EQUAL(vex::float_to_half(1.0f + std::ldexp(1.0f, -11)), 0x3c00);
+    BOOST_CHECK_EQUAL(vex::float_to_half(1.0f + 3 * std::ldexp(1.0f, -11)), 0x3c02);
+
+    for(unsigned h = 0; h < 0x7c00; ++h) {
+        cl_half v = static_cast<cl_half>(h);
+        BOOST_REQUIRE_EQUAL(vex::float_to_half(vex::half_to_float(v)), v);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(half_expressions)
+{
+    const size_t n = 1024;
+
+    std::vector<float> x = random_vector<float>(n);
+
+    vex::half_vector  X(ctx, x);
+    vex::vector<float> Y(ctx, n);
+
+    // Host copy of the stored values.
+    std::vector<float> h(n);
+    vex::copy(X, h);
+
+    check_sample(x, h, [](size_t, float a, float b) {
+            BOOST_CHECK_CLOSE(a, b, 0.1);
+            });
+
+    Y = 2 * X + 1;
+
+    check_sample(Y, [&](size_t i, float a) {
+            BOOST_CHECK_CLOSE(a, 2 * h[i] + 1, 1e-4);
+            });
+
+    X = sin(Y);
+    vex::copy(X, h);
+
+    check_sample(Y, [&](size_t i, float a) {
+            BOOST_CHECK_EQUAL(h[i], vex::half_to_float(vex::float_to_half(std::sin(a))));
+            });
+
+    X += 1;
+
+    std::vector<float> h1(n);
+    vex::copy(X, h1);
+
+    check_sample(h1, [&](size_t i, float a) {
+            BOOST_CHECK_EQUAL(a, vex::half_to_float(vex::float_to_half(h[i] + 1)));
+            });
+
+    vex::Reductor<float, vex::SUM> sum(ctx);
+
+    float s = 0;
+    for(size_t i = 0; i < n; ++i) s += h1[i];
+
+    BOOST_CHECK_CLOSE(sum(X), s, 1e-3);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,67 @@
+#define BOOST_TEST_MODULE BitMask
+#include <boost/test/unit_test.hpp>
+#include <vexcl/vector.hpp>
+#include <vexcl/mask.hpp>
+#include "context_setup.hpp"
+
+BOOST_AUTO_TEST_CASE(mask_from_expression)
+{
+    const size_t n = 1000 * 1000 + 7;
+
+    std::vector<double> x = random_vector<double>(n);
+    std::vector<double> y = random_vector<double>(n);
+
+    vex::vector<double> X(ctx, x);
+    vex::vector<double> Y(ctx, y);
+
+    vex::mask m(ctx, n);
+
+    BOOST_CHECK(m.none());
+
+    m = X > Y;
+
+    size_t count = 0;
+    for(size_t i = 0; i < n; ++i) if (x[i] > y[i]) ++count;
+
+    BOOST_CHECK_EQUAL(m.count(), count);
+
+    m = X == X;
+    BOOST_CHECK(m.all());
+    BOOST_CHECK(m.any());
+
+    // Copies share the mask words, and see the changes made through m.
+    vex::mask c = m;
+    m = X > Y;
+    BOOST_CHECK_EQUAL(c.count(), count);
+}
+
+BOOST_AUTO_TEST_CASE(masked_assignment)
+{
+    const size_t n = 1024;
+
+    std::vector<double> x = random_vector<double>(n);
+    std::vector<double> y = random_vector<double>(n);
+
+    vex::vector<double> X(ctx, x);
+    vex::vector<double> Y(ctx, y);
+
+    vex::mask m(ctx, n);
+
+    m = X > Y;
+    m(X) = sqrt(X - Y);
+
+    check_sample(X, [&](size_t i, double a) {
+            if (x[i] > y[i])
+                BOOST_CHECK_CLOSE(a, sqrt(x[i] - y[i]), 1e-8);
+            else
+                BOOST_CHECK_EQUAL(a, x[i]);
+            });
+
+    m(Y) += 1;
+
+    check_sample(Y, [&](size_t i, double a) {
+            BOOST_CHECK_EQUAL(a, x[i] > y[i] ? y[i] + 1 : y[i]);
+            });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
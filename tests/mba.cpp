@@ -4,7 +4,11 @@
 #include <vexcl/vector.hpp>
 #include <vexcl/element_index.hpp>
 #include <vexcl/temporary.hpp>
+#include <vexcl/reductor.hpp>
 #include "context_setup.hpp"
+#ifdef _OPENMP
+#  include <omp.h>
+#endif
 
 template <typename T>
 inline std::array<T, 2> make_array(T x,  T y) {
@@ -61,4 +65,97 @@ BOOST_AUTO_TEST_CASE(mba)
 
 }
 
+BOOST_AUTO_TEST_CASE(mba_append)
+{
+    std::vector< std::array<double,2> > p;
+
+    p.push_back(make_array<double>(0.0, 0.0));
+    p.push_back(make_array<double>(0.0, 1.0));
+    p.push_back(make_array<double>(1.0, 0.0));
+    p.push_back(make_array<double>(1.0, 1.0));
+    p.push_back(make_array<double>(0.4, 0.4));
+
+    std::vector<double> v;
+
+    v.push_back( 0.2);
+    v.push_back( 0.0);
+    v.push_back( 0.0);
+    v.push_back(-0.2);
+    v.push_back(-1.0);
+
+    vex::mba<2> cloud(ctx,
+            make_array<double>(-0.01, -0.01),
+            make_array<double>( 1.01,  1.01),
+            p, v, make_array<size_t>(2, 2), 8, 1e-8, true
+            );
+
+    std::vector< std::array<double,2> > q(1, make_array<double>(0.6, 0.6));
+    std::vector<double> w(1, 1.0);
+
+    cloud.append(q, w);
+
+    const size_t n = 11;
+    vex::vector<double> z(ctx, n);
+
+    auto t = vex::make_temp<1>(1.0 * vex::element_index() / (n - 1.0));
+
+    z = cloud(t, t);
+
+    BOOST_CHECK_CLOSE(static_cast<double>(z[ 0]),  0.2, 1e-6);
+    BOOST_CHECK_CLOSE(static_cast<double>(z[ 4]), -1.0, 5.0);
+    BOOST_CHECK_CLOSE(static_cast<double>(z[ 6]),  1.0, 5.0);
+    BOOST_CHECK_CLOSE(static_cast<double>(z[10]), -0.2, 1e-6);
+}
+
+BOOST_AUTO_TEST_CASE(mba_thread_count)
+{
+    // The lattices are split between threads. The result should not depend
+    // on the number of threads.
+    const size_t np = 10000;
+
+    std::vector< std::array<double,2> > p(np);
+    std::vector<double> v(np);
+
+    for(size_t i = 0; i < np; ++i) {
+        p[i] = make_array<double>(1.0 * rand() / RAND_MAX, 1.0 * rand() / RAND_MAX);
+        v[i] = sin(6 * p[i][0]) * cos(4 * p[i][1]);
+    }
+
+    const size_t n = 1024;
+    vex::vector<double> x(ctx, n);
+    vex::vector<double> y(ctx, n);
+
+    x = 1.0 * vex::element_index() / (n - 1.0);
+    y = 1.0 - x * x;
+
+#ifdef _OPENMP
+    const int nt = omp_get_max_threads();
+    omp_set_num_threads(4);
+#endif
+
+    vex::mba<2> par(ctx,
+            make_array<double>(-0.01, -0.01),
+            make_array<double>( 1.01,  1.01),
+            p, v, make_array<size_t>(3, 3)
+            );
+
+#ifdef _OPENMP
+    omp_set_num_threads(1);
+#endif
+
+    vex::mba<2> seq(ctx,
+            make_array<double>(-0.01, -0.01),
+            make_array<double>( 1.01,  1.01),
+            p, v, make_array<size_t>(3, 3)
+            );
+
+#ifdef _OPENMP
+    omp_set_num_threads(nt);
+#endif
+
+    vex::Reductor<double, vex::MAX> max(ctx);
+
+    BOOST_CHECK_SMALL(max(fabs(par(x, y) - seq(x, y))), 1e-8);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -1,6 +1,7 @@
 #define BOOST_TEST_MODULE MultivectorCreate
 #include <boost/test/unit_test.hpp>
 #include <vexcl/multivector.hpp>
+#include <vexcl/vector_io.hpp>
 #include "context_setup.hpp"
 
 
@@ -87,4 +88,28 @@ BOOST_AUTO_TEST_CASE(stl_container_of_multivector)
     }
 }
 
+BOOST_AUTO_TEST_CASE(save_load)
+{
+    const size_t N = 1024;
+    const std::string fname = "vexcl_save_load_mv.bin";
+
+    std::vector<double> x = random_vector<double>(N);
+    std::vector<double> y = random_vector<double>(N);
+
+    vex::multivector<double, 2> X(ctx, N);
+    vex::copy(x, X(0));
+    vex::copy(y, X(1));
+
+    vex::save(X, fname);
+
+    vex::multivector<double, 2> Y(ctx, 1);
+    vex::load(Y, fname);
+
+    BOOST_CHECK_EQUAL(Y.size(), N);
+    check_sample(Y(0), x, [](size_t, double a, double b) { BOOST_CHECK(a == b); });
+    check_sample(Y(1), y, [](size_t, double a, double b) { BOOST_CHECK(a == b); });
+
+    std::remove(fname.c_str());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,96 @@
+#define BOOST_TEST_MODULE OutOfCoreVector
+#include <numeric>
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+#include <vexcl/vector.hpp>
+#include <vexcl/reductor.hpp>
+#include <vexcl/ooc_vector.hpp>
+#include "context_setup.hpp"
+
+BOOST_AUTO_TEST_CASE(ooc_assign)
+{
+    const size_t n    = 100000;
+    const size_t tile = 7777; // The last tile is incomplete.
+
+    std::vector<double> x = random_vector<double>(n);
+    std::vector<double> y = random_vector<double>(n);
+
+    vex::ooc_vector<double> X(ctx, n, x.data(), tile);
+    vex::ooc_vector<double> Y(ctx, n, tile);
+
+    std::copy(y.begin(), y.end(), Y.data());
+
+    Y = 2 * sin(X) + Y;
+
+    check_sample(x, y, [&](size_t i, double a, double b) {
+            BOOST_CHECK_CLOSE(Y.data()[i], 2 * sin(a) + b, 1e-8);
+            });
+
+    std::vector<double> x0 = x;
+
+    X += 1;
+
+    check_sample(x0, [&](size_t i, double a) {
+            BOOST_CHECK_CLOSE(x[i], a + 1, 1e-8);
+            });
+
+    Y = X;
+
+    BOOST_CHECK(std::equal(x.begin(), x.end(), Y.data()));
+}
+
+BOOST_AUTO_TEST_CASE(ooc_assign_small_tiles)
+{
+    // The output is not an input, so nothing but the download events keeps
+    // the computation from overwriting a slot that is still being read.
+    const size_t n    = 100000;
+    const size_t tile = 1000;
+
+    std::vector<double> x = random_vector<double>(n);
+
+    vex::ooc_vector<double> X(ctx, n, x.data(), tile);
+    vex::ooc_vector<double> Y(ctx, n, tile);
+
+    Y = 2 * sin(X);
+
+    for(size_t i = 0; i < n; ++i)
+        BOOST_REQUIRE_CLOSE(Y.data()[i], 2 * sin(x[i]), 1e-8);
+
+    Y = X;
+
+    BOOST_CHECK(std::equal(x.begin(), x.end(), Y.data()));
+}
+
+BOOST_AUTO_TEST_CASE(ooc_reduce)
+{
+    const size_t n    = 100000;
+    const size_t tile = 10000;
+
+    std::vector<double> x = random_vector<double>(n);
+    std::vector<double> y = random_vector<double>(n);
+
+    vex::ooc_vector<double> X(ctx, n, x.data(), tile);
+    vex::ooc_vector<double> Y(ctx, n, y.data(), tile);
+
+    vex::Reductor<double, vex::SUM> sum(ctx);
+    vex::Reductor<double, vex::MAX> max(ctx);
+
+    BOOST_CHECK_CLOSE(vex::ooc_reduce(sum, X * Y),
+            std::inner_product(x.begin(), x.end(), y.begin(), 0.0), 1e-8);
+
+    BOOST_CHECK_EQUAL(vex::ooc_reduce(max, X),
+            *std::max_element(x.begin(), x.end()));
+
+    // Regular vectors are combined with every tile.
+    vex::vector<double> W(ctx, tile);
+    W = 2;
+
+    BOOST_CHECK_CLOSE(vex::ooc_reduce(sum, X * W),
+            2 * std::accumulate(x.begin(), x.end(), 0.0), 1e-8);
+
+    vex::vector<double> Z(ctx, n);
+    BOOST_CHECK_THROW(vex::ooc_reduce(sum, X * Z), std::runtime_error);
+    BOOST_CHECK_THROW(Y = X * Z, std::runtime_error);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
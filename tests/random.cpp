@@ -74,5 +74,54 @@ BOOST_AUTO_TEST_CASE(monte_carlo_pi)
     BOOST_CHECK_CLOSE(pi, boost::math::constants::pi<double>(), 0.5);
 }
 
+#if defined(VEXCL_BACKEND_OPENCL)
+BOOST_AUTO_TEST_CASE(random_streams)
+{
+    const size_t N = 1 << 20;
+    const cl_ulong seed = std::rand();
+
+    vex::Reductor<size_t, vex::SUM> sumi(ctx);
+    vex::Reductor<double, vex::SUM> sumd(ctx);
+
+    vex::RandomStream<double> rnd;
+    vex::vector<double> x(ctx, N);
+
+    // Each element has its own substream.
+    x = rnd(vex::element_index(), seed, 42);
+
+    BOOST_CHECK(sumi(x > 1) == 0);
+    BOOST_CHECK(sumi(x < 0) == 0);
+    BOOST_CHECK(std::abs(sumd(x) / N - 0.5) < 1e-2);
+
+    vex::RandomNormalStream<float> nrm;
+    vex::vector<float> z(ctx, N);
+    z = nrm(vex::element_index(), seed, 42);
+
+    BOOST_CHECK(std::abs(sumd(z) / N) < 1e-2);
+
+    // Bulk fill agrees with itself when skipping ahead.
+    vex::vector<float> y(ctx, N);
+    vex::vector<float> w(ctx, N / 2 + 3);
+
+    vex::fill_random(y, seed);
+    vex::fill_random(w, seed, N / 4 + 1);
+
+    BOOST_CHECK(sumi(y > 1) == 0);
+    BOOST_CHECK(sumi(y < 0) == 0);
+    BOOST_CHECK(std::abs(sumd(y) / N - 0.5) < 1e-2);
+
+    std::vector<float> yh(N), wh(w.size());
+    vex::copy(y, yh);
+    vex::copy(w, wh);
+
+    BOOST_CHECK(std::equal(wh.begin(), wh.end(), yh.begin() + N / 4 + 1));
+
+    vex::fill_random_normal<vex::random::threefry>(x, seed, 0, 7);
+
+    BOOST_CHECK(std::abs(sumd(x) / N) < 1e-2);
+    BOOST_CHECK(std::abs(sumd(fabs(x)) / N - std::sqrt(2 / boost::math::constants::pi<double>())) < 1e-2);
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
 
@@ -0,0 +1,81 @@
+#define BOOST_TEST_MODULE RecordVector
+#include <algorithm>
+#include <boost/test/unit_test.hpp>
+#include <vexcl/vector.hpp>
+#include <vexcl/element_index.hpp>
+#include <vexcl/sort.hpp>
+#include <vexcl/record_vector.hpp>
+#include "context_setup.hpp"
+
+BOOST_AUTO_TEST_CASE(record_assign)
+{
+    const size_t n = 1024;
+
+    std::vector<double> x = random_vector<double>(n);
+    std::vector<int>    i = random_vector<int>(n);
+
+    vex::vector<double> X(ctx, x);
+    vex::vector<int>    I(ctx, i);
+
+    vex::record_vector<double, float, int> p(ctx, n);
+
+    BOOST_CHECK_EQUAL(p.size(), n);
+
+    p = std::tie(X, 2 * X, I);
+
+    check_sample(p.field<0>(), [&](size_t idx, double v) { BOOST_CHECK_EQUAL(v, x[idx]); });
+    check_sample(p.field<1>(), [&](size_t idx, float  v) { BOOST_CHECK_CLOSE(v, 2 * x[idx], 1e-4); });
+    check_sample(p.field<2>(), [&](size_t idx, int    v) { BOOST_CHECK_EQUAL(v, i[idx]); });
+
+    p.field<0>() += p.field<1>();
+
+    vex::record_vector<double, float, int> q(p);
+
+    check_sample(q.field<0>(), [&](size_t idx, double v) { BOOST_CHECK_CLOSE(v, 3 * x[idx], 1e-4); });
+    check_sample(q.field<2>(), [&](size_t idx, int    v) { BOOST_CHECK_EQUAL(v, i[idx]); });
+}
+
+BOOST_AUTO_TEST_CASE(record_permutation)
+{
+    const size_t n = 1024;
+
+    std::vector<vex::command_queue> queue(1, ctx.queue(0));
+
+    std::vector<double> x = random_vector<double>(n);
+    std::vector<int>    i = random_vector<int>(n);
+
+    vex::record_vector<double, int> p(queue, n);
+    vex::record_vector<double, int> q(queue, n);
+
+    vex::copy(x, p.field<0>());
+    vex::copy(i, p.field<1>());
+
+    q = p.permuted(n - 1 - vex::element_index());
+
+    check_sample(q.field<0>(), [&](size_t idx, double v) { BOOST_CHECK_EQUAL(v, x[n - 1 - idx]); });
+    check_sample(q.field<1>(), [&](size_t idx, int    v) { BOOST_CHECK_EQUAL(v, i[n - 1 - idx]); });
+}
+
+BOOST_AUTO_TEST_CASE(record_sort_by_key)
+{
+    const size_t n = 1000 * 1000;
+
+    std::vector<int>    k = random_vector<int>(n);
+    std::vector<double> x(n);
+
+    std::transform(k.begin(), k.end(), x.begin(), [](int v) { return 0.5 * v; });
+
+    vex::vector<int> keys(ctx, k);
+    vex::record_vector<double, int> p(ctx, n);
+
+    p = std::tie(0.5 * keys, keys);
+
+    vex::sort_by_key(keys, p.fields(), vex::less<int>());
+
+    std::sort(k.begin(), k.end());
+
+    check_sample(p.field<0>(), [&](size_t idx, double v) { BOOST_CHECK_EQUAL(v, 0.5 * k[idx]); });
+    check_sample(p.field<1>(), [&](size_t idx, int    v) { BOOST_CHECK_EQUAL(v, k[idx]); });
+}
+
+BOOST_AUTO_TEST_SUITE_END()
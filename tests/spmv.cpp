@@ -85,6 +85,42 @@ BOOST_AUTO_TEST_CASE(non_square_matrix)
             });
 }
 
+BOOST_AUTO_TEST_CASE(transposed_product)
+{
+    const size_t n = 1024;
+    const size_t m = 2 * n;
+
+    std::vector<size_t> row;
+    std::vector<size_t> col;
+    std::vector<double> val;
+
+    random_matrix(n, m, 16, row, col, val);
+
+    std::vector<double> x = random_vector<double>(n);
+
+    // Reference: y = A^T x.
+    std::vector<double> y(m, 0.0);
+    for(size_t i = 0; i < n; i++)
+        for(size_t j = row[i]; j < row[i + 1]; j++)
+            y[col[j]] += val[j] * x[i];
+
+    vex::SpMat <double> A(ctx, n, m, row.data(), col.data(), val.data());
+    vex::vector<double> X(ctx, x);
+    vex::vector<double> Y(ctx, m);
+
+    Y = vex::transpose(A) * X;
+
+    check_sample(Y, [&](size_t idx, double a) {
+            BOOST_CHECK_CLOSE(a, y[idx], 1e-8);
+            });
+
+    Y -= 2 * (vex::transpose(A) * X);
+
+    check_sample(Y, [&](size_t idx, double a) {
+            BOOST_CHECK_CLOSE(a, -y[idx], 1e-8);
+            });
+}
+
 BOOST_AUTO_TEST_CASE(non_default_types)
 {
     const size_t n = 1024;
@@ -181,6 +181,192 @@ BOOST_AUTO_TEST_CASE(big_stencil)
     });
 }
 
+BOOST_AUTO_TEST_CASE(repeated_stencil)
+{
+    const size_t n = 1024;
+    const unsigned steps = 8;
+
+    std::vector<double> s = random_vector<double>(rand() % 8 + 1);
+    for(auto v = s.begin(); v != s.end(); ++v) *v /= s.size();
+
+    int center = rand() % s.size();
+
+    vex::stencil<double> S(ctx, s, center);
+
+    std::vector<double> x = random_vector<double>(n);
+
+    vex::vector<double> X(ctx, x);
+    vex::vector<double> Y(ctx, n);
+
+    Y = 1;
+    Y += vex::repeat(S, steps) * X;
+
+    index idx(n);
+
+    std::vector<double> z = x;
+    for(unsigned k = 0; k < steps; ++k) {
+        std::vector<double> t(n);
+        for(size_t i = 0; i < n; ++i) {
+            size_t j = 0;
+            int c = -center;
+            for(; j < s.size(); c++, j++)
+                t[i] += s[j] * z[idx(i, c)];
+        }
+        z.swap(t);
+    }
+
+    check_sample(Y, [&](size_t i, double a) {
+        BOOST_CHECK_CLOSE(a, 1 + z[i], 1e-8);
+    });
+
+    S.apply_repeated(X, Y, steps, 2);
+
+    check_sample(Y, [&](size_t i, double a) {
+        BOOST_CHECK_CLOSE(a, 2 * z[i], 1e-8);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(partitioned_stencil)
+{
+    // Several queues on the same device partition the vectors, so that the
+    // halo exchange and the interior/boundary split are exercised even with
+    // a single compute device.
+    std::vector<vex::command_queue> q;
+    q.push_back(ctx.queue(0));
+    q.push_back(vex::backend::duplicate_queue(ctx.queue(0)));
+#if defined(VEXCL_BACKEND_OPENCL)
+    // Halos from a queue in another context are staged through host memory.
+    {
+        cl::Device dev = ctx.queue(0).getInfo<CL_QUEUE_DEVICE>();
+        q.push_back(cl::CommandQueue(cl::Context(dev), dev));
+    }
+#endif
+    q.push_back(vex::backend::duplicate_queue(ctx.queue(0)));
+
+    std::vector<double> s = random_vector<double>(rand() % 8 + 1);
+    for(auto v = s.begin(); v != s.end(); ++v) *v /= s.size();
+
+    int center = rand() % s.size();
+
+    vex::stencil<double> S(q, s, center);
+
+    // Partitions of the smaller vector are narrower than the halos.
+    const size_t sizes[] = {1024, 16};
+
+    for(size_t k = 0; k < sizeof(sizes) / sizeof(sizes[0]); ++k) {
+        const size_t n = sizes[k];
+
+        index idx(n);
+
+        auto apply = [&](const std::vector<double> &z, unsigned steps) {
+            std::vector<double> y = z;
+            for(unsigned t = 0; t < steps; ++t) {
+                std::vector<double> u(n, 0.0);
+                for(size_t i = 0; i < n; ++i) {
+                    size_t j = 0;
+                    int c = -center;
+                    for(; j < s.size(); c++, j++)
+                        u[i] += s[j] * y[idx(i, c)];
+                }
+                y.swap(u);
+            }
+            return y;
+        };
+
+        std::vector<double> x = random_vector<double>(n);
+
+        vex::vector<double> X(q, x);
+        vex::vector<double> Y(q, n);
+
+        std::vector<double> y(n);
+
+        auto check = [&](const std::vector<double> &z, double scale) {
+            vex::copy(Y, y);
+            for(size_t i = 0; i < n; ++i)
+                BOOST_CHECK_CLOSE(y[i], scale * z[i], 1e-8);
+        };
+
+        Y = X * S;
+        check(apply(x, 1), 1);
+
+        Y = vex::repeat(S, 4) * X;
+        check(apply(x, 4), 1);
+
+        // Alternate the number of steps.
+        S.apply_repeated(X, Y, 3, 2);
+        check(apply(x, 3), 2);
+
+        S.apply_repeated(X, Y, 4, 2);
+        check(apply(x, 4), 2);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(grid_stencil_2d)
+{
+    const size_t nx = 100, ny = 75, n = nx * ny;
+
+    std::vector<double> s = random_vector<double>(15);
+
+    vex::grid_stencil<double, 2> S(ctx, {ny, nx}, {3, 5}, {1, 3}, s);
+
+    std::vector<double> x = random_vector<double>(n);
+
+    vex::vector<double> X(ctx, x);
+    vex::vector<double> Y(ctx, n);
+
+    Y = 1;
+    Y += S * X;
+
+    index ix(nx), iy(ny);
+
+    check_sample(Y, [&](size_t idx, double a) {
+        size_t i = idx % nx;
+        size_t j = idx / nx;
+
+        double sum = 1;
+        for(int jj = 0, p = 0; jj < 3; ++jj)
+            for(int ii = 0; ii < 5; ++ii, ++p)
+                sum += s[p] * x[iy(j, jj - 1) * nx + ix(i, ii - 3)];
+
+        BOOST_CHECK_CLOSE(a, sum, 1e-8);
+    });
+}
+
+BOOST_AUTO_TEST_CASE(grid_stencil_3d)
+{
+    const size_t nx = 33, ny = 20, nz = 17, n = nx * ny * nz;
+
+    vex::grid_stencil<double, 3> S(ctx, {nz, ny, nx}, {3, 3, 3}, {1, 1, 1}, {
+            0,  0,  0,    0,  1,  0,    0,  0,  0,
+            0,  1,  0,    1, -6,  1,    0,  1,  0,
+            0,  0,  0,    0,  1,  0,    0,  0,  0
+            });
+
+    std::vector<double> x = random_vector<double>(n);
+
+    vex::vector<double> X(ctx, x);
+    vex::vector<double> Y(ctx, n);
+
+    Y = 42 * (S * X);
+
+    index ix(nx), iy(ny), iz(nz);
+
+    check_sample(Y, [&](size_t idx, double a) {
+        size_t i = idx % nx;
+        size_t j = (idx / nx) % ny;
+        size_t k = idx / (nx * ny);
+
+        auto X = [&](long di, long dj, long dk) {
+            return x[(iz(k, dk) * ny + iy(j, dj)) * nx + ix(i, di)];
+        };
+
+        double sum = X(-1, 0, 0) + X(1, 0, 0) + X(0, -1, 0) + X(0, 1, 0)
+                   + X(0, 0, -1) + X(0, 0, 1) - 6 * X(0, 0, 0);
+
+        BOOST_CHECK_CLOSE(a, 42 * sum, 1e-8);
+    });
+}
+
 BOOST_AUTO_TEST_CASE(user_defined_stencil)
 {
     const size_t n = 1024;
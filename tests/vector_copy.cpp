@@ -1,7 +1,13 @@
 #define BOOST_TEST_MODULE VectorCopy
+#include <numeric>
+#include <algorithm>
 #include <boost/test/unit_test.hpp>
 #include <vexcl/vector.hpp>
 #include <vexcl/gather.hpp>
+#include <vexcl/vector_io.hpp>
+#if defined(VEXCL_BACKEND_OPENCL)
+#  include <vexcl/transfer.hpp>
+#endif
 #include "context_setup.hpp"
 
 BOOST_AUTO_TEST_CASE(iterate_over_vector)
@@ -91,6 +97,59 @@ BOOST_AUTO_TEST_CASE(gather)
         BOOST_CHECK(data[p] == x[i[p]]);
 }
 
+BOOST_AUTO_TEST_CASE(gather_async_scatter)
+{
+    const size_t n = 1 << 20;
+    const size_t m = 100;
+
+    std::vector<double> x = random_vector<double>(n);
+    vex::vector<double> X(ctx, x);
+
+    std::vector<size_t> i(m);
+    std::generate(i.begin(), i.end(), [n](){ return rand() % n; });
+    std::sort(i.begin(), i.end());
+    i.resize( std::unique(i.begin(), i.end()) - i.begin() );
+
+    vex::gather<double>  get(ctx, x.size(), i);
+    vex::scatter<double> put(ctx, x.size(), i);
+
+    std::vector<double> data[2];
+    data[0].resize(i.size());
+    data[1].resize(i.size());
+
+    for(int step = 0; step < 4; ++step) {
+        get.async(X, data[step % 2]);
+
+        if (step) {
+            const std::vector<double> &prev = data[(step + 1) % 2];
+            for(size_t p = 0; p < i.size(); ++p)
+                BOOST_CHECK_CLOSE(prev[p], x[i[p]] + step - 1, 1e-8);
+        }
+
+        X += 1;
+    }
+
+    get.wait();
+    for(size_t p = 0; p < i.size(); ++p)
+        BOOST_CHECK_CLOSE(data[1][p], x[i[p]] + 3, 1e-8);
+
+    std::vector<double> v(i.size());
+    std::iota(v.begin(), v.end(), 0.0);
+
+    X = 0;
+    put(v, X);
+
+    std::vector<double> y(n);
+    vex::copy(X, y);
+
+    for(size_t p = 0; p < i.size(); ++p)
+        BOOST_CHECK_EQUAL(y[i[p]], v[p]);
+
+    // The rest is intact (the first scattered value is zero as well).
+    BOOST_CHECK_EQUAL(std::count(y.begin(), y.end(), 0.0),
+            static_cast<ptrdiff_t>(n - i.size() + 1));
+}
+
 BOOST_AUTO_TEST_CASE(std_sort_vex_vector)
 {
     const size_t n = 1 << 10;
@@ -101,5 +160,59 @@ BOOST_AUTO_TEST_CASE(std_sort_vex_vector)
     BOOST_CHECK(std::is_sorted(x.begin(), x.end()));
 }
 
+BOOST_AUTO_TEST_CASE(save_load)
+{
+    const size_t N = 1024;
+    const std::string fname = "vexcl_save_load.bin";
+
+    std::vector<double> x = random_vector<double>(N);
+    vex::vector<double> X(ctx, x);
+
+    vex::save(X, fname);
+
+    vex::vector<double> Y(ctx, 1);
+    vex::load(Y, fname);
+
+    BOOST_CHECK_EQUAL(Y.size(), N);
+    check_sample(Y, x, [](size_t, double a, double b) { BOOST_CHECK(a == b); });
+
+    // Type mismatch is detected.
+    vex::vector<int> Z(ctx, N);
+    BOOST_CHECK_THROW(vex::load(Z, fname), std::runtime_error);
+
+    std::remove(fname.c_str());
+}
+
+#if defined(VEXCL_BACKEND_OPENCL)
+BOOST_AUTO_TEST_CASE(transfer_engine)
+{
+    const size_t N = 100000;
+
+    // Small staging buffers, so that the copies are split into many chunks.
+    vex::transfer_engine xfer(ctx, 1000 * sizeof(double), 2);
+
+    std::vector<double> x = random_vector<double>(N);
+    vex::vector<double> X(ctx, N);
+
+    xfer.write(X, x.data());
+    check_sample(X, x, [](size_t, double a, double b) { BOOST_CHECK(a == b); });
+
+    X = 2 * X;
+
+    std::vector<double> y(N);
+    xfer.read(X, y.data());
+    check_sample(x, y, [](size_t, double a, double b) { BOOST_CHECK(b == 2 * a); });
+
+    // Partial ranges.
+    std::vector<double> z(N / 2, 42);
+    xfer.write(X, N / 4, z.size(), z.data());
+    xfer.read(X, y.data());
+
+    check_sample(x, y, [](size_t i, double a, double b) {
+            BOOST_CHECK(b == (i >= N / 4 && i < N / 4 + N / 2 ? 42 : 2 * a));
+            });
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
 
@@ -1,4 +1,5 @@
 #define BOOST_TEST_MODULE VectorCreate
+#include <memory>
 #include <boost/test/unit_test.hpp>
 #include <vexcl/vector.hpp>
 #include "context_setup.hpp"
@@ -190,4 +191,145 @@ BOOST_AUTO_TEST_CASE(some_devices_are_empty)
     BOOST_CHECK(x[0] == 0);
 }
 
+BOOST_AUTO_TEST_CASE(memory_accounting)
+{
+    const size_t N = 1000;
+
+    std::vector<vex::command_queue> q(1, ctx.queue(0));
+
+#if defined(VEXCL_BACKEND_OPENCL)
+    // Otherwise the vectors below could reuse pooled buffers, which are
+    // already accounted.
+    vex::backend::trim_buffer_pool();
+#endif
+
+    ctx.reset_memory_peak();
+    vex::device_memory_usage before = ctx.memory_usage(0);
+
+    {
+        vex::memory_owner owner("test");
+
+        vex::vector<double> x(q, N);
+        vex::vector<double> y(x);
+
+        vex::device_memory_usage u = ctx.memory_usage(0);
+
+        BOOST_CHECK(u.buffers == before.buffers + 2);
+        BOOST_CHECK(u.bytes >= before.bytes + 2 * N * sizeof(double));
+        BOOST_CHECK(u.owners["test"].buffers == 2);
+    }
+
+    vex::device_memory_usage after = ctx.memory_usage(0);
+
+    // Released buffers may stay cached in the buffer pool.
+    BOOST_CHECK(after.bytes - after.owners["pool"].bytes ==
+            before.bytes - before.owners["pool"].bytes);
+    BOOST_CHECK(after.peak  >= before.bytes + 2 * N * sizeof(double));
+    BOOST_CHECK(after.owners["test"].bytes == 0);
+}
+
+#if defined(VEXCL_BACKEND_OPENCL)
+BOOST_AUTO_TEST_CASE(buffer_pool)
+{
+    const size_t N = 1000;
+
+    std::vector<vex::command_queue> q(1, ctx.queue(0));
+
+    vex::backend::trim_buffer_pool(q);
+
+    auto before = vex::backend::buffer_pool_statistics(q[0]);
+
+    {
+        vex::vector<double> x(q, N);
+        x = 42;
+    }
+
+    auto released = vex::backend::buffer_pool_statistics(q[0]);
+    BOOST_CHECK(released.buffers_held == before.buffers_held + 1);
+    BOOST_CHECK(released.bytes_held >= N * sizeof(double));
+    BOOST_CHECK(vex::backend::memory_usage(q[0]).owners["pool"].bytes >= released.bytes_held);
+
+    // Slightly smaller vector falls into the same size class.
+    std::vector<double> x = random_vector<double>(N - 10);
+    vex::vector<double> X(q, x);
+
+    auto reused = vex::backend::buffer_pool_statistics(q[0]);
+    BOOST_CHECK(reused.hits == before.hits + 1);
+    BOOST_CHECK(reused.buffers_held == before.buffers_held);
+
+    BOOST_CHECK(X.size() == x.size());
+    check_sample(X, [&](size_t idx, double v) { BOOST_CHECK(v == x[idx]); });
+
+    vex::backend::trim_buffer_pool(q);
+    BOOST_CHECK(vex::backend::buffer_pool_statistics(q[0]).bytes_held == 0);
+}
+
+BOOST_AUTO_TEST_CASE(buffer_pool_foreign_queue)
+{
+    const size_t N = 1000;
+
+    std::vector<vex::command_queue> q1(1, ctx.queue(0));
+    std::vector<vex::command_queue> q2(1, vex::backend::duplicate_queue(q1[0]));
+
+    vex::backend::trim_buffer_pool(q1);
+
+    { vex::vector<double> x(q1, N); x = 42; }
+
+    auto before = vex::backend::buffer_pool_statistics(q1[0]);
+
+    // The buffer released by q1 is not handed to another queue.
+    vex::vector<double> y(q2, N);
+    y = 0;
+
+    auto after = vex::backend::buffer_pool_statistics(q1[0]);
+    BOOST_CHECK(after.hits == before.hits);
+    BOOST_CHECK(after.buffers_held == before.buffers_held);
+
+    // But is reused by the queue that released it.
+    vex::vector<double> z(q1, N);
+    BOOST_CHECK(vex::backend::buffer_pool_statistics(q1[0]).hits == before.hits + 1);
+}
+
+BOOST_AUTO_TEST_CASE(buffer_pool_detach)
+{
+    const size_t N = 1000;
+
+    cl::Device       dev = ctx.queue(0).getInfo<CL_QUEUE_DEVICE>();
+    cl::Context      c(dev);
+    cl::CommandQueue q(c, dev);
+
+    std::vector<vex::command_queue> queue(1, q);
+
+    {
+        std::shared_ptr<void> attached = vex::backend::attach_buffer_pool(c);
+
+        { vex::vector<double> x(queue, N); }
+
+        BOOST_CHECK(vex::backend::buffer_pool_statistics(q).buffers_held == 1);
+    }
+
+    // The last handle is gone: cached buffers are released, and new ones are
+    // not cached.
+    BOOST_CHECK(vex::backend::buffer_pool_statistics(q).buffers_held == 0);
+
+    { vex::vector<double> x(queue, N); }
+
+    BOOST_CHECK(vex::backend::buffer_pool_statistics(q).buffers_held == 0);
+
+    // Buffers acquired during an earlier attachment are not cached after
+    // the context is attached again.
+    {
+        std::shared_ptr<void> attached = vex::backend::attach_buffer_pool(c);
+        std::unique_ptr< vex::vector<double> > x(new vex::vector<double>(queue, N));
+
+        attached.reset();
+        attached = vex::backend::attach_buffer_pool(c);
+
+        x.reset();
+
+        BOOST_CHECK(vex::backend::buffer_pool_statistics(q).buffers_held == 0);
+    }
+}
+#endif
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -267,6 +267,14 @@ inline bool is_cpu(const command_queue&) {
     return false;
 }
 
+/// Enables buffer pooling for the context while the returned handle is alive.
+/**
+ * The CUDA backend does not pool buffers, so this is a no-op.
+ */
+inline std::shared_ptr<void> attach_buffer_pool(const context&) {
+    return std::shared_ptr<void>();
+}
+
 /// Select devices by given criteria.
 /**
  * \param filter  Device filter functor. Functors may be combined with logical
@@ -148,6 +148,22 @@ struct SpMatCSR : public sparse_matrix {
     {
         if (rem) mul<assign::ADD>(*rem, in, out, scale);
     }
+
+    void mul_transposed_local(
+            const backend::device_vector<val_t> &in,
+            backend::device_vector<val_t> &out,
+            scalar_type scale) const
+    {
+        if (loc) loc->mul(in, out, scale, /*append=*/true, /*transpose=*/true);
+    }
+
+    void mul_transposed_remote(
+            const backend::device_vector<val_t> &in,
+            backend::device_vector<val_t> &out,
+            scalar_type scale) const
+    {
+        if (rem) rem->mul(in, out, scale, /*append=*/true, /*transpose=*/true);
+    }
 };
 
 #endif
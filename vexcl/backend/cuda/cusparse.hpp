@@ -250,12 +250,13 @@ class spmat_crs {
         }
 
         void mul(const device_vector<float> &x, device_vector<float> &y,
-                 float alpha = 1, bool append = false) const
+                 float alpha = 1, bool append = false, bool transpose = false) const
         {
             float beta = append ? 1 : 0;
 
             cuda_check(
-                    cusparseScsrmv(handle, CUSPARSE_OPERATION_NON_TRANSPOSE,
+                    cusparseScsrmv(handle, transpose ?
+                        CUSPARSE_OPERATION_TRANSPOSE : CUSPARSE_OPERATION_NON_TRANSPOSE,
                         n, m, nnz, &alpha, desc.get(),
                         val.raw_ptr(), row.raw_ptr(), col.raw_ptr(),
                         x.raw_ptr(), &beta, y.raw_ptr()
@@ -264,12 +265,13 @@ class spmat_crs {
         }
 
         void mul(const device_vector<double> &x, device_vector<double> &y,
-                 double alpha = 1, bool append = false) const
+                 double alpha = 1, bool append = false, bool transpose = false) const
         {
             double beta = append ? 1 : 0;
 
             cuda_check(
-                    cusparseDcsrmv(handle, CUSPARSE_OPERATION_NON_TRANSPOSE,
+                    cusparseDcsrmv(handle, transpose ?
+                        CUSPARSE_OPERATION_TRANSPOSE : CUSPARSE_OPERATION_NON_TRANSPOSE,
                         n, m, nnz, &alpha, desc.get(),
                         val.raw_ptr(), row.raw_ptr(), col.raw_ptr(),
                         x.raw_ptr(), &beta, y.raw_ptr()
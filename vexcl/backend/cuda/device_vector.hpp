@@ -33,6 +33,7 @@ THE SOFTWARE.
 
 #include <cuda.h>
 
+#include <vexcl/backend/memory_usage.hpp>
 #include <vexcl/backend/cuda/context.hpp>
 
 namespace vex {
@@ -60,9 +61,27 @@ struct deleter_impl<char*> {
     }
 };
 
+typedef vex::detail::memory_registry<CUdevice> memory_registry;
+
+// Accounts allocation of the given size on the device of the queue.
+inline std::shared_ptr<memory_registry::record>
+track_allocation(const command_queue &q, size_t bytes) {
+    return memory_registry::instance().allocate(q.device().raw(), bytes);
+}
+
 } // namespace detail
 /// \endcond
 
+/// Returns device memory allocated on the device of the given queue.
+inline device_memory_usage memory_usage(const command_queue &q) {
+    return detail::memory_registry::instance().get(q.device().raw());
+}
+
+/// Resets high-water marks of the device of the given queue to the current usage.
+inline void reset_memory_peak(const command_queue &q) {
+    detail::memory_registry::instance().reset_peak(q.device().raw());
+}
+
 /// Wrapper around CUdeviceptr.
 template <typename T>
 class device_vector {
@@ -82,6 +101,7 @@ class device_vector {
                 cuda_check( cuMemAlloc(&ptr, n * sizeof(T)) );
 
                 buffer.reset(reinterpret_cast<char*>(static_cast<size_t>(ptr)), detail::deleter() );
+                record = detail::track_allocation(q, n * sizeof(T));
             }
         }
 
@@ -100,6 +120,7 @@ class device_vector {
                 cuda_check( cuMemAlloc(&ptr, n * sizeof(T)) );
 
                 buffer.reset(reinterpret_cast<char*>(static_cast<size_t>(ptr)), detail::deleter() );
+                record = detail::track_allocation(q, n * sizeof(T));
 
                 if (host) {
                     if (std::is_same<T, H>::value)
@@ -134,6 +155,23 @@ class device_vector {
             }
         }
 
+        /// Copies data from another device buffer.
+        /**
+         * The copy is asynchronous with respect to the host and is ordered
+         * with the other work submitted to the queue.
+         */
+        void copy_from(const command_queue &q, const device_vector &src,
+                size_t src_offset, size_t offset, size_t size) const
+        {
+            if (size) {
+                q.context().set_current();
+                cuda_check( cuMemcpyDtoDAsync(
+                            raw() + offset * sizeof(T),
+                            src.raw() + src_offset * sizeof(T),
+                            size * sizeof(T), q.raw()) );
+            }
+        }
+
         /// Returns size (in elements) of the memory buffer.
         size_t size() const {
             return n;
@@ -189,6 +227,8 @@ class device_vector {
     private:
         std::shared_ptr<char> buffer;
         size_t n;
+
+        std::shared_ptr<detail::memory_registry::record> record;
 };
 
 } // namespace cuda
@@ -148,6 +148,25 @@ struct SpMatHELL : public sparse_matrix {
     {
         if (rem) mul<assign::ADD>(*rem, in, out, scale);
     }
+
+    // CUSPARSE does not support transposed products for HYB matrices.
+    void mul_transposed_local(
+            const backend::device_vector<val_t>&,
+            backend::device_vector<val_t>&,
+            scalar_type) const
+    {
+        precondition(false,
+                "Transposed product is not supported for CUSPARSE HYB matrices");
+    }
+
+    void mul_transposed_remote(
+            const backend::device_vector<val_t>&,
+            backend::device_vector<val_t>&,
+            scalar_type) const
+    {
+        precondition(false,
+                "Transposed product is not supported for CUSPARSE HYB matrices");
+    }
 };
 
 #endif
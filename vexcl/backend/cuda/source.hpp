@@ -205,6 +205,59 @@ class source_generator {
             return *this;
         }
 
+        /// Defines function that atomically adds a value to global memory.
+        /**
+         * The generated function has signature <tt>void name(T *p, T v)</tt>.
+         * Double precision additions are emulated with compare-and-swap
+         * loop. Vector types are updated componentwise.
+         */
+        template <typename T>
+        source_generator& atomic_add_function(const std::string &name) {
+            typedef typename cl_scalar_of<T>::type S;
+            static_assert(sizeof(S) == 4 || sizeof(S) == 8,
+                    "Unsupported type for atomic addition");
+
+            const std::string sname = cl_vector_length<T>::value > 1 ? name + "_scalar" : name;
+
+            function<void>(sname).open("(")
+                .template parameter< global_ptr<S> >("p")
+                .template parameter< S >("v")
+            .close(")").open("{");
+
+            if (std::is_same<S, cl_double>::value) {
+                new_line() << "unsigned long long *a = (unsigned long long*)p;";
+                new_line() << "unsigned long long old = *a, assumed;";
+                new_line() << "do";
+                open("{");
+                new_line() << "assumed = old;";
+                new_line() << "old = atomicCAS(a, assumed, "
+                    "__double_as_longlong(v + __longlong_as_double(assumed)));";
+                close("}");
+                new_line() << "while (assumed != old);";
+            } else if (sizeof(S) == 8) {
+                new_line() << "atomicAdd((unsigned long long*)p, (unsigned long long)v);";
+            } else {
+                new_line() << "atomicAdd(p, v);";
+            }
+
+            close("}");
+
+            if (cl_vector_length<T>::value > 1) {
+                function<void>(name).open("(")
+                    .template parameter< global_ptr<T> >("p")
+                    .template parameter< T >("v")
+                .close(")").open("{");
+                new_line() << "for(int i = 0; i < " << cl_vector_length<T>::value << "; ++i)";
+                open("{");
+                new_line() << sname << "((" << type_name<S>() << "*)p + i, (("
+                    << type_name<S>() << "*)&v)[i]);";
+                close("}");
+                close("}");
+            }
+
+            return *this;
+        }
+
         std::string global_id(int d) const {
             const char dim[] = {'x', 'y', 'z'};
             std::ostringstream s;
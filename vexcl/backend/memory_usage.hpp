@@ -0,0 +1,200 @@
+#ifndef VEXCL_BACKEND_MEMORY_USAGE_HPP
+#define VEXCL_BACKEND_MEMORY_USAGE_HPP
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/backend/memory_usage.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Accounting of device memory allocations.
+ */
+
+#include <map>
+#include <mutex>
+#include <memory>
+#include <string>
+
+#if defined(_MSC_VER)
+#  define VEXCL_THREAD_LOCAL __declspec(thread)
+#else
+#  define VEXCL_THREAD_LOCAL __thread
+#endif
+
+namespace vex {
+
+/// Device memory allocation statistics.
+struct memory_stats {
+    size_t bytes;       ///< Memory currently allocated.
+    size_t peak;        ///< High-water mark of the allocated memory.
+    size_t buffers;     ///< Number of live buffers.
+    size_t allocations; ///< Total number of allocations made.
+
+    memory_stats() : bytes(0), peak(0), buffers(0), allocations(0) {}
+};
+
+/// Device memory allocation statistics, along with breakdown by owner.
+struct device_memory_usage : memory_stats {
+    /// Statistics for each owner tag (see vex::memory_owner).
+    std::map<std::string, memory_stats> owners;
+};
+
+/// \cond INTERNAL
+namespace detail {
+
+inline const char*& current_memory_owner() {
+    static VEXCL_THREAD_LOCAL const char *tag = 0;
+    return tag;
+}
+
+// Per-device registry of live allocations. Each allocation is represented
+// by a record shared between all copies of the device buffer; the record
+// is released together with the buffer.
+template <class Device>
+class memory_registry {
+    public:
+        struct record {
+            Device      dev;
+            const char *owner;
+            size_t      bytes;
+
+            record(Device dev, const char *owner, size_t bytes)
+                : dev(dev), owner(owner), bytes(bytes)
+            {}
+
+            ~record() {
+                try {
+                    memory_registry::instance().release(*this);
+                } catch(...) {}
+            }
+        };
+
+        // The registry is intentionally never destroyed, so that buffers
+        // with static storage duration may still be released at exit.
+        static memory_registry& instance() {
+            static memory_registry *registry = new memory_registry();
+            return *registry;
+        }
+
+        std::shared_ptr<record> allocate(Device dev, size_t bytes) {
+            const char *owner = current_memory_owner();
+            return allocate(dev, bytes, owner ? owner : "other");
+        }
+
+        std::shared_ptr<record> allocate(Device dev, size_t bytes, const char *owner) {
+            {
+                std::lock_guard<std::mutex> lock(mx);
+
+                device_memory_usage &u = usage[dev];
+
+                add(u, bytes);
+                add(u.owners[owner], bytes);
+            }
+
+            return std::make_shared<record>(dev, owner, bytes);
+        }
+
+        void release(const record &r) {
+            std::lock_guard<std::mutex> lock(mx);
+
+            device_memory_usage &u = usage[r.dev];
+
+            remove(u, r.bytes);
+            remove(u.owners[r.owner], r.bytes);
+        }
+
+        device_memory_usage get(Device dev) {
+            std::lock_guard<std::mutex> lock(mx);
+
+            auto u = usage.find(dev);
+            return u == usage.end() ? device_memory_usage() : u->second;
+        }
+
+        void reset_peak(Device dev) {
+            std::lock_guard<std::mutex> lock(mx);
+
+            auto u = usage.find(dev);
+            if (u == usage.end()) return;
+
+            u->second.peak = u->second.bytes;
+            for(auto o = u->second.owners.begin(); o != u->second.owners.end(); ++o)
+                o->second.peak = o->second.bytes;
+        }
+    private:
+        std::mutex mx;
+        std::map<Device, device_memory_usage> usage;
+
+        memory_registry() {}
+
+        static void add(memory_stats &s, size_t bytes) {
+            s.bytes += bytes;
+            s.buffers++;
+            s.allocations++;
+            if (s.bytes > s.peak) s.peak = s.bytes;
+        }
+
+        static void remove(memory_stats &s, size_t bytes) {
+            s.bytes -= bytes;
+            s.buffers--;
+        }
+};
+
+} // namespace detail
+/// \endcond
+
+/// Attributes device allocations made during its lifetime to the given owner.
+/**
+ * The tag applies to the current thread only. Nested scopes do not override
+ * the outermost tag, so that e.g. vectors allocated inside vex::SpMat
+ * constructor are accounted to the matrix.
+ \code
+ {
+     vex::memory_owner owner("particles");
+     vex::vector<double> x(ctx, n); // Accounted to "particles".
+ }
+ std::cout << ctx.memory_usage(0).owners["particles"].bytes << std::endl;
+ \endcode
+ * \note The tag should be a string with static storage duration.
+ */
+class memory_owner {
+    public:
+        explicit memory_owner(const char *tag)
+            : prev(detail::current_memory_owner())
+        {
+            if (!prev) detail::current_memory_owner() = tag;
+        }
+
+        ~memory_owner() {
+            detail::current_memory_owner() = prev;
+        }
+    private:
+        const char *prev;
+
+        memory_owner(const memory_owner&);
+        memory_owner& operator=(const memory_owner&);
+};
+
+} // namespace vex
+
+#endif
@@ -0,0 +1,358 @@
+#ifndef VEXCL_BACKEND_OPENCL_BUFFER_POOL_HPP
+#define VEXCL_BACKEND_OPENCL_BUFFER_POOL_HPP
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/backend/opencl/buffer_pool.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Caching allocator for OpenCL buffers.
+ */
+
+#include <map>
+#include <mutex>
+#include <memory>
+
+#ifndef __CL_ENABLE_EXCEPTIONS
+#  define __CL_ENABLE_EXCEPTIONS
+#endif
+#include <CL/cl.hpp>
+
+#include <vexcl/backend/memory_usage.hpp>
+
+/// Maximum amount of memory (in bytes) the buffer pool holds per context.
+/**
+ * Define as 0 to disable buffer pooling.
+ */
+#ifndef VEXCL_BUFFER_POOL_LIMIT
+#  define VEXCL_BUFFER_POOL_LIMIT (256 << 20)
+#endif
+
+namespace vex {
+namespace backend {
+namespace opencl {
+
+/// Buffer pool statistics.
+struct buffer_pool_stats {
+    size_t hits;         ///< Allocations served from the pool.
+    size_t misses;       ///< Allocations that had to create a new buffer.
+    size_t bytes_held;   ///< Memory held by the cached buffers.
+    size_t buffers_held; ///< Number of cached buffers.
+
+    buffer_pool_stats() : hits(0), misses(0), bytes_held(0), buffers_held(0) {}
+};
+
+/// \cond INTERNAL
+namespace detail {
+
+// Released buffers are cached per context, and are reused for requests of
+// the same size class and memory flags coming from the same command queue.
+// Restricting reuse to the releasing queue keeps it safe without
+// synchronization: commands still using the buffer are ordered before any
+// new ones. Commands that use the buffer on other queues are not tracked,
+// so these have to complete before the buffer is released.
+//
+// Cached buffers stay accounted in vex::memory_usage() under the "pool"
+// owner.
+//
+// Only contexts attached by a live vex::Context are pooled. The pool keeps
+// raw queue and context handles, which are never dereferenced, so it does
+// not retain them by itself; the cached buffers of a context are released
+// as soon as the last vex::Context holding it is gone. Since a handle value
+// may be reused once its object is destroyed, every attachment gets a new
+// generation number, and leases from an earlier attachment are not cached.
+class buffer_pool {
+    public:
+        struct lease {
+            cl_command_queue queue;
+            cl_context       ctx;
+            cl_device_id     dev;
+            cl_mem_flags     flags;
+            size_t           bytes;
+            size_t           generation;
+            cl::Buffer       buffer;
+
+            lease(cl_command_queue queue, cl_context ctx, cl_device_id dev,
+                    cl_mem_flags flags, size_t bytes)
+                : queue(queue), ctx(ctx), dev(dev), flags(flags), bytes(bytes),
+                  generation(0)
+            {}
+
+            ~lease() {
+                try {
+                    buffer_pool::instance().release(*this);
+                } catch(...) {}
+            }
+        };
+
+        // Keeps the context attached while alive.
+        struct attachment {
+            cl_context ctx;
+
+            attachment(cl_context ctx) : ctx(ctx) {
+                buffer_pool::instance().attach(ctx);
+            }
+
+            ~attachment() {
+                try {
+                    buffer_pool::instance().detach(ctx);
+                } catch(...) {}
+            }
+        };
+
+        // The pool is intentionally never destroyed, so that vectors with
+        // static storage duration may still return their buffers at exit.
+        static buffer_pool& instance() {
+            static buffer_pool *pool = new buffer_pool();
+            return *pool;
+        }
+
+        // Returns buffer of at least the given size, or an empty pointer if
+        // the request should not be served by the pool.
+        std::shared_ptr<lease> acquire(
+                const cl::CommandQueue &q, cl_mem_flags flags, size_t bytes)
+        {
+            if (flags & (CL_MEM_USE_HOST_PTR | CL_MEM_ALLOC_HOST_PTR))
+                return std::shared_ptr<lease>();
+
+            if (q.getInfo<CL_QUEUE_PROPERTIES>() & CL_QUEUE_OUT_OF_ORDER_EXEC_MODE_ENABLE)
+                return std::shared_ptr<lease>();
+
+            const size_t cls = size_class(bytes);
+            cl::Context  ctx = q.getInfo<CL_QUEUE_CONTEXT>();
+
+            std::shared_ptr<lease> l = std::make_shared<lease>(
+                    q(), ctx(), q.getInfo<CL_QUEUE_DEVICE>()(), flags, cls);
+
+            {
+                std::lock_guard<std::mutex> lock(mx);
+
+                if (cls > limit) return std::shared_ptr<lease>();
+
+                auto p = pools.find(ctx());
+                if (p == pools.end()) return std::shared_ptr<lease>();
+
+                context_pool &pool = p->second;
+
+                l->generation = pool.generation;
+
+                auto range = pool.store.equal_range(cls);
+                for(auto e = range.first; e != range.second; ++e) {
+                    if (e->second.queue == q() && e->second.flags == flags) {
+                        l->buffer = e->second.buffer;
+
+                        pool.stats.bytes_held -= cls;
+                        pool.stats.buffers_held--;
+                        pool.stats.hits++;
+
+                        pool.store.erase(e);
+                        return l;
+                    }
+                }
+
+                pool.stats.misses++;
+            }
+
+            l->buffer = cl::Buffer(ctx, flags, cls);
+            return l;
+        }
+
+        void release(const lease &l) {
+            if (!l.ctx || !l.buffer()) return;
+
+            std::lock_guard<std::mutex> lock(mx);
+
+            // The context is no longer attached: drop the buffer.
+            auto p = pools.find(l.ctx);
+            if (p == pools.end()) return;
+
+            context_pool &pool = p->second;
+
+            // The lease is from an earlier attachment of the handle.
+            if (pool.generation != l.generation) return;
+
+            if (pool.stats.bytes_held + l.bytes > limit) return;
+
+            pool.store.insert(std::make_pair(l.bytes, entry(l)));
+
+            pool.stats.bytes_held += l.bytes;
+            pool.stats.buffers_held++;
+        }
+
+        buffer_pool_stats stats(cl_context ctx) {
+            std::lock_guard<std::mutex> lock(mx);
+
+            auto p = pools.find(ctx);
+            return p == pools.end() ? buffer_pool_stats() : p->second.stats;
+        }
+
+        void trim(cl_context ctx, size_t keep) {
+            std::lock_guard<std::mutex> lock(mx);
+
+            auto p = pools.find(ctx);
+            if (p != pools.end()) trim(p->second, keep);
+        }
+
+        void trim(size_t keep) {
+            std::lock_guard<std::mutex> lock(mx);
+
+            for(auto p = pools.begin(); p != pools.end(); ++p)
+                trim(p->second, keep);
+        }
+
+        // Enables pooling for the context. The pool of the context is
+        // destroyed together with its cached buffers on the last detach().
+        void attach(cl_context ctx) {
+            std::lock_guard<std::mutex> lock(mx);
+
+            context_pool &pool = pools[ctx];
+            if (!pool.users++) pool.generation = ++generations;
+        }
+
+        void detach(cl_context ctx) {
+            std::lock_guard<std::mutex> lock(mx);
+
+            auto p = pools.find(ctx);
+            if (p != pools.end() && --p->second.users == 0) pools.erase(p);
+        }
+
+        void set_limit(size_t bytes) {
+            {
+                std::lock_guard<std::mutex> lock(mx);
+                limit = bytes;
+            }
+            trim(bytes);
+        }
+    private:
+        typedef vex::detail::memory_registry<cl_device_id> memory_registry;
+
+        struct entry {
+            cl_command_queue queue;
+            cl_mem_flags     flags;
+            cl::Buffer       buffer;
+
+            // Released together with the entry.
+            std::shared_ptr<memory_registry::record> record;
+
+            entry(const lease &l)
+                : queue(l.queue), flags(l.flags), buffer(l.buffer),
+                  record(memory_registry::instance().allocate(l.dev, l.bytes, "pool"))
+            {}
+        };
+
+        struct context_pool {
+            std::multimap<size_t, entry> store;
+            buffer_pool_stats stats;
+            size_t users;
+            size_t generation;
+
+            context_pool() : users(0), generation(0) {}
+        };
+
+        std::mutex mx;
+        size_t limit;
+        size_t generations;
+        std::map<cl_context, context_pool> pools;
+
+        buffer_pool() : limit(VEXCL_BUFFER_POOL_LIMIT), generations(0) {}
+
+        // Sizes are rounded up to a quarter of the enclosing power of two,
+        // so that at most 25% of a buffer is wasted.
+        static size_t size_class(size_t bytes) {
+            const size_t min_size = 256;
+
+            if (bytes <= min_size) return min_size;
+
+            size_t p = min_size;
+            while (2 * p < bytes) p *= 2;
+
+            size_t step = p / 4;
+            return (bytes + step - 1) / step * step;
+        }
+
+        // Releases the largest cached buffers first.
+        static void trim(context_pool &pool, size_t keep) {
+            while (pool.stats.bytes_held > keep && !pool.store.empty()) {
+                auto e = --pool.store.end();
+
+                pool.stats.bytes_held -= e->first;
+                pool.stats.buffers_held--;
+
+                pool.store.erase(e);
+            }
+        }
+};
+
+} // namespace detail
+/// \endcond
+
+/// Enables buffer pooling for the context while the returned handle is alive.
+/**
+ * vex::Context holds a handle for each of its contexts. When the last handle
+ * for a context is destroyed, the cached buffers of the context are released,
+ * so that the context itself may be destroyed. Buffers released after that
+ * are not cached.
+ */
+inline std::shared_ptr<void> attach_buffer_pool(const cl::Context &ctx) {
+    return std::make_shared<detail::buffer_pool::attachment>(ctx());
+}
+
+/// Returns buffer pool statistics for the context of the given queue.
+inline buffer_pool_stats buffer_pool_statistics(const cl::CommandQueue &q) {
+    return detail::buffer_pool::instance().stats(q.getInfo<CL_QUEUE_CONTEXT>()());
+}
+
+/// Releases cached buffers of the context of the given queue.
+/**
+ * \param keep amount of memory (in bytes) the pool is allowed to keep.
+ */
+inline void trim_buffer_pool(const cl::CommandQueue &q, size_t keep = 0) {
+    detail::buffer_pool::instance().trim(q.getInfo<CL_QUEUE_CONTEXT>()(), keep);
+}
+
+/// Releases cached buffers of the contexts of the given queues.
+inline void trim_buffer_pool(const std::vector<cl::CommandQueue> &queue, size_t keep = 0) {
+    for(auto q = queue.begin(); q != queue.end(); ++q)
+        trim_buffer_pool(*q, keep);
+}
+
+/// Releases cached buffers of all contexts.
+inline void trim_buffer_pool(size_t keep = 0) {
+    detail::buffer_pool::instance().trim(keep);
+}
+
+/// Sets maximum amount of memory the buffer pool holds per context.
+/**
+ * Setting the limit to zero disables buffer pooling.
+ */
+inline void set_buffer_pool_limit(size_t bytes) {
+    detail::buffer_pool::instance().set_limit(bytes);
+}
+
+} // namespace opencl
+} // namespace backend
+} // namespace vex
+
+#endif
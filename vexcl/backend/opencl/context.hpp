@@ -32,6 +32,8 @@ THE SOFTWARE.
  */
 
 #include <vector>
+#include <string>
+#include <sstream>
 #include <iostream>
 
 #ifndef __CL_ENABLE_EXCEPTIONS
@@ -78,6 +80,59 @@ inline command_queue duplicate_queue(const command_queue &q) {
             q.getInfo<CL_QUEUE_CONTEXT>(), q.getInfo<CL_QUEUE_DEVICE>());
 }
 
+/// \cond INTERNAL
+// Checks if the platform of the queue supports OpenCL 1.2. The headers may
+// be newer than the runtime, so this is checked for each queue.
+inline bool opencl_1_2(const command_queue &q) {
+    cl::Device   d = q.getInfo<CL_QUEUE_DEVICE>();
+    cl::Platform p(d.getInfo<CL_DEVICE_PLATFORM>());
+
+    // "OpenCL <major>.<minor> <platform-specific information>"
+    std::istringstream v(p.getInfo<CL_PLATFORM_VERSION>());
+    std::string name;
+    unsigned major = 0, minor = 0;
+    char dot;
+
+    v >> name >> major >> dot >> minor;
+
+    return major > 1 || (major == 1 && minor >= 2);
+}
+
+// Returns event that completes together with the commands enqueued so far.
+inline cl::Event enqueue_marker(const command_queue &q) {
+    cl::Event e;
+#if defined(CL_VERSION_1_2)
+    if (opencl_1_2(q)) {
+        q.enqueueMarkerWithWaitList(0, &e);
+    } else {
+        cl_event ev;
+        cl_int err = clEnqueueMarker(q(), &ev);
+        if (err != CL_SUCCESS) throw cl::Error(err, "clEnqueueMarker");
+        e = cl::Event(ev);
+    }
+#else
+    q.enqueueMarker(&e);
+#endif
+    return e;
+}
+
+// Commands enqueued after this wait for the given events.
+inline void enqueue_wait(const command_queue &q, const std::vector<cl::Event> &events) {
+#if defined(CL_VERSION_1_2)
+    if (opencl_1_2(q)) {
+        q.enqueueBarrierWithWaitList(&events);
+    } else if (!events.empty()) {
+        cl_int err = clEnqueueWaitForEvents(q(),
+                static_cast<cl_uint>(events.size()),
+                reinterpret_cast<const cl_event*>(&events.front()));
+        if (err != CL_SUCCESS) throw cl::Error(err, "clEnqueueWaitForEvents");
+    }
+#else
+    q.enqueueWaitForEvents(events);
+#endif
+}
+/// \endcond
+
 /// Checks if the compute device is CPU.
 inline bool is_cpu(const command_queue &q) {
     cl::Device d = q.getInfo<CL_QUEUE_DEVICE>();
@@ -36,6 +36,9 @@ THE SOFTWARE.
 #endif
 #include <CL/cl.hpp>
 
+#include <vexcl/backend/memory_usage.hpp>
+#include <vexcl/backend/opencl/buffer_pool.hpp>
+
 namespace vex {
 namespace backend {
 namespace opencl {
@@ -46,49 +49,104 @@ static const mem_flags MEM_READ_ONLY  = CL_MEM_READ_ONLY;
 static const mem_flags MEM_WRITE_ONLY = CL_MEM_WRITE_ONLY;
 static const mem_flags MEM_READ_WRITE = CL_MEM_READ_WRITE;
 
+/// \cond INTERNAL
+namespace detail {
+
+typedef vex::detail::memory_registry<cl_device_id> memory_registry;
+
+// Accounts allocation of the given size on the device of the queue.
+inline std::shared_ptr<memory_registry::record>
+track_allocation(const cl::CommandQueue &q, size_t bytes) {
+    return memory_registry::instance().allocate(q.getInfo<CL_QUEUE_DEVICE>()(), bytes);
+}
+
+} // namespace detail
+/// \endcond
+
+/// Returns device memory allocated on the device of the given queue.
+inline device_memory_usage memory_usage(const cl::CommandQueue &q) {
+    return detail::memory_registry::instance().get(q.getInfo<CL_QUEUE_DEVICE>()());
+}
+
+/// Resets high-water marks of the device of the given queue to the current usage.
+inline void reset_memory_peak(const cl::CommandQueue &q) {
+    detail::memory_registry::instance().reset_peak(q.getInfo<CL_QUEUE_DEVICE>()());
+}
+
 template <typename T>
 class device_vector {
     public:
         typedef T value_type;
         typedef cl_mem raw_type;
 
-        device_vector() {}
+        device_vector() : n(0) {}
 
+        /// Allocates buffer of n elements.
+        /**
+         * Buffers are drawn from the per-context buffer pool when possible,
+         * and are returned there once the last copy of the device_vector is
+         * destroyed. The allocation is accounted in vex::memory_usage().
+         */
         device_vector(const cl::CommandQueue &q, size_t n,
                 const T *host = 0, mem_flags flags = MEM_READ_WRITE)
+            : n(n)
         {
-            if (host)
-                flags |= CL_MEM_COPY_HOST_PTR;
+            if (!n) return;
+
+            lease = detail::buffer_pool::instance().acquire(q, flags, n * sizeof(T));
+
+            if (lease) {
+                buffer = lease->buffer;
+                if (host) write(q, 0, n, host, true);
+            } else {
+                if (host) flags |= CL_MEM_COPY_HOST_PTR;
 
-            if (n)
                 buffer = cl::Buffer(q.getInfo<CL_QUEUE_CONTEXT>(), flags,
                         n * sizeof(T), static_cast<void*>(const_cast<T*>(host)));
+            }
+
+            record = detail::track_allocation(q, lease ? lease->bytes : n * sizeof(T));
         }
 
-        device_vector(cl::Buffer buffer) : buffer( std::move(buffer) ) {}
+        device_vector(cl::Buffer buffer)
+            : n(buffer() ? buffer.getInfo<CL_MEM_SIZE>() / sizeof(T) : 0),
+              buffer( std::move(buffer) )
+        {}
 
         void write(const cl::CommandQueue &q, size_t offset, size_t size, const T *host,
-                bool blocking = false) const
+                bool blocking = false, cl::Event *event = 0) const
         {
             if (size)
                 q.enqueueWriteBuffer(
                         buffer, blocking ? CL_TRUE : CL_FALSE,
-                        sizeof(T) * offset, sizeof(T) * size, host
+                        sizeof(T) * offset, sizeof(T) * size, host, 0, event
                         );
         }
 
         void read(const cl::CommandQueue &q, size_t offset, size_t size, T *host,
-                bool blocking = false) const
+                bool blocking = false, cl::Event *event = 0,
+                const std::vector<cl::Event> *wait = 0) const
         {
             if (size)
                 q.enqueueReadBuffer(
                         buffer, blocking ? CL_TRUE : CL_FALSE,
-                        sizeof(T) * offset, sizeof(T) * size, host
+                        sizeof(T) * offset, sizeof(T) * size, host, wait, event
+                        );
+        }
+
+        /// Copies data from another buffer residing in the same context.
+        void copy_from(const cl::CommandQueue &q, const device_vector &src,
+                size_t src_offset, size_t offset, size_t size) const
+        {
+            if (size)
+                q.enqueueCopyBuffer(
+                        src.buffer, buffer,
+                        sizeof(T) * src_offset, sizeof(T) * offset, sizeof(T) * size
                         );
         }
 
         size_t size() const {
-            return buffer.getInfo<CL_MEM_SIZE>() / sizeof(T);
+            return n;
         }
 
         struct buffer_unmapper {
@@ -122,7 +180,14 @@ class device_vector {
             return buffer();
         }
     private:
+        size_t     n;
         cl::Buffer buffer;
+
+        // Pooled buffers may be larger than requested.
+        std::shared_ptr<detail::buffer_pool::lease> lease;
+
+        // Wrapped buffers are not accounted.
+        std::shared_ptr<detail::memory_registry::record> record;
 };
 
 } // namespace opencl
@@ -52,36 +52,48 @@ namespace vex {
  FFT<cl_double2> fft({batch, n}, {fft::none, fft::forward});
  output = fft(input);
  \endcode
+ * Transforms between real and complex data only store the n/2+1
+ * nonredundant values of the hermitian spectrum along the last dimension:
+ \code
+ FFT<double, cl_double2> fft({height, width});   // output has height * (width/2+1) values
+ FFT<cl_double2, double> ifft({height, width}, fft::inverse);
+ \endcode
  */
 template <typename Tin, typename Tout = Tin, class Planner = fft::planner>
 struct FFT {
     typedef typename cl_scalar_of<Tin>::type value_type;
 
-    fft::plan<Tin, Planner> plan;
+    // Real-to-complex or complex-to-real transform.
+    static const bool half_spectrum =
+        (cl_vector_length<Tin>::value == 1) != (cl_vector_length<Tout>::value == 1);
+
+    // Plans are reused from previously destroyed FFT objects of the same
+    // configuration, see fft::plan_cache.
+    std::shared_ptr< fft::plan<Tin, Planner> > plan;
 
     /// 1D constructor
     FFT(const std::vector<backend::command_queue> &queues,
         size_t length, fft::direction dir = fft::forward,
         const Planner &planner = Planner())
-        : plan(queues, std::vector<size_t>(1, length), std::vector<fft::direction>(1, dir), planner) {}
+        : plan(fft::plan_cache<Tin, Planner>::get(queues, std::vector<size_t>(1, length), std::vector<fft::direction>(1, dir), planner, half_spectrum)) {}
 
 #ifndef VEXCL_NO_STATIC_CONTEXT_CONSTRUCTORS
     FFT(size_t length, fft::direction dir = fft::forward,
         const Planner &planner = Planner())
-        : plan(current_context().queue(), std::vector<size_t>(1, length), std::vector<fft::direction>(1, dir), planner) {}
+        : plan(fft::plan_cache<Tin, Planner>::get(current_context().queue(), std::vector<size_t>(1, length), std::vector<fft::direction>(1, dir), planner, half_spectrum)) {}
 #endif
 
     /// N-dimensional constructor
     FFT(const std::vector<backend::command_queue> &queues,
         const std::vector<size_t> &lengths, fft::direction dir = fft::forward,
         const Planner &planner = Planner())
-        : plan(queues, lengths, std::vector<fft::direction>(lengths.size(), dir), planner) {}
+        : plan(fft::plan_cache<Tin, Planner>::get(queues, lengths, std::vector<fft::direction>(lengths.size(), dir), planner, half_spectrum)) {}
 
 #ifndef VEXCL_NO_STATIC_CONTEXT_CONSTRUCTORS
     /// N-dimensional constructor
     FFT(const std::vector<size_t> &lengths, fft::direction dir = fft::forward,
         const Planner &planner = Planner())
-        : plan(current_context().queue(), lengths, std::vector<fft::direction>(lengths.size(), dir), planner) {}
+        : plan(fft::plan_cache<Tin, Planner>::get(current_context().queue(), lengths, std::vector<fft::direction>(lengths.size(), dir), planner, half_spectrum)) {}
 #endif
 
     /// N-dimensional constructor
@@ -89,14 +101,14 @@ struct FFT {
         const std::vector<size_t> &lengths,
         const std::vector<fft::direction> &dirs,
         const Planner &planner = Planner())
-        : plan(queues, lengths, dirs, planner) {}
+        : plan(fft::plan_cache<Tin, Planner>::get(queues, lengths, dirs, planner, half_spectrum)) {}
 
 #ifndef VEXCL_NO_STATIC_CONTEXT_CONSTRUCTORS
     /// N-dimensional constructor
     FFT(const std::vector<size_t> &lengths,
         const std::vector<fft::direction> &dirs,
         const Planner &planner = Planner())
-        : plan(current_context().queue(), lengths, dirs, planner) {}
+        : plan(fft::plan_cache<Tin, Planner>::get(current_context().queue(), lengths, dirs, planner, half_spectrum)) {}
 #endif
 
 
@@ -105,13 +117,13 @@ struct FFT {
     FFT(const std::vector<backend::command_queue> &queues,
         const std::initializer_list<size_t> &lengths, fft::direction dir = fft::forward,
         const Planner &planner = Planner())
-        : plan(queues, lengths, std::vector<fft::direction>(lengths.size(), dir), planner) {}
+        : plan(fft::plan_cache<Tin, Planner>::get(queues, lengths, std::vector<fft::direction>(lengths.size(), dir), planner, half_spectrum)) {}
 
 #ifndef VEXCL_NO_STATIC_CONTEXT_CONSTRUCTORS
     /// N-dimensional constructor
     FFT(const std::initializer_list<size_t> &lengths, fft::direction dir = fft::forward,
         const Planner &planner = Planner())
-        : plan(current_context().queue(), lengths, std::vector<fft::direction>(lengths.size(), dir), planner) {}
+        : plan(fft::plan_cache<Tin, Planner>::get(current_context().queue(), lengths, std::vector<fft::direction>(lengths.size(), dir), planner, half_spectrum)) {}
 #endif
 
     /// N-dimensional constructor
@@ -119,25 +131,27 @@ struct FFT {
         const std::initializer_list<size_t> &lengths,
         const std::initializer_list<fft::direction> &dirs,
         const Planner &planner = Planner())
-        : plan(queues, lengths, dirs, planner) {}
+        : plan(fft::plan_cache<Tin, Planner>::get(queues, lengths, dirs, planner, half_spectrum)) {}
 
 #ifndef VEXCL_NO_STATIC_CONTEXT_CONSTRUCTORS
     /// N-dimensional constructor
     FFT(const std::initializer_list<size_t> &lengths,
         const std::initializer_list<fft::direction> &dirs,
         const Planner &planner = Planner())
-        : plan(current_context().queue(), lengths, dirs, planner) {}
+        : plan(fft::plan_cache<Tin, Planner>::get(current_context().queue(), lengths, dirs, planner, half_spectrum)) {}
 #endif
 #endif
 
     // User call
     template <class Expr>
-    auto operator()(const Expr &x) -> decltype(plan.template apply<Tout>(x))
+    auto operator()(const Expr &x) -> decltype(plan->template apply<Tout>(x))
     {
-        return plan.template apply<Tout>(x);
+        return plan->template apply<Tout>(x);
     }
 };
 
 }
 
+#include <vexcl/backend/opencl/fft/convolution.hpp>
+
 #endif
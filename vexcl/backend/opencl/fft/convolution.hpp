@@ -0,0 +1,267 @@
+#ifndef VEXCL_BACKEND_OPENCL_FFT_CONVOLUTION_HPP
+#define VEXCL_BACKEND_OPENCL_FFT_CONVOLUTION_HPP
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/backend/opencl/fft/convolution.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Convolution and correlation with long filters using FFT.
+ */
+
+#include <cmath>
+#include <memory>
+#include <vector>
+#include <algorithm>
+
+#include <vexcl/vector.hpp>
+#include <vexcl/stencil.hpp>
+#include <vexcl/operations.hpp>
+#include <vexcl/backend/opencl/fft.hpp>
+
+namespace vex {
+
+namespace fft {
+
+/// Kind of the filter applied by vex::convolution.
+enum filter_kind {
+    convolve,   ///< y[i] = sum_k f[k] * x[i - k + center]
+    correlate   ///< y[i] = sum_k f[k] * x[i + k - center]
+};
+
+} // namespace fft
+
+/// Convolution or correlation of a vector with a long filter.
+/**
+ * Correlation is the same operation as vex::stencil does; convolution uses
+ * the reversed filter. Values outside of the vector are replaced by the
+ * boundary values.
+ *
+ * The input is split into overlapping blocks (overlap-save), and each block
+ * is multiplied by the filter spectrum that is computed once and kept on the
+ * device. Pairs of real blocks share a single complex transform, and the
+ * product with the filter spectrum is fused into the last pass of the forward
+ * transform. The blocks are processed in chunks of bounded size, so the
+ * scratch memory does not depend on the vector size.
+ *
+ * When direct evaluation is estimated to be cheaper (short filters), or for
+ * multi-device contexts, vex::stencil is used instead.
+ \code
+ vex::convolution<double> F(ctx, filter, filter.size() / 2);
+ y = F * x;
+ \endcode
+ */
+template <typename T, class Planner = fft::planner>
+class convolution {
+    public:
+        typedef T value_type;
+
+        /// Constructor.
+        /**
+         * \param queue  vector of queues.
+         * \param filter filter coefficients.
+         * \param center position of the filter center.
+         * \param kind   convolution or correlation.
+         */
+        convolution(const std::vector<backend::command_queue> &queue,
+                const std::vector<T> &filter, unsigned center,
+                fft::filter_kind kind = fft::convolve,
+                const Planner &planner = Planner()
+                )
+            : queue(queue)
+        {
+            precondition(!filter.empty() && center < filter.size(),
+                    "Wrong filter center");
+
+            const size_t width = filter.size();
+
+            // Correlation form of the filter.
+            std::vector<T> g(filter);
+            if (kind == fft::convolve) {
+                std::reverse(g.begin(), g.end());
+                center = static_cast<unsigned>(width - 1 - center);
+            }
+
+            lhalo = center;
+
+            // Transform size and the number of valid outputs per block.
+            nfft  = planner.best_size(std::max<size_t>(4 * width, 256));
+            block = nfft - width + 1;
+
+            // Operations per output: direct evaluation vs. two transforms
+            // of nfft / 2 complex values per block, plus gather, product
+            // and scatter.
+            const double direct = static_cast<double>(width);
+            const double fast   = (5.0 * nfft * std::log(static_cast<double>(nfft)) / std::log(2.0)
+                                    + 8.0 * nfft) / block;
+
+            if (queue.size() > 1 || direct <= fast) {
+                conv.reset(new stencil<T>(queue, g, center));
+                return;
+            }
+
+            const auto &q = queue[0];
+
+            // Spectrum of h, where h[-k mod nfft] = g[k], scaled by 1/nfft.
+            {
+                std::vector<T2> h(nfft);
+                for(size_t i = 0; i < nfft; ++i) {
+                    h[i].s[0] = 0;
+                    h[i].s[1] = 0;
+                }
+                for(size_t k = 0; k < width; ++k)
+                    h[(nfft - k) % nfft].s[0] = g[k] / nfft;
+
+                vex::vector<T2> hv(queue, h);
+                H = vex::vector<T2>(queue, nfft);
+
+                FFT<T2, T2, Planner> transform(queue, nfft, fft::forward, planner);
+                H = transform(hv);
+            }
+
+            // Scratch buffers hold chunk pairs of blocks.
+            chunk = std::max<size_t>(1, (1 << 20) / nfft);
+
+            buf[0] = backend::device_vector<T2>(q, chunk * nfft);
+            buf[1] = backend::device_vector<T2>(q, chunk * nfft);
+
+            gather.reset(new fft::kernel_call(fft::conv_gather_kernel<Ts>(
+                            q, nfft, block, lhalo, chunk, buf[0])));
+
+            size_t current = 0;
+            auto rs = planner.factor(nfft);
+            const bool fused = planner.fuse(rs, nfft * sizeof(T2),
+                    fft::qdev(q).getInfo<CL_DEVICE_LOCAL_MEM_SIZE>());
+
+            for(int inverse = 0; inverse < 2; ++inverse) {
+                const backend::device_vector<T2> *h = inverse ? 0 : &H(0);
+
+                if (fused) {
+                    passes.push_back(fft::fused_kernel<Ts>(false, q, nfft, chunk,
+                                inverse != 0, rs, buf[current], buf[1 - current], h));
+                    current = 1 - current;
+                } else {
+                    size_t p = 1;
+                    for(auto r = rs.begin(); r != rs.end(); ++r) {
+                        passes.push_back(fft::radix_kernel<Ts>(false, q, nfft, chunk,
+                                    inverse != 0, *r, p, buf[current], buf[1 - current],
+                                    r + 1 == rs.end() ? h : 0));
+                        current = 1 - current;
+                        p *= r->value;
+                    }
+                }
+            }
+
+            scatter.reset(new fft::kernel_call(fft::conv_scatter_kernel<Ts>(
+                            q, nfft, block, chunk, buf[current])));
+        }
+
+        /// Filter a vector.
+        /**
+         * y = alpha * conv(x) + y;
+         * \param x input vector.
+         * \param y output vector.
+         * \param alpha Scaling coefficient in front of y.
+         * \param append whether to append the result to the output vector
+         *               (alternative is to replace the output vector).
+         */
+        void apply(const vex::vector<T> &x, vex::vector<T> &y,
+                T alpha = 1, bool append = false) const
+        {
+            if (conv) {
+                conv->apply(x, y, alpha, append);
+                return;
+            }
+
+            const auto &q = queue[0];
+            const size_t n = x.size();
+
+            if (!n) return;
+
+            const size_t nblocks = (n + block - 1) / block;
+            const size_t npairs  = (nblocks + 1) / 2;
+
+            gather->kernel.setArg(0, x(0));
+            gather->kernel.setArg(2, static_cast<cl_ulong>(n));
+
+            scatter->kernel.setArg(1, y(0));
+            scatter->kernel.setArg(2, static_cast<cl_ulong>(n));
+            scatter->kernel.setArg(6, static_cast<Ts>(alpha));
+            scatter->kernel.setArg(7, static_cast<cl_int>(append));
+
+            for(size_t first = 0; first < npairs; first += chunk) {
+                const size_t count = std::min(chunk, npairs - first);
+
+                gather->kernel.setArg(3, static_cast<cl_ulong>(first));
+                launch(q, *gather, count);
+
+                for(auto k = passes.begin(); k != passes.end(); ++k)
+                    launch(q, *k, count);
+
+                scatter->kernel.setArg(3, static_cast<cl_ulong>(first));
+                launch(q, *scatter, count);
+            }
+        }
+    private:
+        typedef typename cl_scalar_of<T>::type Ts;
+        typedef typename cl_vector_of<Ts, 2>::type T2;
+
+        const std::vector<backend::command_queue> &queue;
+
+        // Direct evaluation.
+        std::unique_ptr< stencil<T> > conv;
+
+        size_t nfft, block, lhalo, chunk;
+
+        vex::vector<T2> H;
+        backend::device_vector<T2> buf[2];
+
+        std::unique_ptr<fft::kernel_call> gather, scatter;
+        std::vector<fft::kernel_call> passes;
+
+        // Launches a kernel for the given number of block pairs.
+        static void launch(const backend::command_queue &q, const fft::kernel_call &k, size_t count) {
+            q.enqueueNDRangeKernel(k.kernel, cl::NullRange,
+                    cl::NDRange(k.global[0], count), k.local);
+        }
+};
+
+/// Apply a convolution to a vector.
+template <typename T, class P>
+additive_operator< convolution<T, P>, vector<T> >
+operator*( const convolution<T, P> &c, const vector<T> &x ) {
+    return additive_operator< convolution<T, P>, vector<T> >(c, x);
+}
+
+/// Apply a convolution to a vector.
+template <typename T, class P>
+additive_operator< convolution<T, P>, vector<T> >
+operator*( const vector<T> &x, const convolution<T, P> &c ) {
+    return additive_operator< convolution<T, P>, vector<T> >(c, x);
+}
+
+} // namespace vex
+
+#endif
@@ -31,6 +31,8 @@ THE SOFTWARE.
  * \brief  Kernel generator for FFT.
  */
 
+#include <vector>
+#include <algorithm>
 #include <boost/math/constants/constants.hpp>
 
 namespace vex {
@@ -78,12 +80,17 @@ inline void param_list(std::ostringstream &o, std::string prefix, size_t from, s
     } o << ')';
 }
 
+// When post_mul is set, the outputs of the last pass are multiplied by the
+// corresponding values of the spectrum h (same for each batch; conjugated
+// for inverse transforms).
 template <class T>
-inline void kernel_radix(std::ostringstream &o, pow radix, bool invert) {
+inline void kernel_radix(std::ostringstream &o, pow radix, bool invert, bool post_mul = false) {
     o << in_place_dft(radix.value, invert);
 
     // kernel.
-    o << "__kernel void radix(__global const real2_t *x, __global real2_t *y, uint p, uint threads) {\n"
+    o << "__kernel void radix(__global const real2_t *x, __global real2_t *y, uint p, uint threads";
+    if(post_mul) o << ", __global const real2_t *h";
+    o << ") {\n"
       << "  const size_t i = get_global_id(0);\n"
       << "  if(i >= threads) return;\n"
         // index in input sequence, in 0..P-1
@@ -112,8 +119,13 @@ inline void kernel_radix(std::ostringstream &o, pow radix, bool invert) {
     // write back
     o << "  const size_t j = k + (i - k) * " << radix.value << ";\n";
     o << "  y += j + batch_offset;\n";
-    for(size_t i = 0 ; i < radix.value ; i++)
-        o << "  y[" << i << " * p] = v" << i << ";\n";
+    if(post_mul) o << "  h += j;\n";
+    for(size_t i = 0 ; i < radix.value ; i++) {
+        if(post_mul)
+            o << "  y[" << i << " * p] = mul(v" << i << ", h[" << i << " * p]);\n";
+        else
+            o << "  y[" << i << " * p] = v" << i << ";\n";
+    }
     o << "}\n";
 }
 
@@ -161,7 +173,8 @@ inline kernel_call radix_kernel(
         bool once, const backend::command_queue &queue, size_t n, size_t batch,
         bool invert, pow radix, size_t p,
         const backend::device_vector<T2> &in,
-        const backend::device_vector<T2> &out
+        const backend::device_vector<T2> &out,
+        const backend::device_vector<T2> *post_mul = 0
         )
 {
     std::ostringstream o;
@@ -172,7 +185,7 @@ inline kernel_call radix_kernel(
     twiddle_code<T>(o);
 
     const size_t m = n / radix.value;
-    kernel_radix<T>(o, radix, invert);
+    kernel_radix<T>(o, radix, invert, post_mul != 0);
 
     auto program = backend::build_sources(queue, o.str(), "-cl-mad-enable -cl-fast-relaxed-math");
     cl::Kernel kernel(program, "radix");
@@ -180,6 +193,7 @@ inline kernel_call radix_kernel(
     kernel.setArg(1, out);
     kernel.setArg(2, static_cast<cl_uint>(p));
     kernel.setArg(3, static_cast<cl_uint>(m));
+    if(post_mul) kernel.setArg(4, *post_mul);
 
     const size_t wg_mul = kernel.getWorkGroupInfo<CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE>(device);
     //const size_t max_cu = device.getInfo<CL_DEVICE_MAX_COMPUTE_UNITS>();
@@ -196,6 +210,131 @@ inline kernel_call radix_kernel(
 }
 
 
+// All radix passes of a transform in a single kernel. Each workgroup loads
+// one row into local memory, runs the Stockham passes there, and writes
+// the result back, so the data makes a single round trip to global memory.
+template <class T>
+inline void kernel_fused(std::ostringstream &o, size_t n, const std::vector<pow> &radixes, bool invert, size_t wg, bool post_mul = false) {
+    std::vector<size_t> done;
+    for(auto r = radixes.begin() ; r != radixes.end() ; r++) {
+        if(std::find(done.begin(), done.end(), r->value) != done.end()) continue;
+        o << in_place_dft(r->value, invert);
+        done.push_back(r->value);
+    }
+
+    o << "__kernel void fused(__global const real2_t *x, __global real2_t *y"
+      << (post_mul ? ", __global const real2_t *h" : "") << ") {\n"
+      << "  __local real2_t buf[" << n << "];\n"
+      << "  const size_t l = get_local_id(0);\n"
+      << "  const size_t batch_offset = get_global_id(1) * " << n << ";\n"
+      << "  x += batch_offset;\n"
+      << "  y += batch_offset;\n"
+      << "  for(size_t i = l ; i < " << n << " ; i += " << wg << ") buf[i] = x[i];\n"
+      << "  barrier(CLK_LOCAL_MEM_FENCE);\n";
+
+    size_t p = 1;
+    for(auto r = radixes.begin() ; r != radixes.end() ; r++) {
+        const size_t R = r->value, m = n / R, per = (m + wg - 1) / wg;
+
+        o << "  {\n";
+        for(size_t t = 0 ; t < per ; t++) {
+            o << "    const size_t i" << t << " = l + " << t * wg << ";\n"
+              << "    real2_t";
+            for(size_t j = 0 ; j < R ; j++)
+                o << (j ? ", " : " ") << "v" << t << "_" << j;
+            o << ";\n"
+              << "    if(i" << t << " < " << m << ") {\n"
+              << "      const size_t k = i" << t << " % " << p << ";\n";
+            for(size_t j = 0 ; j < R ; j++)
+                o << "      v" << t << "_" << j << " = buf[i" << t << " + " << j * m << "];\n";
+            if(p != 1) {
+                for(size_t j = 1 ; j < R ; j++) {
+                    const T alpha = -boost::math::constants::two_pi<T>() * j / R;
+                    o << "      v" << t << "_" << j << " = mul(v" << t << "_" << j << ", twiddle("
+                      << "(real_t)" << alpha << " * k / " << p << "));\n";
+                }
+            }
+            o << "      dft" << R << "(";
+            for(size_t j = 0 ; j < R ; j++)
+                o << (j ? ", " : "") << "&v" << t << "_" << j;
+            o << ");\n"
+              << "    }\n";
+        }
+        o << "    barrier(CLK_LOCAL_MEM_FENCE);\n";
+        for(size_t t = 0 ; t < per ; t++) {
+            o << "    if(i" << t << " < " << m << ") {\n"
+              << "      const size_t k = i" << t << " % " << p << ";\n"
+              << "      const size_t j = k + (i" << t << " - k) * " << R << ";\n";
+            for(size_t j = 0 ; j < R ; j++)
+                o << "      buf[j + " << j * p << "] = v" << t << "_" << j << ";\n";
+            o << "    }\n";
+        }
+        o << "    barrier(CLK_LOCAL_MEM_FENCE);\n"
+          << "  }\n";
+
+        p *= R;
+    }
+
+    o << "  for(size_t i = l ; i < " << n << " ; i += " << wg << ") y[i] = "
+      << (post_mul ? "mul(buf[i], h[i])" : "buf[i]") << ";\n"
+      << "}\n";
+}
+
+
+template <class T, class T2>
+inline kernel_call fused_kernel(
+        bool once, const backend::command_queue &queue, size_t n, size_t batch,
+        bool invert, const std::vector<pow> &radixes,
+        const backend::device_vector<T2> &in,
+        const backend::device_vector<T2> &out,
+        const backend::device_vector<T2> *post_mul = 0
+        )
+{
+    const auto device = qdev(queue);
+
+    // Largest number of butterflies in a pass.
+    size_t threads = 0;
+    for(auto r = radixes.begin() ; r != radixes.end() ; r++)
+        threads = std::max(threads, n / r->value);
+
+    size_t wg = std::min<size_t>(threads, std::min<size_t>(256,
+                device.getInfo<CL_DEVICE_MAX_WORK_GROUP_SIZE>()));
+
+    for(;;) {
+        std::ostringstream o;
+        o << std::setprecision(25);
+        kernel_common<T>(o, queue);
+        mul_code(o, invert);
+        twiddle_code<T>(o);
+        kernel_fused<T>(o, n, radixes, invert, wg, post_mul != 0);
+
+        auto program = backend::build_sources(queue, o.str(), "-cl-mad-enable -cl-fast-relaxed-math");
+        cl::Kernel kernel(program, "fused");
+
+        // Register hungry kernels may not support the requested workgroup size.
+        const size_t max_wg = kernel.getWorkGroupInfo<CL_KERNEL_WORK_GROUP_SIZE>(device);
+        if(wg > max_wg && wg > 1) {
+            wg = std::max<size_t>(1, std::min(max_wg, wg / 2));
+            continue;
+        }
+
+        kernel.setArg(0, in);
+        kernel.setArg(1, out);
+        if(post_mul) kernel.setArg(2, *post_mul);
+
+        std::ostringstream desc;
+        desc << "fused{r=";
+        for(auto r = radixes.begin() ; r != radixes.end() ; r++) {
+            if(r != radixes.begin()) desc << '*';
+            desc << *r;
+        }
+        desc << ", n=" << n << ", batch=" << batch << ", wg=" << wg << "}";
+
+        return kernel_call(once, desc.str(), program, kernel, cl::NDRange(wg, batch), cl::NDRange(wg, 1));
+    }
+}
+
+
 template <class T, class T2>
 inline kernel_call transpose_kernel(
         const backend::command_queue &queue, size_t width, size_t height,
@@ -463,6 +602,244 @@ inline kernel_call bluestein_mul(
     return kernel_call(false, desc.str(), program, kernel, cl::NDRange(threads, batch), cl::NDRange(wg, 1));
 }
 
+// Real-to-complex post-processing: rows of n/2 complex values hold the
+// transform of real rows of length n packed as (x[2k], x[2k+1]). Produces
+// the n/2+1 nonredundant values of the real transform.
+template <class T, class T2>
+inline kernel_call r2c_post_kernel(
+        const backend::command_queue &queue, size_t n, size_t batch,
+        const backend::device_vector<T2> &in,
+        const backend::device_vector<T2> &out
+        )
+{
+    std::ostringstream o;
+    kernel_common<T>(o, queue);
+    mul_code(o, false);
+    twiddle_code<T>(o);
+
+    const size_t m = n / 2;
+
+    o << "__kernel void r2c_post("
+      << "__global const real2_t *input, __global real2_t *output, uint m) {\n"
+      << "  const size_t k = get_global_id(0), b = get_global_id(1);\n"
+      << "  if(k <= m) {\n"
+      << "    const real2_t z = input[b * m + (k == m ? 0 : k)];\n"
+      << "    const real2_t c = input[b * m + (k == 0 ? 0 : m - k)];\n"
+      << "    const real2_t e = (real2_t)(z.x + c.x, z.y - c.y) * (real_t)0.5;\n"
+      << "    const real2_t d = (real2_t)(z.y + c.y, c.x - z.x) * (real_t)0.5;\n"
+      << "    output[b * (m + 1) + k] = e + mul(d, twiddle(-M_PI * k / m));\n"
+      << "  }\n"
+      << "}\n";
+
+    auto program = backend::build_sources(queue, o.str());
+    cl::Kernel kernel(program, "r2c_post");
+    kernel.setArg(0, in);
+    kernel.setArg(1, out);
+    kernel.setArg(2, static_cast<cl_uint>(m));
+
+    const size_t wg = kernel.getWorkGroupInfo<CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE>(qdev(queue));
+    const size_t threads = alignup(m + 1, wg);
+
+    std::ostringstream desc;
+    desc << "r2c_post{n=" << n << "(" << threads << "), wg=" << wg << ", batch=" << batch << "}";
+    return kernel_call(false, desc.str(), program, kernel, cl::NDRange(threads, batch), cl::NDRange(wg, 1));
+}
+
+// Complex-to-real pre-processing: the inverse of r2c_post. Takes rows of
+// n/2+1 values of a hermitian spectrum and produces rows of n/2 values,
+// whose inverse transform gives real rows of length n packed as
+// (x[2k], x[2k+1]) and scaled by n.
+template <class T, class T2>
+inline kernel_call c2r_pre_kernel(
+        const backend::command_queue &queue, size_t n, size_t batch,
+        const backend::device_vector<T2> &in,
+        const backend::device_vector<T2> &out
+        )
+{
+    std::ostringstream o;
+    kernel_common<T>(o, queue);
+    mul_code(o, false);
+    twiddle_code<T>(o);
+
+    const size_t m = n / 2;
+
+    o << "__kernel void c2r_pre("
+      << "__global const real2_t *input, __global real2_t *output, uint m) {\n"
+      << "  const size_t k = get_global_id(0), b = get_global_id(1);\n"
+      << "  if(k < m) {\n"
+      << "    const real2_t a = input[b * (m + 1) + k];\n"
+      << "    const real2_t c = input[b * (m + 1) + m - k];\n"
+      << "    const real2_t e = (real2_t)(a.x + c.x, a.y - c.y);\n"
+      << "    const real2_t d = mul((real2_t)(a.x - c.x, a.y + c.y), twiddle(M_PI * k / m));\n"
+      << "    output[b * m + k] = (real2_t)(e.x - d.y, e.y + d.x);\n"
+      << "  }\n"
+      << "}\n";
+
+    auto program = backend::build_sources(queue, o.str());
+    cl::Kernel kernel(program, "c2r_pre");
+    kernel.setArg(0, in);
+    kernel.setArg(1, out);
+    kernel.setArg(2, static_cast<cl_uint>(m));
+
+    const size_t wg = kernel.getWorkGroupInfo<CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE>(qdev(queue));
+    const size_t threads = alignup(m, wg);
+
+    std::ostringstream desc;
+    desc << "c2r_pre{n=" << n << "(" << threads << "), wg=" << wg << ", batch=" << batch << "}";
+    return kernel_call(false, desc.str(), program, kernel, cl::NDRange(threads, batch), cl::NDRange(wg, 1));
+}
+
+// Copies the first n/2+1 values of each row of length n.
+template <class T, class T2>
+inline kernel_call half_spectrum_extract(
+        const backend::command_queue &queue, size_t n, size_t batch,
+        const backend::device_vector<T2> &in,
+        const backend::device_vector<T2> &out
+        )
+{
+    std::ostringstream o;
+    kernel_common<T>(o, queue);
+
+    const size_t h = n / 2 + 1;
+
+    o << "__kernel void half_spectrum_extract("
+      << "__global const real2_t *input, __global real2_t *output, uint n, uint h) {\n"
+      << "  const size_t k = get_global_id(0), b = get_global_id(1);\n"
+      << "  if(k < h) output[b * h + k] = input[b * n + k];\n"
+      << "}\n";
+
+    auto program = backend::build_sources(queue, o.str());
+    cl::Kernel kernel(program, "half_spectrum_extract");
+    kernel.setArg(0, in);
+    kernel.setArg(1, out);
+    kernel.setArg(2, static_cast<cl_uint>(n));
+    kernel.setArg(3, static_cast<cl_uint>(h));
+
+    const size_t wg = kernel.getWorkGroupInfo<CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE>(qdev(queue));
+    const size_t threads = alignup(h, wg);
+
+    std::ostringstream desc;
+    desc << "half_spectrum_extract{n=" << n << "(" << threads << "), wg=" << wg << ", batch=" << batch << "}";
+    return kernel_call(false, desc.str(), program, kernel, cl::NDRange(threads, batch), cl::NDRange(wg, 1));
+}
+
+// Restores rows of length n of a hermitian spectrum from their first n/2+1
+// values.
+template <class T, class T2>
+inline kernel_call half_spectrum_expand(
+        const backend::command_queue &queue, size_t n, size_t batch,
+        const backend::device_vector<T2> &in,
+        const backend::device_vector<T2> &out
+        )
+{
+    std::ostringstream o;
+    kernel_common<T>(o, queue);
+
+    const size_t h = n / 2 + 1;
+
+    o << "__kernel void half_spectrum_expand("
+      << "__global const real2_t *input, __global real2_t *output, uint n, uint h) {\n"
+      << "  const size_t k = get_global_id(0), b = get_global_id(1);\n"
+      << "  if(k < n) {\n"
+      << "    if(k < h) output[b * n + k] = input[b * h + k];\n"
+      << "    else {\n"
+      << "      const real2_t v = input[b * h + n - k];\n"
+      << "      output[b * n + k] = (real2_t)(v.x, -v.y);\n"
+      << "    }\n"
+      << "  }\n"
+      << "}\n";
+
+    auto program = backend::build_sources(queue, o.str());
+    cl::Kernel kernel(program, "half_spectrum_expand");
+    kernel.setArg(0, in);
+    kernel.setArg(1, out);
+    kernel.setArg(2, static_cast<cl_uint>(n));
+    kernel.setArg(3, static_cast<cl_uint>(h));
+
+    const size_t wg = kernel.getWorkGroupInfo<CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE>(qdev(queue));
+    const size_t threads = alignup(n, wg);
+
+    std::ostringstream desc;
+    desc << "half_spectrum_expand{n=" << n << "(" << threads << "), wg=" << wg << ", batch=" << batch << "}";
+    return kernel_call(false, desc.str(), program, kernel, cl::NDRange(threads, batch), cl::NDRange(wg, 1));
+}
+
+// Overlap-save input: pair p of the chunk gets blocks 2(first + p) and
+// 2(first + p) + 1 of real input as real and imaginary parts. Block b starts
+// at b * block - lhalo; values outside of the input are clamped.
+template <class T, class T2>
+inline kernel_call conv_gather_kernel(
+        const backend::command_queue &queue, size_t nfft, size_t block,
+        size_t lhalo, size_t batch,
+        const backend::device_vector<T2> &out
+        )
+{
+    std::ostringstream o;
+    kernel_common<T>(o, queue);
+
+    o << "__kernel void conv_gather(__global const real_t *x, __global real2_t *z, "
+      << "ulong n, ulong first, ulong block, ulong lhalo, uint nfft) {\n"
+      << "  const size_t t = get_global_id(0), p = get_global_id(1);\n"
+      << "  if(t < nfft) {\n"
+      << "    const long i0 = (long)(2 * (first + p) * block + t) - (long)lhalo;\n"
+      << "    const long i1 = i0 + (long)block;\n"
+      << "    z[p * nfft + t] = (real2_t)(\n"
+      << "      x[clamp(i0, (long)0, (long)n - 1)],\n"
+      << "      x[clamp(i1, (long)0, (long)n - 1)]);\n"
+      << "  }\n"
+      << "}\n";
+
+    auto program = backend::build_sources(queue, o.str());
+    cl::Kernel kernel(program, "conv_gather");
+    kernel.setArg(1, out);
+    kernel.setArg(4, static_cast<cl_ulong>(block));
+    kernel.setArg(5, static_cast<cl_ulong>(lhalo));
+    kernel.setArg(6, static_cast<cl_uint>(nfft));
+
+    const size_t wg = kernel.getWorkGroupInfo<CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE>(qdev(queue));
+    const size_t threads = alignup(nfft, wg);
+
+    std::ostringstream desc;
+    desc << "conv_gather{n=" << nfft << "(" << threads << "), wg=" << wg << ", batch=" << batch << "}";
+    return kernel_call(false, desc.str(), program, kernel, cl::NDRange(threads, batch), cl::NDRange(wg, 1));
+}
+
+// Overlap-save output: the first `block` values of both halves of each pair
+// are valid results.
+template <class T, class T2>
+inline kernel_call conv_scatter_kernel(
+        const backend::command_queue &queue, size_t nfft, size_t block, size_t batch,
+        const backend::device_vector<T2> &in
+        )
+{
+    std::ostringstream o;
+    kernel_common<T>(o, queue);
+
+    o << "__kernel void conv_scatter(__global const real2_t *z, __global real_t *y, "
+      << "ulong n, ulong first, ulong block, uint nfft, real_t alpha, int append) {\n"
+      << "  const size_t s = get_global_id(0), p = get_global_id(1);\n"
+      << "  if(s < block) {\n"
+      << "    const real2_t v = z[p * nfft + s];\n"
+      << "    const ulong i0 = 2 * (first + p) * block + s, i1 = i0 + block;\n"
+      << "    if(i0 < n) y[i0] = alpha * v.x + (append ? y[i0] : (real_t)0);\n"
+      << "    if(i1 < n) y[i1] = alpha * v.y + (append ? y[i1] : (real_t)0);\n"
+      << "  }\n"
+      << "}\n";
+
+    auto program = backend::build_sources(queue, o.str());
+    cl::Kernel kernel(program, "conv_scatter");
+    kernel.setArg(0, in);
+    kernel.setArg(4, static_cast<cl_ulong>(block));
+    kernel.setArg(5, static_cast<cl_uint>(nfft));
+
+    const size_t wg = kernel.getWorkGroupInfo<CL_KERNEL_PREFERRED_WORK_GROUP_SIZE_MULTIPLE>(qdev(queue));
+    const size_t threads = alignup(block, wg);
+
+    std::ostringstream desc;
+    desc << "conv_scatter{n=" << nfft << ", block=" << block << "(" << threads << "), wg=" << wg << ", batch=" << batch << "}";
+    return kernel_call(false, desc.str(), program, kernel, cl::NDRange(threads, batch), cl::NDRange(wg, 1));
+}
+
 /// \endcond
 
 } // namespace fft
@@ -34,9 +34,18 @@ THE SOFTWARE.
 #include <cmath>
 #include <queue>
 #include <numeric>
+#include <map>
+#include <list>
+#include <mutex>
+#include <limits>
+#include <memory>
+#include <fstream>
+#include <functional>
 
 #include <vexcl/profiler.hpp>
 #include <vexcl/vector.hpp>
+#include <vexcl/vector_view.hpp>
+#include <vexcl/element_index.hpp>
 #include <vexcl/backend/opencl/fft/unrolled_dft.hpp>
 #include <vexcl/backend/opencl/fft/kernels.hpp>
 
@@ -110,28 +119,47 @@ inline size_t next_prime_power(Iterator begin, Iterator end, size_t target, size
 
 struct planner {
     const size_t max_size;
+    const bool fused;
+    const bool measure;
     std::vector<size_t> primes;
 
-    planner(size_t s = 25) : max_size(std::min(s, supported_kernel_sizes().back())) {
+    // \param fused
+    //  Use a single kernel for transforms that fit into local memory.
+    // \param measure
+    //  Time alternative factorizations and use the fastest one. The results
+    //  are stored in the wisdom file and reused in the following runs.
+    planner(size_t s = 25, bool fused = true, bool measure = false)
+        : max_size(std::min(s, supported_kernel_sizes().back())),
+          fused(fused), measure(measure)
+    {
         auto ps = supported_primes();
         for(auto i = ps.begin() ; i != ps.end() ; i++)
             if(*i <= s) primes.push_back(*i);
     }
 
+    // whether all passes of the factorized transform should run in a single
+    // kernel, given the size of the data in bytes and available local memory.
+    bool fuse(const std::vector<pow> &radixes, size_t bytes, size_t local_mem) const {
+        if(!fused || radixes.size() < 2 || bytes > local_mem) return false;
+        for(auto r = radixes.begin() ; r != radixes.end() ; r++)
+            if(r->exponent == 0) return false; // needs Bluestein.
+        return true;
+    }
+
     // returns the size the data must be padded to.
     size_t best_size(size_t n) const {
         return next_prime_power(primes.begin(), primes.end(), n);
     }
 
     // splits n into a list of powers 2^a 2^b 2^c 3^d 5^e...
-    // exponents are limited by available kernels,
+    // exponents are limited by available kernels and max_radix,
     // if no kernel for prime is available, exponent will be 0, interpret as 1.
-    std::vector<pow> factor(size_t n) const {
+    std::vector<pow> factor(size_t n, size_t max_radix = 0) const {
         std::vector<pow> out, factors = prime_factors(n);
         for(auto f = factors.begin() ; f != factors.end() ; f++) {
             if(std::find(primes.begin(), primes.end(), f->base) != primes.end()) {
                 // split exponent into reasonable parts.
-                auto qs = stages(*f);
+                auto qs = stages(*f, max_radix ? std::min(max_radix, max_size) : max_size);
                 // use smallest radix first
                 std::copy(qs.rbegin(), qs.rend(), std::back_inserter(out));
             } else {
@@ -144,8 +172,9 @@ struct planner {
     }
 
   private:
-    std::vector<pow> stages(pow p) const {
-        size_t t = static_cast<size_t>(std::log(max_size + 1.0) / std::log(static_cast<double>(p.base)));
+    std::vector<pow> stages(pow p, size_t max_radix) const {
+        size_t t = std::max<size_t>(1, static_cast<size_t>(
+                    std::log(max_radix + 1.0) / std::log(static_cast<double>(p.base))));
         std::vector<pow> fs;
 #ifdef FFT_SIMPLE_PLANNER
         // use largest radixes, i.e. 2^4 2^4 2^1
@@ -176,6 +205,115 @@ struct planner {
 };
 
 
+// Factorization of a transform chosen by the measuring planner.
+struct factorization {
+    size_t max_radix;
+    bool   fused;
+};
+
+// Measured factorizations, keyed by device, precision, size, and batch.
+inline std::map<std::string, factorization>& wisdom() {
+    static std::map<std::string, factorization> w;
+    return w;
+}
+
+// Set when wisdom() holds measurements that are not saved yet.
+inline bool& wisdom_modified() {
+    static bool m = false;
+    return m;
+}
+
+// Guards wisdom() and wisdom_modified(). Plans are measured concurrently
+// from different threads.
+inline std::mutex& wisdom_mutex() {
+    static std::mutex m;
+    return m;
+}
+
+// Writes wisdom() to the file. The caller holds wisdom_mutex().
+inline bool write_wisdom(const std::string &fname) {
+    try {
+        boost::filesystem::path dir = boost::filesystem::path(fname).parent_path();
+        if (!dir.empty()) boost::filesystem::create_directories(dir);
+    } catch(...) {
+        return false;
+    }
+
+    std::ofstream f(fname);
+    if (!f) return false;
+
+    for(auto w = wisdom().begin(); w != wisdom().end(); ++w)
+        f << w->first << '\t' << w->second.max_radix << '\t' << w->second.fused << '\n';
+
+    if (!f) return false;
+
+    wisdom_modified() = false;
+    return true;
+}
+
+/// \endcond
+
+/// Default location of the FFT wisdom file.
+inline std::string wisdom_file() {
+    return appdata_path() + path_delim() + "fft.wisdom";
+}
+
+/// Reads factorizations measured in previous runs.
+/**
+ * Returns false if the file could not be read.
+ */
+inline bool import_wisdom(const std::string &fname = wisdom_file()) {
+    std::ifstream f(fname);
+    if (!f) return false;
+
+    std::map<std::string, factorization> w;
+    std::string line;
+    while(std::getline(f, line)) {
+        // key <tab> max_radix <tab> fused
+        size_t p2 = line.rfind('\t');
+        if (p2 == std::string::npos || p2 == 0) continue;
+        size_t p1 = line.rfind('\t', p2 - 1);
+        if (p1 == std::string::npos) continue;
+
+        factorization c;
+        std::istringstream v(line.substr(p1 + 1));
+        if (v >> c.max_radix >> c.fused)
+            w[line.substr(0, p1)] = c;
+    }
+
+    std::lock_guard<std::mutex> lock(wisdom_mutex());
+    for(auto i = w.begin(); i != w.end(); ++i)
+        wisdom()[i->first] = i->second;
+
+    return true;
+}
+
+/// Saves measured factorizations for the following runs.
+/**
+ * New measurements are saved to the default file by purge_plan_cache() and at
+ * program exit, so this only needs to be called to save them elsewhere or
+ * earlier. Returns false if the file could not be written.
+ */
+inline bool export_wisdom(const std::string &fname = wisdom_file()) {
+    std::lock_guard<std::mutex> lock(wisdom_mutex());
+    return write_wisdom(fname);
+}
+
+/// \cond INTERNAL
+
+// Saves new measurements to the default file.
+inline void save_wisdom() {
+    std::lock_guard<std::mutex> lock(wisdom_mutex());
+    if (wisdom_modified()) write_wisdom(wisdom_file());
+}
+
+// Saves new measurements at program exit.
+struct wisdom_saver {
+    ~wisdom_saver() {
+        save_wisdom();
+    }
+};
+
 template <class Tv, class Planner = planner>
 struct plan {
     typedef typename cl_scalar_of<Tv>::type Ts;
@@ -190,15 +328,69 @@ struct plan {
     VEX_FUNCTION(r2c, T2(Ts), "return (" + type_name<T2>() + ")(prm1, 0);");
     VEX_FUNCTION(c2r, Ts(T2), "return prm1.x;");
 
-    const std::vector<backend::command_queue> &queues;
+    // Multiplies element (j, k) of a matrix with m columns by exp(i * alpha * j * k).
+    VEX_FUNCTION(twiddle_mul, T2(T2, size_t, size_t, size_t, Ts),
+            "ulong j = prm2 / prm3, k = prm2 % prm3;\n"
+            + type_name<Ts>() + " phi = prm5 * ((j * k) % prm4);\n"
+            + type_name<Ts>() + " cs = cos(phi), sn = sin(phi);\n"
+            "return (" + type_name<T2>() + ")("
+            "prm1.x * cs - prm1.y * sn, prm1.x * sn + prm1.y * cs);");
+
+    const std::vector<backend::command_queue> queues;
     Planner planner;
     Ts scale;
     const std::vector<size_t> sizes;
 
+    // Real-to-complex (real Tv) or complex-to-real (complex Tv) transform
+    // storing only the n/2+1 nonredundant values along the last dimension.
+    bool half;
+    // Half-spectrum transform of even length, computed with a complex
+    // transform of half the length.
+    bool packed;
+
     std::vector<kernel_call> kernels;
 
     size_t input, output;
     std::vector< vex::vector<T2> > bufs;
+    std::vector< cl::Buffer > raw;
+    std::vector< std::shared_ptr<backend::detail::memory_registry::record> > tracked;
+
+    // Views of the input and output buffers.
+    vex::vector<T2> cinput, coutput;
+    vex::vector<Ts> rinput, routput;
+
+    // Multi-device transform. The data is a matrix distributed between
+    // devices by rows. Each step is either a batched transform of the local
+    // rows, twiddle multiplication (four-step 1D transform), or a global
+    // transposition.
+    struct dist_step {
+        enum step_kind { rows, twiddle, transpose } kind;
+
+        // The matrix is n x m.
+        size_t n, m;
+
+        // Row transforms: sizes and directions of a single row.
+        std::vector<size_t> row_sizes;
+        std::vector<direction> row_dirs;
+        std::vector< std::shared_ptr< plan<T2, Planner> > > local;
+
+        // Twiddle multiplication.
+        size_t length;
+        Ts alpha;
+
+        // Local transpositions of the received blocks.
+        std::vector< std::shared_ptr<kernel_call> > trans;
+
+        dist_step(step_kind kind, size_t n, size_t m)
+            : kind(kind), n(n), m(m), length(0), alpha(0) {}
+    };
+
+    std::vector<dist_step> steps;
+
+    // Matrix data, received blocks, and blocks packed for each destination.
+    std::vector< vex::vector<T2> > data, recv;
+    std::vector< std::vector< vex::vector<T2> > > pack;
+    std::vector<T2> host;
 
     profiler<> *profile;
 
@@ -206,24 +398,52 @@ struct plan {
     //  1D case: {n}.
     //  2D case: {h, w} in row-major format: x + y * w. (like FFTw)
     //  etc.
+    // \param half
+    //  Real input is transformed into (or complex input is transformed
+    //  back from) a {..., w/2+1} hermitian half-spectrum.
     plan(const std::vector<backend::command_queue> &_queues, const std::vector<size_t> sizes,
-        const std::vector<direction> dirs, const Planner &planner = Planner())
-        : queues(_queues), planner(planner), sizes(sizes), profile(NULL)
+        const std::vector<direction> dirs, const Planner &planner = Planner(),
+        bool half = false)
+        : queues(_queues), planner(planner), sizes(sizes), half(half),
+          packed(half && sizes.back() % 2 == 0), profile(NULL)
     {
+        memory_owner owner("FFT");
+
         assert(sizes.size() >= 1);
         assert(sizes.size() == dirs.size());
 
+        if (queues.size() > 1) {
+            precondition(!half,
+                    "Half-spectrum FFT is only supported for single-device contexts."
+                    );
+            plan_distributed(dirs);
+            return;
+        }
+
+        const bool real_in = cl_vector_length<Tv>::value == 1;
+
         precondition(
-                queues.size() == 1,
-                "FFT is only supported for single-device contexts."
+                !half || dirs.back() == (real_in ? forward : inverse),
+                "Half-spectrum FFT requires forward real-to-complex or inverse complex-to-real transform along the last dimension."
                 );
 
         auto queue   = queues[0];
 
+        const size_t last = sizes.size() - 1;
+
         size_t total_n = std::accumulate(sizes.begin(), sizes.end(),
             static_cast<size_t>(1), std::multiplies<size_t>());
-        size_t current = bufs.size(); bufs.push_back(vex::vector<T2>(queues, total_n));
-        size_t other   = bufs.size(); bufs.push_back(vex::vector<T2>(queues, total_n));
+
+        // Sizes of the complex data.
+        std::vector<size_t> csizes = sizes;
+        if (half) csizes[last] = sizes[last] / 2 + 1;
+
+        const size_t n     = sizes[last];
+        const size_t rows  = total_n / n;
+        const size_t total_c = rows * csizes[last];
+
+        size_t current = alloc(packed ? total_c : total_n);
+        size_t other   = alloc(packed ? total_c : total_n);
 
         size_t inv_n = 1;
         for(size_t i = 0 ; i < sizes.size() ; i++)
@@ -231,28 +451,259 @@ struct plan {
                 inv_n *= sizes[i];
         scale = (Ts)1 / inv_n;
 
+        const bool batched = dirs.size() == 2 && dirs[0] == none;
+
         // Build the list of kernels.
         input = current;
-        for(size_t i = 1 ; i <= sizes.size() ; i++) {
-            const size_t j = sizes.size() - i;
-            const size_t w = sizes[j], h = total_n / w;
+        if (!half) {
+            plan_dimensions(sizes, dirs, sizes.size(), current, other);
+
+            cinput = view(input, total_n);
+        } else if (real_in) {
+            // Transform the rows, keep the first n/2+1 values of each.
+            if (packed) {
+                plan_cooley_tukey(false, n / 2, rows, current, other, false);
+                kernels.push_back(r2c_post_kernel<Ts>(queue, n, rows, bufs[current](), bufs[other]()));
+            } else {
+                plan_cooley_tukey(false, n, rows, current, other, false);
+                kernels.push_back(half_spectrum_extract<Ts>(queue, n, rows, bufs[current](), bufs[other]()));
+            }
+            std::swap(current, other);
+
+            if (csizes[last] > 1 && rows > 1 && !batched) {
+                kernels.push_back(transpose_kernel<Ts>(queue, csizes[last], rows, bufs[current](), bufs[other]()));
+                std::swap(current, other);
+            }
+
+            plan_dimensions(csizes, dirs, last, current, other);
+
+            if (packed)
+                rinput = real_view(input, total_n);
+            else
+                cinput = view(input, total_n);
+        } else {
+            cinput = view(input, total_c);
+
+            if (csizes[last] > 1 && rows > 1 && !batched) {
+                kernels.push_back(transpose_kernel<Ts>(queue, csizes[last], rows, bufs[current](), bufs[other]()));
+                std::swap(current, other);
+            }
+
+            plan_dimensions(csizes, dirs, last, current, other);
+
+            // Restore the rows from their halves and transform them.
+            if (packed) {
+                kernels.push_back(c2r_pre_kernel<Ts>(queue, n, rows, bufs[current](), bufs[other]()));
+                std::swap(current, other);
+                plan_cooley_tukey(true, n / 2, rows, current, other, false);
+
+                routput = real_view(current, total_n);
+            } else {
+                kernels.push_back(half_spectrum_expand<Ts>(queue, n, rows, bufs[current](), bufs[other]()));
+                std::swap(current, other);
+                plan_cooley_tukey(true, n, rows, current, other, false);
+
+                // Real parts are extracted into the other buffer.
+                routput = real_view(other, total_n);
+            }
+        }
+        output = current;
+
+        coutput = view(output, half && real_in ? total_c : total_n);
+    }
+
+    void plan_distributed(const std::vector<direction> &dirs) {
+        const size_t total_n = std::accumulate(sizes.begin(), sizes.end(),
+            static_cast<size_t>(1), std::multiplies<size_t>());
+
+        scale = 1; // Local plans are scaled.
+
+        cinput  = vex::vector<T2>(queues, total_n);
+        coutput = vex::vector<T2>(queues, total_n);
+
+        if (sizes.size() == 1) {
+            // Four-step transform: n = a * b is viewed as a x b matrix.
+            const size_t n = sizes[0];
+            size_t a = static_cast<size_t>(std::sqrt(static_cast<double>(n)));
+            while(a > 1 && n % a) --a;
+            const size_t b = n / a;
+
+            precondition(a > 1 || n == 1 || dirs[0] == none,
+                    "Multi-device FFT of prime length is not supported."
+                    );
+
+            if (a > 1 && dirs[0] != none) {
+                const Ts sign = dirs[0] == inverse ? 1 : -1;
+
+                steps.push_back(dist_step(dist_step::transpose, a, b));
+                add_rows(b, a, std::vector<size_t>(1, a), dirs);
+
+                steps.push_back(dist_step(dist_step::twiddle, b, a));
+                steps.back().length = n;
+                steps.back().alpha  = sign * boost::math::constants::two_pi<Ts>() / n;
+
+                steps.push_back(dist_step(dist_step::transpose, b, a));
+                add_rows(a, b, std::vector<size_t>(1, b), dirs);
+                steps.push_back(dist_step(dist_step::transpose, a, b));
+            }
+        } else {
+            // Local rows are transformed along all but the first dimension,
+            // then the matrix is transposed, transformed along the
+            // first dimension, and transposed back.
+            const size_t n = sizes[0], m = total_n / n;
+
+            add_rows(n, m,
+                    std::vector<size_t>(sizes.begin() + 1, sizes.end()),
+                    std::vector<direction>(dirs.begin() + 1, dirs.end()));
+
+            if (dirs[0] != none && n > 1) {
+                steps.push_back(dist_step(dist_step::transpose, n, m));
+                add_rows(m, n, std::vector<size_t>(1, n), std::vector<direction>(1, dirs[0]));
+                steps.push_back(dist_step(dist_step::transpose, m, n));
+            }
+        }
+
+        // Allocate buffers.
+        const size_t ndev = queues.size();
+        std::vector<size_t> dsize(ndev, 0);
+        std::vector< std::vector<size_t> > psize(ndev, std::vector<size_t>(ndev, 0));
+
+        for(auto s = steps.begin(); s != steps.end(); ++s) {
+            std::vector<size_t> part = vex::partition(s->n, queues);
+            for(size_t d = 0; d < ndev; ++d)
+                dsize[d] = std::max(dsize[d], (part[d + 1] - part[d]) * s->m);
+
+            if (s->kind == dist_step::transpose) {
+                std::vector<size_t> cols = vex::partition(s->m, queues);
+                for(size_t i = 0; i < ndev; ++i)
+                    for(size_t j = 0; j < ndev; ++j)
+                        psize[i][j] = std::max(psize[i][j],
+                                (part[i + 1] - part[i]) * (cols[j + 1] - cols[j]));
+            }
+        }
+
+        auto buffer = [&](size_t d, size_t n) {
+            return vex::vector<T2>(queues[d], backend::device_vector<T2>(queues[d], std::max<size_t>(1, n)));
+        };
+
+        pack.resize(ndev);
+        for(size_t d = 0; d < ndev; ++d) {
+            data.push_back(buffer(d, dsize[d]));
+            recv.push_back(buffer(d, dsize[d]));
+            for(size_t j = 0; j < ndev; ++j)
+                pack[d].push_back(buffer(d, psize[d][j]));
+        }
+
+        // Local plans and transpositions.
+        for(auto s = steps.begin(); s != steps.end(); ++s) {
+            if (s->kind == dist_step::rows) {
+                std::vector<size_t> part = vex::partition(s->n, queues);
+                for(size_t d = 0; d < ndev; ++d) {
+                    if (part[d + 1] == part[d]) {
+                        s->local.push_back(std::shared_ptr< plan<T2, Planner> >());
+                        continue;
+                    }
+
+                    std::vector<size_t> ls(1, part[d + 1] - part[d]);
+                    std::vector<direction> ld(1, none);
+                    ls.insert(ls.end(), s->row_sizes.begin(), s->row_sizes.end());
+                    ld.insert(ld.end(), s->row_dirs.begin(), s->row_dirs.end());
+
+                    s->local.push_back(std::make_shared< plan<T2, Planner> >(
+                                std::vector<backend::command_queue>(1, queues[d]),
+                                ls, ld, planner));
+                }
+            } else if (s->kind == dist_step::transpose) {
+                // Received blocks form n x cols[d] matrix.
+                std::vector<size_t> cols = vex::partition(s->m, queues);
+                for(size_t d = 0; d < ndev; ++d) {
+                    if (cols[d + 1] == cols[d]) {
+                        s->trans.push_back(std::shared_ptr<kernel_call>());
+                        continue;
+                    }
+
+                    s->trans.push_back(std::make_shared<kernel_call>(
+                                transpose_kernel<Ts>(queues[d], cols[d + 1] - cols[d], s->n,
+                                    recv[d](0), data[d](0))));
+                }
+            }
+        }
+    }
+
+    // Adds batched transform of the rows of n x m matrix, unless all
+    // directions are none.
+    void add_rows(size_t n, size_t m, const std::vector<size_t> &row_sizes,
+            const std::vector<direction> &row_dirs)
+    {
+        if (std::count(row_dirs.begin(), row_dirs.end(), none) ==
+                static_cast<ptrdiff_t>(row_dirs.size())) return;
+
+        steps.push_back(dist_step(dist_step::rows, n, m));
+        steps.back().row_sizes = row_sizes;
+        steps.back().row_dirs  = row_dirs;
+    }
+
+    // Transforms along the first ndim dimensions of the array, starting
+    // with the last one. The array is transposed after each dimension, so
+    // that the next one becomes contiguous.
+    void plan_dimensions(const std::vector<size_t> &ns, const std::vector<direction> &dirs,
+            size_t ndim, size_t &current, size_t &other)
+    {
+        size_t total_n = std::accumulate(ns.begin(), ns.end(),
+            static_cast<size_t>(1), std::multiplies<size_t>());
+
+        for(size_t i = 1 ; i <= ndim ; i++) {
+            const size_t j = ndim - i;
+            const size_t w = ns[j], h = total_n / w;
             if(w > 1) {
                 // 1D, each row.
                 if(dirs[j] != none)
                     plan_cooley_tukey(dirs[j] == inverse, w, h, current, other, false);
 
                 if(h > 1 && !(dirs.size() == 2 && dirs[0] == none)) {
-                    kernels.push_back(transpose_kernel<Ts>(queue, w, h, bufs[current](), bufs[other]()));
+                    kernels.push_back(transpose_kernel<Ts>(queues[0], w, h, bufs[current](), bufs[other]()));
                     std::swap(current, other);
                 }
             }
         }
-        output = current;
+    }
+
+    // Allocates a buffer of n complex values that may be viewed as 2n real values.
+    size_t alloc(size_t n) {
+        raw.push_back(cl::Buffer(queues[0].getInfo<CL_QUEUE_CONTEXT>(),
+                    CL_MEM_READ_WRITE, sizeof(T2) * n));
+        tracked.push_back(backend::detail::track_allocation(queues[0], sizeof(T2) * n));
+        bufs.push_back(vex::vector<T2>(queues[0], backend::device_vector<T2>(raw.back())));
+        return bufs.size() - 1;
+    }
+
+    vex::vector<T2> view(size_t b, size_t n) const {
+        return vex::vector<T2>(queues[0], backend::device_vector<T2>(raw[b]), n);
+    }
+
+    vex::vector<Ts> real_view(size_t b, size_t n) const {
+        return vex::vector<Ts>(queues[0], backend::device_vector<Ts>(raw[b]), n);
     }
 
     void plan_cooley_tukey(bool inverse, size_t n, size_t batch, size_t &current, size_t &other, bool once) {
+        factorization f = {planner.max_size, planner.fused};
+        if(planner.measure) f = measure(inverse, n, batch, current, other);
+        plan_passes(f, inverse, n, batch, current, other, once);
+    }
+
+    void plan_passes(factorization f, bool inverse, size_t n, size_t batch, size_t &current, size_t &other, bool once) {
         size_t p = 1;
-        auto rs = planner.factor(n);
+        auto rs = planner.factor(n, f.max_radix);
+
+        if(f.fused && planner.fuse(rs, n * sizeof(T2),
+                    qdev(queues[0]).getInfo<CL_DEVICE_LOCAL_MEM_SIZE>()))
+        {
+            kernels.push_back(fused_kernel<Ts>(once, queues[0], n, batch,
+                inverse, rs, bufs[current](), bufs[other]()));
+            std::swap(current, other);
+            return;
+        }
+
         for(auto r = rs.begin() ; r != rs.end() ; r++) {
             if(r->exponent == 0) {
                 plan_bluestein(n, batch, inverse, r->base, p, current, other);
@@ -266,6 +717,91 @@ struct plan {
         }
     }
 
+    // Times alternative factorizations of the transform, or looks up the
+    // result of previous measurements.
+    factorization measure(bool inverse, size_t n, size_t batch, size_t current, size_t other) {
+        factorization best = {planner.max_size, planner.fused};
+
+        // Bluestein transforms allocate own buffers; do not measure those.
+        auto rs = planner.factor(n);
+        for(auto r = rs.begin() ; r != rs.end() ; r++)
+            if(r->exponent == 0) return best;
+
+        auto dev = qdev(queues[0]);
+
+        std::ostringstream key;
+        key << cl::Platform(dev.getInfo<CL_DEVICE_PLATFORM>()).getInfo<CL_PLATFORM_NAME>()
+            << '\t' << dev.getInfo<CL_DEVICE_NAME>()
+            << '\t' << type_name<Ts>() << '\t' << n << '\t' << batch;
+
+        static bool imported = import_wisdom();
+        (void)imported;
+
+        {
+            std::lock_guard<std::mutex> lock(wisdom_mutex());
+            auto w = wisdom().find(key.str());
+            if (w != wisdom().end()) {
+                best.max_radix = std::min(w->second.max_radix, planner.max_size);
+                best.fused     = w->second.fused && planner.fused;
+                return best;
+            }
+        }
+
+        std::vector<factorization> candidates;
+        const size_t radix[] = {4, 8, 16, 25};
+        for(int fused = planner.fused ; fused >= 0 ; --fused) {
+            std::vector< std::vector<size_t> > seen;
+            for(size_t i = 0 ; i < sizeof(radix) / sizeof(radix[0]) ; ++i) {
+                if(radix[i] > planner.max_size) break;
+
+                std::vector<size_t> f;
+                auto rs = planner.factor(n, radix[i]);
+                for(auto r = rs.begin() ; r != rs.end() ; r++) f.push_back(r->value);
+
+                if(std::find(seen.begin(), seen.end(), f) != seen.end()) continue;
+                seen.push_back(f);
+
+                factorization c = {radix[i], fused != 0};
+                candidates.push_back(c);
+            }
+        }
+
+        double best_time = std::numeric_limits<double>::max();
+        for(auto c = candidates.begin() ; c != candidates.end() ; ++c) {
+            size_t start = kernels.size(), cur = current, oth = other;
+            plan_passes(*c, inverse, n, batch, cur, oth, false);
+
+            stopwatch<> watch;
+            for(int i = 0 ; i < 6 ; ++i) {
+                watch.tic();
+                for(auto k = kernels.begin() + start; k != kernels.end(); ++k)
+                    queues[0].enqueueNDRangeKernel(k->kernel, cl::NullRange, k->global, k->local);
+                queues[0].finish();
+                // The first run is a warm up.
+                if (i) watch.toc();
+            }
+
+            kernels.erase(kernels.begin() + start, kernels.end());
+
+            if (watch.average() < best_time) {
+                best_time = watch.average();
+                best = *c;
+            }
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(wisdom_mutex());
+            wisdom()[key.str()] = best;
+            wisdom_modified() = true;
+        }
+
+        // Constructed after wisdom() and wisdom_mutex(), so destroyed before them.
+        static wisdom_saver saver;
+        (void)saver;
+
+        return best;
+    }
+
     void plan_bluestein(size_t width, size_t batch, bool inverse, size_t n, size_t p, size_t &current, size_t &other) {
         size_t conv_n = planner.best_size(2 * n);
         size_t threads = width / n;
@@ -320,10 +856,15 @@ struct plan {
             profile->tic_cl(prof_name.str());
             profile->tic_cl("in");
         }
-        vector<T2> &in_c = bufs[input];
-        if(cl_vector_length<Tv>::value == 1) in_c = r2c(in);
-        else in_c = in;
+        if(packed && cl_vector_length<Tv>::value == 1) rinput = in;
+        else if(cl_vector_length<Tv>::value == 1) cinput = r2c(in);
+        else cinput = in;
         if(profile) profile->toc("in");
+        if(queues.size() > 1) {
+            if(profile) profile->tic_cl("distributed");
+            transform_distributed();
+            if(profile) profile->toc("distributed");
+        }
         for(auto run = kernels.begin(); run != kernels.end(); ++run) {
             if(!run->once || run->count == 0) {
 #ifdef FFT_DUMP_ARRAYS
@@ -348,29 +889,191 @@ struct plan {
         for(auto b = bufs.begin(); b != bufs.end(); ++b)
             std::cerr << "   " << (*b)()() << " = " << (*b) << std::endl;
 #endif
+        if(half && !packed && cl_vector_length<Tv>::value == 2) {
+            if(profile) profile->tic_cl("out");
+            routput = c2r(coutput);
+            if(profile) profile->toc("out");
+        }
         if (profile) profile->toc("");
     }
 
+    // Contiguous copy between device buffers.
+    struct transfer {
+        size_t src_dev, dst_dev;
+        backend::device_vector<T2> src, dst;
+        size_t src_offset, dst_offset, size;
+
+        transfer(size_t sd, const backend::device_vector<T2> &s, size_t so,
+                 size_t dd, const backend::device_vector<T2> &d, size_t doff,
+                 size_t n)
+            : src_dev(sd), dst_dev(dd), src(s), dst(d),
+              src_offset(so), dst_offset(doff), size(n) {}
+    };
+
+    // Copies the blocks between devices. Devices sharing a context copy
+    // directly, others through host memory. The copies are enqueued to the
+    // destination queues, so that each device may proceed as soon as its
+    // own blocks are in place.
+    void exchange(const std::vector<transfer> &t) {
+        for(auto q = queues.begin(); q != queues.end(); ++q) q->finish();
+
+        size_t staged = 0;
+        for(auto c = t.begin(); c != t.end(); ++c)
+            if (backend::cache_key(queues[c->src_dev]) != backend::cache_key(queues[c->dst_dev]))
+                staged += c->size;
+
+        host.resize(staged);
+
+        staged = 0;
+        for(auto c = t.begin(); c != t.end(); ++c) {
+            if (backend::cache_key(queues[c->src_dev]) == backend::cache_key(queues[c->dst_dev])) {
+                c->dst.copy_from(queues[c->dst_dev], c->src, c->src_offset, c->dst_offset, c->size);
+            } else {
+                c->src.read(queues[c->src_dev], c->src_offset, c->size, host.data() + staged);
+                staged += c->size;
+            }
+        }
+
+        if (!staged) return;
+
+        for(auto q = queues.begin(); q != queues.end(); ++q) q->finish();
+
+        staged = 0;
+        for(auto c = t.begin(); c != t.end(); ++c) {
+            if (backend::cache_key(queues[c->src_dev]) != backend::cache_key(queues[c->dst_dev])) {
+                c->dst.write(queues[c->dst_dev], c->dst_offset, c->size, host.data() + staged);
+                staged += c->size;
+            }
+        }
+    }
+
+    // Moves the data between the partitioning of a vector and the rows of
+    // the n x m matrix.
+    void redistribute(const vex::vector<T2> &x, size_t n, size_t m, bool to_matrix) {
+        const size_t ndev = queues.size();
+        std::vector<size_t> part = vex::partition(n, queues);
+        std::vector<transfer> t;
+
+        for(size_t i = 0; i < ndev; ++i) {
+            const size_t xb = x.part_start(i), xe = xb + x.part_size(i);
+            for(size_t j = 0; j < ndev; ++j) {
+                const size_t mb = part[j] * m, me = part[j + 1] * m;
+                const size_t b = std::max(xb, mb), e = std::min(xe, me);
+                if (b >= e) continue;
+
+                if (to_matrix)
+                    t.push_back(transfer(i, x(i), b - xb, j, data[j](0), b - mb, e - b));
+                else
+                    t.push_back(transfer(j, data[j](0), b - mb, i, x(i), b - xb, e - b));
+            }
+        }
+
+        exchange(t);
+    }
+
+    void transform_distributed() {
+        const size_t ndev = queues.size();
+
+        if (steps.empty()) {
+            coutput = cinput;
+            return;
+        }
+
+        redistribute(cinput, steps.front().n, steps.front().m, true);
+
+        for(auto s = steps.begin(); s != steps.end(); ++s) {
+            std::vector<size_t> part = vex::partition(s->n, queues);
+
+            switch(s->kind) {
+                case dist_step::rows:
+                    for(size_t d = 0; d < ndev; ++d) {
+                        if (!s->local[d]) continue;
+                        vex::vector<T2> x(queues[d], data[d](0), (part[d + 1] - part[d]) * s->m);
+                        x = s->local[d]->template apply<T2>(x);
+                    }
+                    break;
+                case dist_step::twiddle:
+                    for(size_t d = 0; d < ndev; ++d) {
+                        if (part[d + 1] == part[d]) continue;
+                        vex::vector<T2> x(queues[d], data[d](0), (part[d + 1] - part[d]) * s->m);
+                        x = twiddle_mul(x, vex::element_index(part[d] * s->m), s->m, s->length, s->alpha);
+                    }
+                    break;
+                case dist_step::transpose:
+                    {
+                        // Each source packs the columns that belong to
+                        // each destination, the destination stacks the
+                        // blocks into n x cols matrix and transposes it.
+                        std::vector<size_t> cols = vex::partition(s->m, queues);
+                        std::vector<transfer> t;
+
+                        for(size_t i = 0; i < ndev; ++i) {
+                            const size_t rows = part[i + 1] - part[i];
+                            if (!rows) continue;
+
+                            vex::vector<T2> x(queues[i], data[i](0), rows * s->m);
+                            vex::slicer<2> slice(vex::extents[rows][s->m]);
+
+                            for(size_t j = 0; j < ndev; ++j) {
+                                const size_t w = cols[j + 1] - cols[j];
+                                if (!w) continue;
+
+                                vex::vector<T2> p(queues[i], pack[i][j](0), rows * w);
+                                p = slice[vex::range()][vex::range(cols[j], cols[j + 1])](x);
+
+                                t.push_back(transfer(i, pack[i][j](0), 0, j, recv[j](0), part[i] * w, rows * w));
+                            }
+                        }
+
+                        exchange(t);
+
+                        for(size_t d = 0; d < ndev; ++d) {
+                            if (!s->trans[d]) continue;
+                            queues[d].enqueueNDRangeKernel(s->trans[d]->kernel,
+                                    cl::NullRange, s->trans[d]->global, s->trans[d]->local);
+                        }
+                    }
+                    break;
+            }
+        }
+
+        redistribute(coutput, steps.back().kind == dist_step::transpose ?
+                steps.back().m : steps.back().n,
+                steps.back().kind == dist_step::transpose ?
+                steps.back().n : steps.back().m, false);
+    }
+
+    template <typename Tout, class Expr>
+    auto apply(const Expr &expr) ->
+        typename std::enable_if<
+            cl_vector_length<Tout>::value == 1 && cl_vector_length<Tv>::value == 1,
+            decltype( scale * c2r(coutput) )
+        >::type
+    {
+        transform(expr);
+        return scale * c2r(coutput);
+    }
+
     template <typename Tout, class Expr>
     auto apply(const Expr &expr) ->
         typename std::enable_if<
-            cl_vector_length<Tout>::value == 1,
-            decltype( scale * c2r(bufs[output]) )
+            cl_vector_length<Tout>::value == 1 && cl_vector_length<Tv>::value == 2,
+            decltype( scale * routput )
         >::type
     {
         transform(expr);
-        return scale * c2r(bufs[output]);
+        return scale * routput;
     }
 
     template <typename Tout, class Expr>
     auto apply(const Expr &expr) ->
         typename std::enable_if<
             cl_vector_length<Tout>::value == 2,
-            decltype( scale * bufs[output] )
+            decltype( scale * coutput )
         >::type
     {
         transform(expr);
-        return scale * bufs[output];
+        return scale * coutput;
     }
 
     std::string desc() const {
@@ -406,8 +1109,134 @@ inline std::ostream &operator<<(std::ostream &o, const plan<T,P> &p) {
     return o << "}";
 }
 
+#ifndef VEXCL_FFT_PLAN_CACHE_SIZE
+#  define VEXCL_FFT_PLAN_CACHE_SIZE 16
+#endif
+
+// Functions that release cached plans of every type.
+inline std::vector< std::function<void()> >& plan_cache_purgers() {
+    static std::vector< std::function<void()> > p;
+    return p;
+}
+
+inline std::mutex& plan_cache_purgers_mutex() {
+    static std::mutex m;
+    return m;
+}
+
+// Process-wide cache of idle plans. A plan released by the last FFT object
+// using it is kept here and handed to the next FFT with the same
+// configuration, so that compiled kernels and scratch buffers are reused.
+// At most VEXCL_FFT_PLAN_CACHE_SIZE idle plans are kept; the least recently
+// released ones are destroyed first.
+template <class Tv, class Planner>
+struct plan_cache {
+    typedef plan<Tv, Planner> plan_type;
+    typedef std::shared_ptr<plan_type> plan_ptr;
+
+    static plan_ptr get(
+            const std::vector<backend::command_queue> &queues,
+            const std::vector<size_t> &sizes,
+            const std::vector<direction> &dirs,
+            const Planner &planner, bool half)
+    {
+        std::ostringstream key;
+        for(auto q = queues.begin(); q != queues.end(); ++q)
+            key << backend::cache_key(*q) << ' ' << qdev(*q)() << ' ';
+        for(size_t i = 0; i < sizes.size(); ++i)
+            key << sizes[i] << ':' << dirs[i] << ' ';
+        key << half << ' ' << planner.max_size << ' '
+            << planner.fused << ' ' << planner.measure;
+
+        storage &c = cache();
+
+        {
+            std::lock_guard<std::mutex> lock(c.mx);
+            for(auto p = c.idle.begin(); p != c.idle.end(); ++p) {
+                if (p->first == key.str()) {
+                    plan_type *found = p->second;
+                    c.idle.erase(p);
+                    found->profile = NULL;
+                    return share(key.str(), found);
+                }
+            }
+        }
+
+        return share(key.str(), new plan_type(queues, sizes, dirs, planner, half));
+    }
+
+    private:
+        struct storage {
+            std::mutex mx;
+            // Most recently released plans first.
+            std::list< std::pair<std::string, plan_type*> > idle;
+        };
+
+        // The cache is never destroyed, so that plans released during static
+        // destruction still find it.
+        static storage& cache() {
+            static storage *c = create();
+            return *c;
+        }
+
+        static storage* create() {
+            storage *c = new storage;
+            std::lock_guard<std::mutex> lock(plan_cache_purgers_mutex());
+            plan_cache_purgers().push_back(purge);
+            return c;
+        }
+
+        // The returned pointer gives the plan back to the cache instead of
+        // destroying it.
+        static plan_ptr share(const std::string &key, plan_type *p) {
+            return plan_ptr(p, [key](plan_type *q) { release(key, q); });
+        }
+
+        static void release(const std::string &key, plan_type *p) {
+            std::vector<plan_type*> evicted;
+            {
+                storage &c = cache();
+                std::lock_guard<std::mutex> lock(c.mx);
+                c.idle.push_front(std::make_pair(key, p));
+                while(c.idle.size() > VEXCL_FFT_PLAN_CACHE_SIZE) {
+                    evicted.push_back(c.idle.back().second);
+                    c.idle.pop_back();
+                }
+            }
+            for(auto e = evicted.begin(); e != evicted.end(); ++e) delete *e;
+        }
+
+        static void purge() {
+            std::vector<plan_type*> evicted;
+            {
+                storage &c = cache();
+                std::lock_guard<std::mutex> lock(c.mx);
+                for(auto p = c.idle.begin(); p != c.idle.end(); ++p)
+                    evicted.push_back(p->second);
+                c.idle.clear();
+            }
+            for(auto e = evicted.begin(); e != evicted.end(); ++e) delete *e;
+        }
+};
+
 /// \endcond
 
+/// Releases compiled kernels and scratch buffers of the idle cached FFT plans.
+/**
+ * Also saves new measurements to the wisdom file.
+ * Plans used by existing FFT objects are released together with the objects.
+ */
+inline void purge_plan_cache() {
+    save_wisdom();
+
+    std::vector< std::function<void()> > p;
+    {
+        std::lock_guard<std::mutex> lock(plan_cache_purgers_mutex());
+        p = plan_cache_purgers();
+    }
+    for(auto f = p.begin(); f != p.end(); ++f) (*f)();
+}
+
 } // namespace fft
 } // namespace vex
 #endif
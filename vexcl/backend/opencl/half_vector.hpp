@@ -0,0 +1,457 @@
+#ifndef VEXCL_BACKEND_OPENCL_HALF_VECTOR_HPP
+#define VEXCL_BACKEND_OPENCL_HALF_VECTOR_HPP
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/backend/opencl/half_vector.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Vectors stored in half precision.
+ */
+
+#include <vector>
+#include <cstring>
+
+#include <vexcl/operations.hpp>
+#include <vexcl/vector.hpp>
+
+namespace vex {
+
+/// Converts single precision value to half precision (round to nearest even).
+inline cl_half float_to_half(float f) {
+    cl_uint x;
+    std::memcpy(&x, &f, sizeof(x));
+
+    cl_uint sign = (x >> 16) & 0x8000;
+    cl_uint mant = x & 0x7fffff;
+    int     exp  = static_cast<int>((x >> 23) & 0xff);
+
+    // Infinity or NaN.
+    if (exp == 0xff)
+        return static_cast<cl_half>(sign | 0x7c00 | (mant ? 0x200 : 0));
+
+    exp += 15 - 127;
+
+    // Overflow.
+    if (exp >= 31) return static_cast<cl_half>(sign | 0x7c00);
+
+    cl_uint h, rem, mid;
+
+    if (exp <= 0) {
+        // Subnormal or zero.
+        if (exp < -10) return static_cast<cl_half>(sign);
+
+        mant |= 0x800000;
+
+        unsigned shift = 14 - exp;
+
+        h   = mant >> shift;
+        rem = mant & ((1u << shift) - 1);
+        mid = 1u << (shift - 1);
+    } else {
+        h   = (static_cast<cl_uint>(exp) << 10) | (mant >> 13);
+        rem = mant & 0x1fff;
+        mid = 0x1000;
+    }
+
+    // Carry into exponent (up to infinity) is handled by the format itself.
+    if (rem > mid || (rem == mid && (h & 1))) ++h;
+
+    return static_cast<cl_half>(sign | h);
+}
+
+/// Converts half precision value to single precision.
+inline float half_to_float(cl_half h) {
+    cl_uint sign = static_cast<cl_uint>(h & 0x8000) << 16;
+    cl_uint exp  = (h >> 10) & 0x1f;
+    cl_uint mant = h & 0x3ff;
+    cl_uint x;
+
+    if (exp == 0) {
+        if (mant == 0) {
+            x = sign;
+        } else {
+            // Normalize subnormal value.
+            int e = 1;
+            while (!(mant & 0x400)) { mant <<= 1; --e; }
+            x = sign | (static_cast<cl_uint>(e + 112) << 23) | ((mant & 0x3ff) << 13);
+        }
+    } else if (exp == 31) {
+        x = sign | 0x7f800000 | (mant << 13);
+    } else {
+        x = sign | ((exp + 112) << 23) | (mant << 13);
+    }
+
+    float f;
+    std::memcpy(&f, &x, sizeof(f));
+    return f;
+}
+
+/// \cond INTERNAL
+struct half_vector_terminal {};
+
+typedef vector_expression<
+    typename boost::proto::terminal< half_vector_terminal >::type
+    > half_vector_terminal_expression;
+
+// Storage type of half_vector elements in the generated kernels.
+struct half_storage {};
+
+template <>
+struct type_name_impl<half_storage> {
+    static std::string get() { return "half"; }
+};
+
+namespace traits {
+
+// Hold half vector terminals by reference:
+template <class T>
+struct hold_terminal_by_reference< T,
+        typename std::enable_if<
+            boost::proto::matches<
+                typename boost::proto::result_of::as_expr< T >::type,
+                boost::proto::terminal< half_vector_terminal >
+            >::value
+        >::type
+    >
+    : std::true_type
+{ };
+
+} // namespace traits
+
+class half_vector;
+
+namespace detail {
+
+template <class OP> struct half_assign_op;
+
+template <> struct half_assign_op<assign::SET> { static const char* string() { return 0;   } };
+template <> struct half_assign_op<assign::ADD> { static const char* string() { return "+"; } };
+template <> struct half_assign_op<assign::SUB> { static const char* string() { return "-"; } };
+template <> struct half_assign_op<assign::MUL> { static const char* string() { return "*"; } };
+template <> struct half_assign_op<assign::DIV> { static const char* string() { return "/"; } };
+
+// Assigns vector expression to a half vector. The expression is computed in
+// the precision of its own terminals and is converted to half precision by
+// vstore_half_rte() on store.
+template <class OP, class RHS>
+void assign_half_expression(half_vector &lhs, const RHS &rhs);
+
+} // namespace detail
+/// \endcond
+
+/// Vector stored in half precision.
+/**
+ * Elements are stored as 16-bit floating point numbers, which halves the
+ * memory footprint and the bandwidth requirements compared to single
+ * precision. In vector expressions the elements are loaded with
+ * vload_half() and all computations are done in single (or higher)
+ * precision; on assignment the results are rounded to the nearest half
+ * precision value with vstore_half_rte(). The cl_khr_fp16 extension is not
+ * required.
+ \code
+ vex::half_vector h(ctx, host_floats);
+ vex::vector<float> y(ctx, n);
+
+ y = 2 * h + 1;
+ h = sin(y);
+
+ vex::Reductor<float, vex::SUM> sum(ctx);
+ float s = sum(h * h);
+
+ vex::copy(h, host_floats);
+ \endcode
+ * Partitioning across devices is the same as that of vex::vector of the
+ * same size, so both may be mixed in the same expression.
+ */
+class half_vector : public half_vector_terminal_expression {
+    public:
+        typedef float value_type;
+
+        /// Creates vector of the given size.
+        half_vector(const std::vector<backend::command_queue> &queue, size_t size)
+            : data(queue, size)
+        { }
+
+        /// Creates vector of the given size and fills it from host memory.
+        half_vector(const std::vector<backend::command_queue> &queue,
+                size_t size, const float *host)
+            : data(queue, size)
+        {
+            write(host);
+        }
+
+        /// Creates vector and fills it from host vector.
+        half_vector(const std::vector<backend::command_queue> &queue,
+                const std::vector<float> &host)
+            : data(queue, host.size())
+        {
+            write(host.data());
+        }
+
+        /// Copy constructor.
+        half_vector(const half_vector &x) : data(x.data) { }
+
+        /// Copies data from another half vector. No conversions involved.
+        const half_vector& operator=(const half_vector &x) {
+            data = x.data;
+            return *this;
+        }
+
+#define VEXCL_ASSIGNMENT(cop, op)                                              \
+  template <class Expr>                                                        \
+  typename std::enable_if<                                                     \
+      boost::proto::matches<                                                   \
+          typename boost::proto::result_of::as_expr<Expr>::type,               \
+          vector_expr_grammar>::value,                                         \
+      const half_vector &>::type operator cop(const Expr & expr) {             \
+    detail::assign_half_expression<op>(*this, expr);                           \
+    return *this;                                                              \
+  }
+
+        VEXCL_ASSIGNMENT(=,   assign::SET)
+        VEXCL_ASSIGNMENT(+=,  assign::ADD)
+        VEXCL_ASSIGNMENT(-=,  assign::SUB)
+        VEXCL_ASSIGNMENT(*=,  assign::MUL)
+        VEXCL_ASSIGNMENT(/=,  assign::DIV)
+
+#undef VEXCL_ASSIGNMENT
+
+        /// Vector size.
+        size_t size() const { return data.size(); }
+
+        /// Number of elements located on the given device.
+        size_t part_size(unsigned d) const { return data.part_size(d); }
+
+        /// Index of the first element located on the given device.
+        size_t part_start(unsigned d) const { return data.part_start(d); }
+
+        const std::vector<backend::command_queue>& queue_list() const {
+            return data.queue_list();
+        }
+
+        const std::vector<size_t>& partition() const {
+            return data.partition();
+        }
+
+        /// Buffer with the half precision values located on the given device.
+        const backend::device_vector<cl_half>& operator()(unsigned d = 0) const {
+            return data(d);
+        }
+
+        /// Buffer with the half precision values located on the given device.
+        backend::device_vector<cl_half>& operator()(unsigned d = 0) {
+            return data(d);
+        }
+
+        /// Raw half precision values.
+        const vector<cl_half>& storage() const { return data; }
+
+        /// Raw half precision values.
+        vector<cl_half>& storage() { return data; }
+
+        /// Converts the values to half precision and writes them to the devices.
+        void write(const float *host) {
+            std::vector<cl_half> h(size());
+            for(size_t i = 0; i < h.size(); ++i) h[i] = float_to_half(host[i]);
+            data.write_data(0, h.size(), h.data(), true);
+        }
+
+        /// Reads the values from the devices and converts them to single precision.
+        void read(float *host) const {
+            std::vector<cl_half> h(size());
+            data.read_data(0, h.size(), h.data(), true);
+            for(size_t i = 0; i < h.size(); ++i) host[i] = half_to_float(h[i]);
+        }
+    private:
+        vector<cl_half> data;
+};
+
+/// Copy half vector to host vector.
+inline void copy(const half_vector &dv, std::vector<float> &hv) {
+    dv.read(hv.data());
+}
+
+/// Copy half vector to host pointer.
+inline void copy(const half_vector &dv, float *hv) {
+    dv.read(hv);
+}
+
+/// Copy host vector to half vector.
+inline void copy(const std::vector<float> &hv, half_vector &dv) {
+    dv.write(hv.data());
+}
+
+/// Copy host pointer to half vector.
+inline void copy(const float *hv, half_vector &dv) {
+    dv.write(hv);
+}
+
+/// \cond INTERNAL
+namespace traits {
+
+template <>
+struct is_vector_expr_terminal< half_vector_terminal > : std::true_type {};
+
+template <>
+struct proto_terminal_is_value< half_vector_terminal > : std::true_type {};
+
+template <>
+struct kernel_param_declaration< half_vector > {
+    static void get(backend::source_generator &src,
+            const half_vector&,
+            const backend::command_queue&, const std::string &prm_name,
+            detail::kernel_generator_state_ptr)
+    {
+        src.parameter< global_ptr<const half_storage> >(prm_name);
+    }
+};
+
+template <>
+struct partial_vector_expr< half_vector > {
+    static void get(backend::source_generator &src,
+            const half_vector&,
+            const backend::command_queue&, const std::string &prm_name,
+            detail::kernel_generator_state_ptr)
+    {
+        src << "vload_half(idx, " << prm_name << ")";
+    }
+};
+
+template <>
+struct kernel_arg_setter< half_vector > {
+    static void set(const half_vector &term,
+            backend::kernel &kernel, unsigned device, size_t/*index_offset*/,
+            detail::kernel_generator_state_ptr)
+    {
+        kernel.push_arg(term(device));
+    }
+};
+
+template <>
+struct expression_properties< half_vector > {
+    static void get(const half_vector &term,
+            std::vector<backend::command_queue> &queue_list,
+            std::vector<size_t> &partition,
+            size_t &size
+            )
+    {
+        queue_list = term.queue_list();
+        partition  = term.partition();
+        size       = term.size();
+    }
+};
+
+} // namespace traits
+
+namespace detail {
+
+template <class OP, class RHS>
+void assign_half_expression(half_vector &lhs, const RHS &rhs)
+{
+    const std::vector<backend::command_queue> &queue = lhs.queue_list();
+    const std::vector<size_t> &part = lhs.partition();
+
+#if (VEXCL_CHECK_SIZES > 0)
+    {
+        get_expression_properties prop;
+        extract_terminals()(boost::proto::as_child(rhs), prop);
+
+        precondition(
+                prop.queue.empty() || prop.queue.size() == queue.size(),
+                "Incompatible queue lists"
+                );
+
+        precondition(
+                prop.size == 0 || prop.size == part.back(),
+                "Incompatible expression sizes"
+                );
+    }
+#endif
+    static kernel_cache cache;
+
+    for(unsigned d = 0; d < queue.size(); d++) {
+        auto key    = backend::cache_key(queue[d]);
+        auto kernel = cache.find(key);
+
+        backend::select_context(queue[d]);
+
+        if (kernel == cache.end()) {
+            backend::source_generator source(queue[d]);
+
+            output_terminal_preamble termpream(source, queue[d], "prm", empty_state());
+            boost::proto::eval(boost::proto::as_child(rhs), termpream);
+
+            source.kernel("vexcl_half_kernel")
+                .open("(")
+                    .parameter<size_t>("n")
+                    .parameter< global_ptr<half_storage> >("lhs");
+
+            declare_expression_parameter declare(source, queue[d], "prm", empty_state());
+            extract_terminals()(boost::proto::as_child(rhs), declare);
+
+            source.close(")")
+                .open("{")
+                    .grid_stride_loop()
+                    .open("{");
+
+            output_local_preamble loc_init(source, queue[d], "prm", empty_state());
+            boost::proto::eval(boost::proto::as_child(rhs), loc_init);
+
+            vector_expr_context expr_ctx(source, queue[d], "prm", empty_state());
+
+            source.new_line() << "vstore_half_rte(";
+            if (const char *op = half_assign_op<OP>::string())
+                source << "vload_half(idx, lhs) " << op << " (";
+            boost::proto::eval(boost::proto::as_child(rhs), expr_ctx);
+            if (half_assign_op<OP>::string())
+                source << ")";
+            source << ", idx, lhs);";
+
+            source.close("}").close("}");
+
+            backend::kernel krn(queue[d], source.str(), "vexcl_half_kernel");
+
+            kernel = cache.insert(std::make_pair(key, krn)).first;
+        }
+
+        if (size_t psize = part[d + 1] - part[d]) {
+            kernel->second.push_arg(psize);
+            kernel->second.push_arg(lhs(d));
+
+            set_expression_argument setarg(kernel->second, d, part[d], empty_state());
+            extract_terminals()( boost::proto::as_child(rhs), setarg);
+
+            kernel->second(queue[d]);
+        }
+    }
+}
+
+} // namespace detail
+/// \endcond
+
+} // namespace vex
+
+#endif
@@ -0,0 +1,494 @@
+#ifndef VEXCL_BACKEND_OPENCL_OOC_VECTOR_HPP
+#define VEXCL_BACKEND_OPENCL_OOC_VECTOR_HPP
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/backend/opencl/ooc_vector.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Out-of-core vectors streamed through device memory in tiles.
+ */
+
+#include <vector>
+#include <algorithm>
+
+#include <vexcl/operations.hpp>
+#include <vexcl/vector.hpp>
+#include <vexcl/reductor.hpp>
+
+namespace vex {
+
+/// \cond INTERNAL
+struct ooc_vector_terminal {};
+
+typedef vector_expression<
+    typename boost::proto::terminal< ooc_vector_terminal >::type
+    > ooc_vector_terminal_expression;
+
+namespace traits {
+
+// Hold out-of-core vector terminals by reference:
+template <class T>
+struct hold_terminal_by_reference< T,
+        typename std::enable_if<
+            boost::proto::matches<
+                typename boost::proto::result_of::as_expr< T >::type,
+                boost::proto::terminal< ooc_vector_terminal >
+            >::value
+        >::type
+    >
+    : std::true_type
+{ };
+
+} // namespace traits
+
+namespace detail {
+
+// Type-erased interface used to stream tiles of out-of-core vectors.
+class ooc_tiles {
+    public:
+        virtual ~ooc_tiles() {}
+
+        virtual size_t size() const = 0;
+        virtual size_t tile_size() const = 0;
+        virtual const std::vector<backend::command_queue>& queue_list() const = 0;
+
+        // Makes sure the device buffers in the slot fit the tile.
+        virtual void prepare(size_t tile, unsigned slot) const = 0;
+
+        // Starts asynchronous transfers of the tile.
+        virtual void upload(size_t tile, unsigned slot) const = 0;
+        virtual void download(size_t tile, unsigned slot) const = 0;
+
+        // Waits for the upload into the slot to complete.
+        virtual void wait_upload(unsigned slot) const = 0;
+
+        // Waits for all transfers to complete.
+        virtual void finish() const = 0;
+
+        // Binds the vector in vector expressions to the given slot. The
+        // compute queues are made to wait for the pending download from the
+        // slot, so that the slot is not overwritten before it is read.
+        virtual void activate(unsigned slot) const = 0;
+};
+
+// Collects out-of-core vectors from a vector expression, together with the
+// sizes of the other terminals.
+struct collect_ooc_vectors {
+    std::vector<const ooc_tiles*> &found;
+    mutable std::vector<size_t> sizes;
+
+    collect_ooc_vectors(std::vector<const ooc_tiles*> &found) : found(found) {}
+
+    template <class Term>
+    typename std::enable_if<std::is_base_of<ooc_tiles, Term>::value, void>::type
+    operator()(const Term &term) const {
+        if (std::find(found.begin(), found.end(), &term) == found.end())
+            found.push_back(&term);
+    }
+
+    template <class Term>
+    typename std::enable_if<!std::is_base_of<ooc_tiles, Term>::value, void>::type
+    operator()(const Term &term) const {
+        get_expression_properties prop;
+        prop(term);
+        if (prop.size) sizes.push_back(prop.size);
+    }
+};
+
+// The terminals other than out-of-core vectors are combined with every
+// tile, so their sizes have to match each of the tiles.
+inline void check_tile_terminals(const collect_ooc_vectors &collect, const ooc_tiles &ref) {
+    for(auto s = collect.sizes.begin(); s != collect.sizes.end(); ++s)
+        precondition(
+                *s == ref.tile_size() && ref.size() % ref.tile_size() == 0,
+                "Vector terminals in out-of-core expressions should have the size of a tile"
+                );
+}
+
+// Streams the tiles of out-of-core vectors through the device memory. Each
+// vector has two slots of device buffers; the upload of the next tile and
+// the download of the previous one proceed on separate transfer queues
+// while the current tile is being processed.
+template <class Compute>
+void ooc_stream(std::vector<const ooc_tiles*> input, const ooc_tiles *output,
+        Compute &&compute)
+{
+    const ooc_tiles *ref = output ? output : input.front();
+
+    const std::vector<backend::command_queue> &queue = ref->queue_list();
+
+    const size_t n     = ref->size();
+    const size_t tile  = ref->tile_size();
+    const size_t tiles = (n + tile - 1) / tile;
+
+    for(auto i = input.begin(); i != input.end(); ++i)
+        precondition(
+                (*i)->size() == n && (*i)->tile_size() == tile &&
+                (*i)->queue_list().size() == queue.size(),
+                "Incompatible out-of-core vectors"
+                );
+
+    const bool output_is_input = output &&
+        std::find(input.begin(), input.end(), output) != input.end();
+
+    // Completion of the computations on each slot.
+    std::vector<cl::Event> done[2];
+    done[0].resize(queue.size());
+    done[1].resize(queue.size());
+
+    auto stage = [&](size_t t) {
+        unsigned s = t % 2;
+
+        for(auto i = input.begin(); i != input.end(); ++i) {
+            (*i)->prepare(t, s);
+            (*i)->upload(t, s);
+        }
+
+        if (output && !output_is_input) output->prepare(t, s);
+    };
+
+    if (tiles) stage(0);
+
+    for(size_t t = 0; t < tiles; ++t) {
+        unsigned s = t % 2, o = 1 - s;
+
+        for(auto i = input.begin(); i != input.end(); ++i) {
+            (*i)->wait_upload(s);
+            (*i)->activate(s);
+        }
+
+        if (output) output->activate(s);
+
+        compute();
+
+        for(unsigned d = 0; d < queue.size(); ++d) {
+            done[s][d] = backend::enqueue_marker(queue[d]);
+            queue[d].flush();
+        }
+
+        if (t > 0) {
+            for(unsigned d = 0; d < queue.size(); ++d) done[o][d].wait();
+            if (output) output->download(t - 1, o);
+        }
+
+        if (t + 1 < tiles) stage(t + 1);
+    }
+
+    if (tiles) {
+        unsigned s = (tiles - 1) % 2;
+
+        for(unsigned d = 0; d < queue.size(); ++d) done[s][d].wait();
+        if (output) output->download(tiles - 1, s);
+    }
+
+    if (output) output->finish();
+}
+
+} // namespace detail
+/// \endcond
+
+/// Out-of-core vector.
+/**
+ * The data resides in host memory (either owned by the vector, or provided
+ * by the user, e.g. a memory-mapped file), and is streamed through two sets
+ * of device buffers in fixed-size tiles when the vector is used in a vector
+ * expression. Transfer of the next tile overlaps with the computation on
+ * the current one. This allows to process data larger than the device
+ * memory with the usual elementwise expression syntax:
+ \code
+ vex::ooc_vector<double> x(ctx, n), y(ctx, n);
+ y = 2 * sin(x) + y;
+
+ vex::Reductor<double, vex::SUM> sum(ctx);
+ double s = vex::ooc_reduce(sum, x * y);
+ \endcode
+ * All out-of-core vectors in an expression should have the same size and
+ * tile size. Other terminals are restricted to those that do not depend on
+ * the expression size (e.g. scalars); vex::element_index() would be relative
+ * to the current tile. Regular vectors are combined with every tile, and
+ * should have the size of a tile that divides the vector size.
+ */
+template <typename T>
+class ooc_vector : public ooc_vector_terminal_expression, public detail::ooc_tiles {
+    public:
+        typedef T value_type;
+
+        /// Creates vector of the given size in host memory.
+        ooc_vector(const std::vector<backend::command_queue> &queue,
+                size_t size, size_t tile = 1 << 22)
+            : queue(queue), n(size), tile(tile), own(size), ptr(own.data())
+        {
+            init();
+        }
+
+        /// Uses the provided host memory as the vector storage.
+        ooc_vector(const std::vector<backend::command_queue> &queue,
+                size_t size, T *host, size_t tile = 1 << 22)
+            : queue(queue), n(size), tile(tile), ptr(host)
+        {
+            init();
+        }
+
+        /// Vector size.
+        size_t size() const { return n; }
+
+        /// Number of elements in a tile.
+        size_t tile_size() const { return tile; }
+
+        /// Host storage.
+        T* data() { return ptr; }
+
+        /// Host storage.
+        const T* data() const { return ptr; }
+
+        const std::vector<backend::command_queue>& queue_list() const {
+            return queue;
+        }
+
+        /// Device buffers holding the current tile.
+        const vector<T>& current_tile() const {
+            return buf[active];
+        }
+
+        const ooc_vector& operator=(const ooc_vector &x) {
+            assign_tiles<assign::SET>(x);
+            return *this;
+        }
+
+#define VEXCL_ASSIGNMENT(cop, op)                                              \
+  template <class Expr>                                                        \
+  typename std::enable_if<                                                     \
+      boost::proto::matches<                                                   \
+          typename boost::proto::result_of::as_expr<Expr>::type,               \
+          vector_expr_grammar>::value,                                         \
+      const ooc_vector &>::type operator cop(const Expr & expr) {              \
+    assign_tiles<op>(expr);                                                      \
+    return *this;                                                              \
+  }
+
+        VEXCL_ASSIGNMENT(=,   assign::SET)
+        VEXCL_ASSIGNMENT(+=,  assign::ADD)
+        VEXCL_ASSIGNMENT(-=,  assign::SUB)
+        VEXCL_ASSIGNMENT(*=,  assign::MUL)
+        VEXCL_ASSIGNMENT(/=,  assign::DIV)
+        VEXCL_ASSIGNMENT(%=,  assign::MOD)
+        VEXCL_ASSIGNMENT(&=,  assign::AND)
+        VEXCL_ASSIGNMENT(|=,  assign::OR)
+        VEXCL_ASSIGNMENT(^=,  assign::XOR)
+        VEXCL_ASSIGNMENT(<<=, assign::LSH)
+        VEXCL_ASSIGNMENT(>>=, assign::RSH)
+
+#undef VEXCL_ASSIGNMENT
+
+        /// \cond INTERNAL
+        void prepare(size_t t, unsigned s) const {
+            size_t m = std::min(tile, n - t * tile);
+            if (buf[s].size() == m) return;
+
+            // The buffers may come from the buffer pool, where they could
+            // still be in use by the compute queues.
+            for(unsigned d = 0; d < queue.size(); ++d) xfer[d].finish();
+            buf[s].resize(queue, m);
+            for(unsigned d = 0; d < queue.size(); ++d) queue[d].finish();
+        }
+
+        void upload(size_t t, unsigned s) const {
+            for(unsigned d = 0; d < queue.size(); ++d) {
+                if (size_t m = buf[s].part_size(d)) {
+                    buf[s](d).write(xfer[d], 0, m,
+                            ptr + t * tile + buf[s].part_start(d), false, &ev[s][d]);
+                    xfer[d].flush();
+                }
+            }
+        }
+
+        void download(size_t t, unsigned s) const {
+            for(unsigned d = 0; d < queue.size(); ++d) {
+                if (size_t m = buf[s].part_size(d)) {
+                    buf[s](d).read(xfer[d], 0, m,
+                            ptr + t * tile + buf[s].part_start(d), false, &dl[s][d]);
+                    xfer[d].flush();
+                }
+            }
+        }
+
+        void wait_upload(unsigned s) const {
+            for(unsigned d = 0; d < queue.size(); ++d) {
+                if (ev[s][d]()) {
+                    ev[s][d].wait();
+                    ev[s][d] = cl::Event();
+                }
+            }
+        }
+
+        void finish() const {
+            for(unsigned d = 0; d < queue.size(); ++d) xfer[d].finish();
+        }
+
+        void activate(unsigned s) const {
+            for(unsigned d = 0; d < queue.size(); ++d) {
+                if (dl[s][d]()) {
+                    backend::enqueue_wait(queue[d], std::vector<cl::Event>(1, dl[s][d]));
+                    dl[s][d] = cl::Event();
+                }
+            }
+
+            active = s;
+        }
+        /// \endcond
+    private:
+        std::vector<backend::command_queue> queue;
+        std::vector<backend::command_queue> xfer;
+
+        size_t n, tile;
+
+        std::vector<T> own;
+        T *ptr;
+
+        mutable vector<T> buf[2];
+        mutable std::vector<cl::Event> ev[2];
+        mutable std::vector<cl::Event> dl[2];
+        mutable unsigned active;
+
+        ooc_vector(const ooc_vector&);
+
+        void init() {
+            precondition(tile > 0, "Tile size should be positive");
+
+            active = 0;
+            for(unsigned d = 0; d < queue.size(); ++d)
+                xfer.push_back(backend::duplicate_queue(queue[d]));
+
+            ev[0].resize(queue.size());
+            ev[1].resize(queue.size());
+
+            dl[0].resize(queue.size());
+            dl[1].resize(queue.size());
+        }
+
+        template <class OP, class Expr>
+        void assign_tiles(const Expr &expr) {
+            std::vector<const detail::ooc_tiles*> input;
+            detail::collect_ooc_vectors collect(input);
+            detail::extract_terminals()(boost::proto::as_child(expr), collect);
+
+            // Compound assignments need the current values.
+            if (!std::is_same<OP, assign::SET>::value)
+                collect(*this);
+
+            detail::check_tile_terminals(collect, *this);
+
+            detail::ooc_stream(input, this, [&]() {
+                    detail::assign_expression<OP>(buf[active], expr);
+                    });
+        }
+};
+
+/// Reduction of an expression involving out-of-core vectors.
+/**
+ * The partial results of each tile are combined on the host.
+ */
+template <typename real, class RDC, class Expr>
+real ooc_reduce(const Reductor<real, RDC> &reduce, const Expr &expr) {
+    std::vector<const detail::ooc_tiles*> input;
+    detail::collect_ooc_vectors collect(input);
+    detail::extract_terminals()(boost::proto::as_child(expr), collect);
+
+    precondition(!input.empty(), "Expression has no out-of-core vectors");
+
+    detail::check_tile_terminals(collect, *input.front());
+
+    std::vector<real> partial;
+
+    detail::ooc_stream(input, 0, [&]() {
+            partial.push_back(reduce(expr));
+            });
+
+    if (partial.empty()) return RDC::template initial<real>();
+    return RDC::reduce(partial.begin(), partial.end());
+}
+
+/// \cond INTERNAL
+namespace traits {
+
+template <>
+struct is_vector_expr_terminal< ooc_vector_terminal > : std::true_type {};
+
+template <>
+struct proto_terminal_is_value< ooc_vector_terminal > : std::true_type {};
+
+template <typename T>
+struct kernel_param_declaration< ooc_vector<T> > {
+    static void get(backend::source_generator &src,
+            const ooc_vector<T>&,
+            const backend::command_queue&, const std::string &prm_name,
+            detail::kernel_generator_state_ptr)
+    {
+        src.parameter< global_ptr<T> >(prm_name);
+    }
+};
+
+template <typename T>
+struct partial_vector_expr< ooc_vector<T> > {
+    static void get(backend::source_generator &src,
+            const ooc_vector<T>&,
+            const backend::command_queue&, const std::string &prm_name,
+            detail::kernel_generator_state_ptr)
+    {
+        src << prm_name << "[idx]";
+    }
+};
+
+template <typename T>
+struct kernel_arg_setter< ooc_vector<T> > {
+    static void set(const ooc_vector<T> &term,
+            backend::kernel &kernel, unsigned device, size_t/*index_offset*/,
+            detail::kernel_generator_state_ptr)
+    {
+        kernel.push_arg(term.current_tile()(device));
+    }
+};
+
+template <class T>
+struct expression_properties< ooc_vector<T> > {
+    static void get(const ooc_vector<T> &term,
+            std::vector<backend::command_queue> &queue_list,
+            std::vector<size_t> &partition,
+            size_t &size
+            )
+    {
+        queue_list = term.current_tile().queue_list();
+        partition  = term.current_tile().partition();
+        size       = term.current_tile().size();
+    }
+};
+
+} // namespace traits
+/// \endcond
+
+} // namespace vex
+
+#endif
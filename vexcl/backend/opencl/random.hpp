@@ -32,6 +32,7 @@ THE SOFTWARE.
  */
 
 #include <vexcl/operations.hpp>
+#include <vexcl/vector.hpp>
 #include <boost/math/constants/constants.hpp>
 #include <vexcl/backend/opencl/random/philox.hpp>
 #include <vexcl/backend/opencl/random/threefry.hpp>
@@ -169,8 +170,324 @@ struct RandomNormal : UserFunction<RandomNormal<T,Generator>, T(cl_ulong, cl_ulo
     }
 };
 
+/// \cond INTERNAL
+namespace detail {
 
+// Sets up full-width counter and key of a four-word generator: the counter
+// holds the 64-bit position and substream, the key holds the 64-bit seed.
+template <class Word>
+void random_stream_init(std::ostream &o,
+        const std::string &pos, const std::string &sub, const std::string &seed)
+{
+    o << "ctr_t ctr; key_t key = (key_t)(0);\n";
 
+    if (std::is_same<Word, cl_uint>::value) {
+        o << "ctr.s0 = (uint)(" << pos << "); ctr.s1 = (uint)((" << pos << ") >> 32);\n"
+             "ctr.s2 = (uint)(" << sub << "); ctr.s3 = (uint)((" << sub << ") >> 32);\n"
+             "key.s0 = (uint)(" << seed << "); key.s1 = (uint)((" << seed << ") >> 32);\n";
+    } else {
+        o << "ctr.s0 = " << pos << "; ctr.s1 = " << sub << "; ctr.s2 = 0; ctr.s3 = 0;\n"
+             "key.s0 = " << seed << ";\n";
+    }
+}
+
+// Uniform number in [0, 1] from the random word w of the counter.
+template <typename T>
+std::string random_uniform_word(size_t w) {
+    std::ostringstream o;
+    if (std::is_same<T, cl_float>::value) {
+        o << "convert_float(ctr.s" << w << ") / "
+          << std::numeric_limits<cl_uint>::max() << ".0f";
+    } else if (std::is_same<T, cl_double>::value) {
+        o << "convert_double(as_ulong2(ctr).s" << w << ") / "
+          << std::numeric_limits<cl_ulong>::max() << ".0";
+    } else if (sizeof(T) == 8) {
+        o << "(" << type_name<T>() << ")(as_ulong2(ctr).s" << w << ")";
+    } else {
+        o << "(" << type_name<T>() << ")(ctr.s" << w << ")";
+    }
+    return o.str();
+}
+
+// Uniform number in (0, 1), suitable for the Box-Muller transform.
+template <typename T>
+std::string random_open_word(size_t w) {
+    std::ostringstream o;
+    if (std::is_same<T, cl_float>::value)
+        o << "((convert_float(ctr.s" << w << ") + 0.5f) / 4294967296.0f)";
+    else
+        o << "((convert_double(as_ulong2(ctr).s" << w << ") + 0.5) / 18446744073709551616.0)";
+    return o.str();
+}
+
+// Full precision 2 pi constant.
+template <typename T>
+std::string random_two_pi() {
+    return std::is_same<T, cl_float>::value ? "(2 * M_PI_F)" : "(2 * M_PI)";
+}
+
+} // namespace detail
+/// \endcond
+
+/// Stream of random numbers with full-width counter and key.
+/**
+ * Returns the value at the given position of the given substream. The
+ * substream and position fill the 128-bit counter of the generator, and the
+ * seed is used as the key, so that each element may have its own substream,
+ * and skipping ahead is just a matter of incrementing the position. Value
+ * ranges are the same as for vex::Random.
+ \code
+ vex::RandomStream<double> rnd;
+ // k-th number of each element's own substream:
+ x = rnd(vex::element_index(), seed, k);
+ \endcode
+ */
+template <class T, class Generator = random::philox>
+struct RandomStream : UserFunction<RandomStream<T, Generator>, T(cl_ulong, cl_ulong, cl_ulong)> {
+    typedef typename cl_scalar_of<T>::type Ts;
+
+    static std::string body() {
+        const size_t N = cl_vector_length<T>::value;
+
+        std::ostringstream o;
+        if (sizeof(T) <= 16) {
+            Generator::template macro<cl_uint4>(o, "rand");
+            detail::random_stream_init<cl_uint>(o, "prm3", "prm1", "prm2");
+        } else if (sizeof(T) == 32) {
+            Generator::template macro<cl_ulong4>(o, "rand");
+            detail::random_stream_init<cl_ulong>(o, "prm3", "prm1", "prm2");
+        } else {
+            precondition(false, "Unsupported random output type.");
+        }
+
+        o << "rand(ctr, key);\n"
+             "#undef rand\n";
+
+        if (std::is_same<Ts, cl_float>::value || std::is_same<Ts, cl_double>::value) {
+            // Counter reinterpreted as a vector of output-sized words.
+            const size_t words = (sizeof(T) <= 16 ? 16 : 32) / sizeof(Ts);
+            const bool   flt   = std::is_same<Ts, cl_float>::value;
+
+            o << type_name<T>() << " r;\n";
+            for(size_t i = 0; i < N; ++i) {
+                o << "r";
+                if (N > 1) o << ".s" << i;
+                o << " = convert_" << type_name<Ts>() << "(as_"
+                  << (flt ? "uint" : "ulong") << words << "(ctr).s" << i << ") / "
+                  << (flt ? std::numeric_limits<cl_uint>::max() : std::numeric_limits<cl_ulong>::max())
+                  << (flt ? ".0f" : ".0") << ";\n";
+            }
+            o << "return r;";
+        } else {
+            o << "return *(" << type_name<T>() << "*)(void*)&ctr;";
+        }
+        return o.str();
+    }
+};
+
+/// Stream of normally distributed random numbers.
+/**
+ * Same as vex::RandomStream, but returns standard normal numbers.
+ \code
+ vex::RandomNormalStream<double> rnd;
+ x = mean + std_deviation * rnd(vex::element_index(), seed, k);
+ \endcode
+ */
+template <class T, class Generator = random::philox>
+struct RandomNormalStream : UserFunction<RandomNormalStream<T, Generator>, T(cl_ulong, cl_ulong, cl_ulong)> {
+    typedef typename cl_scalar_of<T>::type Ts;
+    static_assert(
+            std::is_same<Ts, cl_float>::value ||
+            std::is_same<Ts, cl_double>::value,
+            "Must use float or double vector or scalar."
+            );
+
+    static std::string body() {
+        const size_t N = cl_vector_length<T>::value;
+
+        // Normal numbers produced by a single call of the generator.
+        const size_t W = std::is_same<Ts, cl_float>::value ? 4 : 2;
+
+        std::ostringstream o;
+        Generator::template macro<cl_uint4>(o, "rand");
+        o << type_name<T>() << " z;\n";
+
+        for(size_t i = 0; i < N; i += W) {
+            std::ostringstream pos;
+            pos << "prm3 * " << (N + W - 1) / W << " + " << i / W;
+
+            o << "{\n";
+            detail::random_stream_init<cl_uint>(o, pos.str(), "prm1", "prm2");
+            o << "rand(ctr, key);\n";
+
+            for(size_t j = 0; j < W && i + j < N; j += 2) {
+                o << "{\n" << type_name<Ts>() << " l = sqrt(-2 * log("
+                  << detail::random_open_word<Ts>(j) << ")), a = "
+                  << detail::random_two_pi<Ts>() << " * "
+                  << detail::random_open_word<Ts>(j + 1) << ";\n";
+
+                if (N == 1) {
+                    o << "z = l * cos(a);\n";
+                } else {
+                    o << "z.s" << i + j << " = l * cos(a);\n";
+                    if (i + j + 1 < N) o << "z.s" << i + j + 1 << " = l * sin(a);\n";
+                }
+
+                o << "}\n";
+            }
+
+            o << "}\n";
+        }
+
+        o << "#undef rand\n"
+             "return z;";
+        return o.str();
+    }
+};
+
+/// \cond INTERNAL
+namespace detail {
+
+template <typename T, class Generator, bool normal>
+backend::kernel random_fill_kernel(const backend::command_queue &queue) {
+    static_assert(cl_vector_length<T>::value == 1, "Only scalar types are supported.");
+    static_assert(!normal ||
+            std::is_same<T, cl_float>::value || std::is_same<T, cl_double>::value,
+            "Must use float or double.");
+
+    static kernel_cache cache;
+
+    auto cache_key = backend::cache_key(queue);
+    auto kernel    = cache.find(cache_key);
+
+    if (kernel == cache.end()) {
+        backend::source_generator src(queue);
+
+        // Values produced by a single call of the generator.
+        const size_t W = sizeof(T) == 8 ? 2 : 4;
+
+        std::ostringstream macro;
+        Generator::template macro<cl_uint4>(macro, "rand");
+        src << macro.str();
+
+        src.kernel("vexcl_random_fill")
+            .open("(")
+                .template parameter< size_t        >("n")
+                .template parameter< cl_ulong      >("first")
+                .template parameter< cl_ulong      >("sub")
+                .template parameter< cl_ulong      >("seed")
+                .template parameter< global_ptr<T> >("x")
+            .close(")").open("{");
+
+        src.new_line() << "ulong b0 = first / " << W << ";";
+        src.new_line() << "ulong b1 = (first + n + " << W - 1 << ") / " << W << ";";
+        src.new_line() << "for(ulong b = b0 + " << src.global_id(0)
+            << "; b < b1; b += " << src.global_size(0) << ")";
+        src.open("{");
+
+        std::ostringstream init;
+        random_stream_init<cl_uint>(init, "b", "sub", "seed");
+
+        std::istringstream lines(init.str());
+        for(std::string line; std::getline(lines, line); )
+            src.new_line() << line;
+
+        src.new_line() << "rand(ctr, key);";
+        src.new_line() << type_name<T>() << " v[" << W << "];";
+
+        for(size_t w = 0; w < W; ++w) {
+            if (!normal) {
+                src.new_line() << "v[" << w << "] = " << random_uniform_word<T>(w) << ";";
+            } else if (w % 2 == 0) {
+                src.new_line() << "{";
+                src.new_line() << type_name<T>() << " l = sqrt(-2 * log("
+                    << random_open_word<T>(w) << ")), a = "
+                    << random_two_pi<T>() << " * "
+                    << random_open_word<T>(w + 1) << ";";
+                src.new_line() << "v[" << w << "] = l * cos(a);";
+                src.new_line() << "v[" << w + 1 << "] = l * sin(a);";
+                src.new_line() << "}";
+            }
+        }
+
+        src.new_line() << "for(int w = 0; w < " << W << "; ++w)";
+        src.open("{");
+        src.new_line() << "ulong k = b * " << W << " + w;";
+        src.new_line() << "if (k >= first && k < first + n) x[k - first] = v[w];";
+        src.close("}");
+
+        src.close("}");
+        src.close("}");
+
+        src << "\n#undef rand\n";
+
+        backend::kernel krn(queue, src.str(), "vexcl_random_fill");
+        kernel = cache.insert(std::make_pair(cache_key, krn)).first;
+    }
+
+    return kernel->second;
+}
+
+template <class Generator, bool normal, typename T>
+void random_fill(vector<T> &x, cl_ulong seed, cl_ulong offset, cl_ulong substream) {
+    const std::vector<backend::command_queue> &queue = x.queue_list();
+
+    for(unsigned d = 0; d < queue.size(); ++d) {
+        if (size_t psize = x.part_size(d)) {
+            backend::kernel krn = random_fill_kernel<T, Generator, normal>(queue[d]);
+
+            krn.push_arg(psize);
+            krn.push_arg(static_cast<cl_ulong>(offset + x.part_start(d)));
+            krn.push_arg(substream);
+            krn.push_arg(seed);
+            krn.push_arg(x(d));
+
+            krn(queue[d]);
+        }
+    }
+}
+
+} // namespace detail
+/// \endcond
+
+/// Fills a vector with consecutive uniformly distributed random numbers.
+/**
+ * x[i] is set to the number at position offset + i of the given substream.
+ * Each work item fills several consecutive elements from a single call of
+ * the generator (4 values for 32-bit types, 2 for 64-bit ones), which is
+ * considerably cheaper than calling vex::Random for each element. Value
+ * ranges are the same as for vex::Random.
+ \code
+ // Draw the next n numbers of the stream on each step:
+ vex::fill_random(x, seed, step * n);
+ \endcode
+ */
+template <class Generator, typename T>
+void fill_random(vector<T> &x, cl_ulong seed, cl_ulong offset = 0, cl_ulong substream = 0) {
+    detail::random_fill<Generator, false>(x, seed, offset, substream);
+}
+
+/// Fills a vector with consecutive uniformly distributed random numbers.
+template <typename T>
+void fill_random(vector<T> &x, cl_ulong seed, cl_ulong offset = 0, cl_ulong substream = 0) {
+    detail::random_fill<random::philox, false>(x, seed, offset, substream);
+}
+
+/// Fills a vector with consecutive normally distributed random numbers.
+/**
+ * Same as vex::fill_random, but produces standard normal numbers with the
+ * Box-Muller transform.
+ */
+template <class Generator, typename T>
+void fill_random_normal(vector<T> &x, cl_ulong seed, cl_ulong offset = 0, cl_ulong substream = 0) {
+    detail::random_fill<Generator, true>(x, seed, offset, substream);
+}
+
+/// Fills a vector with consecutive normally distributed random numbers.
+template <typename T>
+void fill_random_normal(vector<T> &x, cl_ulong seed, cl_ulong offset = 0, cl_ulong substream = 0) {
+    detail::random_fill<random::philox, true>(x, seed, offset, substream);
+}
 
 } // namespace vex
 
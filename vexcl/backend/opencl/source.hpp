@@ -234,6 +234,64 @@ class source_generator {
             return *this;
         }
 
+        /// Defines function that atomically adds a value to global memory.
+        /**
+         * The generated function has signature
+         * <tt>void name(global T *p, T v)</tt>. Floating point additions are
+         * emulated with compare-and-swap loops; 64bit types require
+         * cl_khr_int64_base_atomics extension. Vector types are updated
+         * componentwise.
+         */
+        template <typename T>
+        source_generator& atomic_add_function(const std::string &name) {
+            typedef typename cl_scalar_of<T>::type S;
+            static_assert(sizeof(S) == 4 || sizeof(S) == 8,
+                    "Unsupported type for atomic addition");
+
+            const bool wide = sizeof(S) == 8;
+            const std::string sname = cl_vector_length<T>::value > 1 ? name + "_scalar" : name;
+            const std::string utype = wide ? "ulong" : "uint";
+            const std::string cmpxchg = wide ? "atom_cmpxchg" : "atomic_cmpxchg";
+
+            if (wide)
+                new_line() << "#pragma OPENCL EXTENSION cl_khr_int64_base_atomics: enable";
+
+            function<void>(sname).open("(")
+                .template parameter< global_ptr<S> >("p")
+                .template parameter< S >("v")
+            .close(")").open("{");
+
+            if (std::is_integral<S>::value) {
+                new_line() << (wide ? "atom_add" : "atomic_add") << "(p, v);";
+            } else {
+                new_line() << "union { " << utype << " i; " << type_name<S>() << " f; } old, upd;";
+                new_line() << "do";
+                open("{");
+                new_line() << "old.f = *p;";
+                new_line() << "upd.f = old.f + v;";
+                close("}");
+                new_line() << "while (" << cmpxchg << "((volatile global "
+                    << utype << "*)p, old.i, upd.i) != old.i);";
+            }
+
+            close("}");
+
+            if (cl_vector_length<T>::value > 1) {
+                function<void>(name).open("(")
+                    .template parameter< global_ptr<T> >("p")
+                    .template parameter< T >("v")
+                .close(")").open("{");
+                new_line() << "for(int i = 0; i < " << cl_vector_length<T>::value << "; ++i)";
+                open("{");
+                new_line() << sname << "((global " << type_name<S>() << "*)p + i, (("
+                    << type_name<S>() << "*)&v)[i]);";
+                close("}");
+                close("}");
+            }
+
+            return *this;
+        }
+
         std::string global_id(int d) const {
             std::ostringstream s;
             s << "get_global_id(" << d << ")";
@@ -0,0 +1,278 @@
+#ifndef VEXCL_BACKEND_OPENCL_TRANSFER_HPP
+#define VEXCL_BACKEND_OPENCL_TRANSFER_HPP
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/backend/opencl/transfer.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Pipelined host-device transfers through pinned staging buffers.
+ */
+
+#include <vector>
+#include <deque>
+#include <algorithm>
+#include <cstring>
+
+#include <vexcl/vector.hpp>
+
+namespace vex {
+
+/// Pipelined host-device transfer engine.
+/**
+ * Copies between pageable host memory and vex::vector through a ring of
+ * pinned (CL_MEM_ALLOC_HOST_PTR) staging buffers on each device. Large
+ * copies are split into chunks, so that copying of a chunk to or from the
+ * pinned memory overlaps with the DMA transfer of the previous chunks, and
+ * the transfers to all device partitions proceed concurrently.
+ *
+ * The engine only pays off for large transfers: for small ones vex::copy is
+ * just as good.
+ \code
+ vex::transfer_engine xfer(ctx);
+
+ xfer.write(x, host_data); // Host to device.
+ xfer.read(x, host_data);  // Device to host.
+ \endcode
+ */
+class transfer_engine {
+    public:
+        /// Constructor.
+        /**
+         * \param queue      command queues of the vectors to be copied.
+         * \param chunk_size size of a single staging buffer in bytes.
+         * \param depth      number of staging buffers per device.
+         */
+        transfer_engine(const std::vector<backend::command_queue> &queue,
+                size_t chunk_size = 4 << 20, unsigned depth = 3)
+            : queue(queue), chunk_size(chunk_size),
+              stage(queue.size()), current(queue.size(), 0)
+        {
+            precondition(chunk_size > 0 && depth > 0,
+                    "Wrong transfer engine parameters");
+
+            for(unsigned d = 0; d < queue.size(); ++d) {
+                cl::Context ctx = queue[d].getInfo<CL_QUEUE_CONTEXT>();
+
+                stage[d].resize(depth);
+
+                for(auto s = stage[d].begin(); s != stage[d].end(); ++s) {
+                    s->buffer = cl::Buffer(ctx,
+                            CL_MEM_READ_WRITE | CL_MEM_ALLOC_HOST_PTR, chunk_size);
+
+                    s->ptr = static_cast<char*>(queue[d].enqueueMapBuffer(
+                                s->buffer, CL_TRUE, CL_MAP_READ | CL_MAP_WRITE,
+                                0, chunk_size));
+                }
+            }
+        }
+
+        ~transfer_engine() {
+            try {
+                for(unsigned d = 0; d < queue.size(); ++d) {
+                    for(auto s = stage[d].begin(); s != stage[d].end(); ++s) {
+                        if (s->event()) s->event.wait();
+                        queue[d].enqueueUnmapMemObject(s->buffer, s->ptr);
+                    }
+                    queue[d].finish();
+                }
+            } catch(...) {}
+        }
+
+        /// Copies host data to the device vector.
+        /**
+         * Returns as soon as the host data has been copied to the staging
+         * buffers, so the host memory may be reused right away. The
+         * transfers to the device may still be in progress; they are ordered
+         * before any subsequent operations on the vector's queues.
+         */
+        template <typename T>
+        void write(vector<T> &x, const T *host) {
+            write(x, 0, x.size(), host);
+        }
+
+        /// Copies host data to the given range of the device vector.
+        template <typename T>
+        void write(vector<T> &x, size_t offset, size_t size, const T *host) {
+            const size_t chunk = chunk_elements<T>(x);
+
+            std::vector<range> job = split(x, offset, size);
+
+            for(bool done = false; !done; ) {
+                done = true;
+
+                for(unsigned d = 0; d < queue.size(); ++d) {
+                    if (job[d].pos >= job[d].end) continue;
+                    done = false;
+
+                    staging &s = next_stage(d);
+
+                    size_t n = std::min(chunk, job[d].end - job[d].pos);
+                    std::memcpy(s.ptr, host + job[d].pos - offset, n * sizeof(T));
+
+                    x(d).write(queue[d], job[d].pos - x.part_start(d), n,
+                            reinterpret_cast<const T*>(s.ptr), false, &s.event);
+                    queue[d].flush();
+
+                    job[d].pos += n;
+                }
+            }
+        }
+
+        /// Copies the device vector to host memory.
+        /**
+         * Returns when the data is available in the host memory.
+         */
+        template <typename T>
+        void read(const vector<T> &x, T *host) {
+            read(x, 0, x.size(), host);
+        }
+
+        /// Copies the given range of the device vector to host memory.
+        template <typename T>
+        void read(const vector<T> &x, size_t offset, size_t size, T *host) {
+            const size_t chunk = chunk_elements<T>(x);
+
+            std::vector<range> job = split(x, offset, size);
+
+            // Chunks in flight: staging buffer, position and size.
+            struct pending {
+                staging *s;
+                size_t   pos, n;
+            };
+
+            std::vector< std::deque<pending> > flight(queue.size());
+
+            auto issue = [&](unsigned d) {
+                staging &s = next_stage(d);
+
+                pending p = {&s, job[d].pos, std::min(chunk, job[d].end - job[d].pos)};
+
+                x(d).read(queue[d], p.pos - x.part_start(d), p.n,
+                        reinterpret_cast<T*>(s.ptr), false, &s.event);
+
+                job[d].pos += p.n;
+                flight[d].push_back(p);
+            };
+
+            for(unsigned d = 0; d < queue.size(); ++d) {
+                for(size_t k = 0; k < stage[d].size() && job[d].pos < job[d].end; ++k)
+                    issue(d);
+                queue[d].flush();
+            }
+
+            for(bool done = false; !done; ) {
+                done = true;
+
+                for(unsigned d = 0; d < queue.size(); ++d) {
+                    if (flight[d].empty()) continue;
+                    done = false;
+
+                    pending p = flight[d].front();
+                    flight[d].pop_front();
+
+                    p.s->event.wait();
+                    std::memcpy(host + p.pos - offset, p.s->ptr, p.n * sizeof(T));
+                    p.s->event = cl::Event();
+
+                    if (job[d].pos < job[d].end) {
+                        issue(d);
+                        queue[d].flush();
+                    }
+                }
+            }
+        }
+    private:
+        struct staging {
+            cl::Buffer buffer;
+            char      *ptr;
+            cl::Event  event;
+
+            staging() : ptr(0) {}
+        };
+
+        struct range {
+            size_t pos, end;
+        };
+
+        std::vector<backend::command_queue> queue;
+        size_t chunk_size;
+
+        std::vector< std::vector<staging> > stage;
+        std::vector< unsigned > current;
+
+        transfer_engine(const transfer_engine&);
+        transfer_engine& operator=(const transfer_engine&);
+
+        template <typename T>
+        size_t chunk_elements(const vector<T> &x) const {
+            precondition(chunk_size >= sizeof(T),
+                    "Staging buffers are too small");
+
+            const std::vector<backend::command_queue> &q = x.queue_list();
+
+            precondition(q.size() == queue.size(),
+                    "Vector and transfer engine use different queues");
+
+            for(unsigned d = 0; d < q.size(); ++d)
+                precondition(q[d]() == queue[d](),
+                        "Vector and transfer engine use different queues");
+
+            return chunk_size / sizeof(T);
+        }
+
+        // Part of [offset, offset + size) residing on each device.
+        template <typename T>
+        std::vector<range> split(const vector<T> &x, size_t offset, size_t size) const {
+            precondition(offset + size <= x.size(), "Range is out of bounds");
+
+            std::vector<range> job(queue.size());
+
+            for(unsigned d = 0; d < queue.size(); ++d) {
+                job[d].pos = std::max(offset,        x.part_start(d));
+                job[d].end = std::min(offset + size, x.part_start(d) + x.part_size(d));
+            }
+
+            return job;
+        }
+
+        // Next staging buffer in the ring of the given device. Waits until
+        // the previous transfer through the buffer is complete.
+        staging& next_stage(unsigned d) {
+            staging &s = stage[d][current[d]];
+            current[d] = (current[d] + 1) % stage[d].size();
+
+            if (s.event()) {
+                s.event.wait();
+                s.event = cl::Event();
+            }
+
+            return s;
+        }
+};
+
+} // namespace vex
+
+#endif
@@ -0,0 +1,586 @@
+#ifndef VEXCL_COMPACT_HPP
+#define VEXCL_COMPACT_HPP
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/compact.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Stream compaction: copy_if, remove_if, partition, unique.
+ */
+
+#include <string>
+#include <vector>
+#include <numeric>
+#include <algorithm>
+
+#include <vexcl/backend.hpp>
+#include <vexcl/operations.hpp>
+#include <vexcl/vector.hpp>
+
+namespace vex {
+
+/// \cond INTERNAL
+namespace detail {
+
+// Vector expression used by the compaction kernels either as the predicate
+// or as the value to store. Each expression gets its own parameter prefix,
+// so that both may be output into the same kernel.
+template <class Expr>
+struct compact_expression {
+    const Expr &expr;
+    std::string prefix;
+
+    compact_expression(const Expr &expr, const std::string &prefix)
+        : expr(expr), prefix(prefix) {}
+
+    void preamble(backend::source_generator &src, const backend::command_queue &q) const {
+        output_terminal_preamble ctx(src, q, prefix, empty_state());
+        boost::proto::eval(boost::proto::as_child(expr), ctx);
+    }
+
+    void declare(backend::source_generator &src, const backend::command_queue &q) const {
+        declare_expression_parameter ctx(src, q, prefix, empty_state());
+        extract_terminals()(boost::proto::as_child(expr), ctx);
+    }
+
+    void local(backend::source_generator &src, const backend::command_queue &q) const {
+        output_local_preamble ctx(src, q, prefix, empty_state());
+        boost::proto::eval(boost::proto::as_child(expr), ctx);
+    }
+
+    void value(backend::source_generator &src, const backend::command_queue &q) const {
+        vector_expr_context ctx(src, q, prefix, empty_state());
+        boost::proto::eval(boost::proto::as_child(expr), ctx);
+    }
+
+    void set_args(backend::kernel &krn, unsigned d, size_t part_start) const {
+        set_expression_argument setarg(krn, d, part_start, empty_state());
+        extract_terminals()(boost::proto::as_child(expr), setarg);
+    }
+};
+
+// Selects the first element of each group of consecutive equal elements.
+// The first element on a device is compared with the last element on the
+// previous device, which is read before the compaction starts.
+template <typename T, class Comp>
+struct compact_unique {
+    const vector<T> &x;
+    std::vector<T> head;
+
+    compact_unique(const vector<T> &x) : x(x), head(x.nparts()) {
+        for(unsigned d = 1; d < x.nparts(); ++d)
+            if (size_t start = x.part_start(d)) head[d] = x[start - 1];
+    }
+
+    void preamble(backend::source_generator &src, const backend::command_queue&) const {
+        Comp::define(src, "unique_comp");
+    }
+
+    void declare(backend::source_generator &src, const backend::command_queue&) const {
+        src.parameter< global_ptr<const T> >("unique_x");
+        src.parameter< T                   >("unique_head");
+        src.parameter< int                 >("unique_has_head");
+    }
+
+    void local(backend::source_generator&, const backend::command_queue&) const {}
+
+    void value(backend::source_generator &src, const backend::command_queue&) const {
+        src << "(idx > 0 ? !unique_comp(unique_x[idx - 1], unique_x[idx]) : "
+               "(!unique_has_head || !unique_comp(unique_head, unique_x[0])))";
+    }
+
+    void set_args(backend::kernel &krn, unsigned d, size_t part_start) const {
+        krn.push_arg(x(d));
+        krn.push_arg(head[d]);
+        krn.push_arg(static_cast<int>(part_start > 0));
+    }
+};
+
+//---------------------------------------------------------------------------
+// Counts selected elements in each block. Blocks process contiguous chunks
+// of the input, so that the order of the elements is preserved by the
+// scatter kernel.
+template <int NT, class Pred>
+backend::kernel compact_count(const backend::command_queue &queue, const Pred &pred)
+{
+    static detail::kernel_cache cache;
+
+    auto cache_key = backend::cache_key(queue);
+    auto kernel    = cache.find(cache_key);
+
+    if (kernel == cache.end()) {
+        backend::source_generator src(queue);
+
+        pred.preamble(src, queue);
+
+        src.kernel("compact_count")
+            .open("(")
+                .parameter< size_t >("n")
+                .parameter< size_t >("chunk")
+                .parameter< int    >("negate");
+
+        pred.declare(src, queue);
+
+        src.parameter< global_ptr<cl_uint> >("counts");
+        src.close(")").open("{");
+
+        src.new_line() << "size_t l_id  = " << src.local_id(0) << ";";
+        src.new_line() << "size_t block = " << src.group_id(0) << ";";
+        src.new_line() << "size_t start = block * chunk;";
+        src.new_line() << "size_t stop  = start + chunk < n ? start + chunk : n;";
+
+        {
+            std::ostringstream shared;
+            shared << "shared[" << NT << "]";
+            src.smem_static_var(type_name<cl_uint>(), shared.str());
+        }
+
+        src.new_line() << type_name<cl_uint>() << " count = 0;";
+        src.new_line() << "for(size_t idx = start + l_id; idx < stop; idx += " << NT << ")";
+        src.open("{");
+        pred.local(src, queue);
+        src.new_line() << "if ((";
+        pred.value(src, queue);
+        src << ") ? !negate : negate) ++count;";
+        src.close("}");
+
+        src.new_line() << "shared[l_id] = count;";
+        for(int s = NT / 2; s > 0; s /= 2) {
+            src.new_line().barrier();
+            src.new_line() << "if (l_id < " << s << ") shared[l_id] += shared[l_id + " << s << "];";
+        }
+        src.new_line() << "if (l_id == 0) counts[block] = shared[0];";
+        src.close("}");
+
+        backend::kernel krn(queue, src.str(), "compact_count");
+        kernel = cache.insert(std::make_pair(cache_key, krn)).first;
+    }
+
+    return kernel->second;
+}
+
+//---------------------------------------------------------------------------
+// Scans the predicate within each block and scatters the elements to their
+// final positions. Selected elements go to true_base + rank, rejected ones
+// (when write_false is set) go to false_base + rank. Positions outside of
+// [lo, hi) belong to other devices and are written to the spill buffer.
+template <int NT, typename T, class Value, class Pred>
+backend::kernel compact_scatter(const backend::command_queue &queue,
+        const Value &value, const Pred &pred)
+{
+    static detail::kernel_cache cache;
+
+    auto cache_key = backend::cache_key(queue);
+    auto kernel    = cache.find(cache_key);
+
+    if (kernel == cache.end()) {
+        backend::source_generator src(queue);
+
+        value.preamble(src, queue);
+        pred.preamble(src, queue);
+
+        src.kernel("compact_scatter")
+            .open("(")
+                .parameter< size_t                    >("n")
+                .parameter< size_t                    >("chunk")
+                .parameter< int                       >("negate")
+                .parameter< int                       >("write_false")
+                .parameter< size_t                    >("true_base")
+                .parameter< size_t                    >("false_base")
+                .parameter< size_t                    >("lo")
+                .parameter< size_t                    >("hi")
+                .parameter< size_t                    >("spill_lo")
+                .parameter< size_t                    >("spill_hi_base")
+                .parameter< global_ptr<const cl_uint> >("counts")
+                .parameter< global_ptr<T>             >("output")
+                .parameter< global_ptr<T>             >("spill");
+
+        value.declare(src, queue);
+        pred.declare(src, queue);
+
+        src.close(")").open("{");
+
+        src.new_line() << "size_t l_id  = " << src.local_id(0) << ";";
+        src.new_line() << "size_t block = " << src.group_id(0) << ";";
+        src.new_line() << "size_t start = block * chunk;";
+        src.new_line() << "size_t stop  = start + chunk < n ? start + chunk : n;";
+
+        {
+            std::ostringstream shared;
+            shared << "shared[" << NT << "]";
+            src.smem_static_var(type_name<cl_uint>(), shared.str());
+        }
+
+        // Number of selected elements in the preceding blocks.
+        src.new_line() << type_name<cl_uint>() << " sum = 0;";
+        src.new_line() << "for(size_t i = l_id; i < block; i += " << NT << ") sum += counts[i];";
+        src.new_line() << "shared[l_id] = sum;";
+        for(int s = NT / 2; s > 0; s /= 2) {
+            src.new_line().barrier();
+            src.new_line() << "if (l_id < " << s << ") shared[l_id] += shared[l_id + " << s << "];";
+        }
+        src.new_line().barrier();
+
+        src.new_line() << "size_t pos_true  = shared[0];";
+        src.new_line() << "size_t pos_false = start - pos_true;";
+        src.new_line().barrier();
+
+        src.new_line() << "for(size_t tile = start; tile < stop; tile += " << NT << ")";
+        src.open("{");
+        src.new_line() << "size_t idx = tile + l_id;";
+        src.new_line() << type_name<cl_uint>() << " flag = 0;";
+        src.new_line() << "if (idx < stop)";
+        src.open("{");
+        pred.local(src, queue);
+        src.new_line() << "flag = (";
+        pred.value(src, queue);
+        src << ") ? !negate : negate;";
+        src.close("}");
+
+        // Inclusive scan of the flags within the tile.
+        src.new_line() << "shared[l_id] = flag;";
+        for(int s = 1; s < NT; s *= 2) {
+            src.new_line().barrier();
+            src.new_line() << type_name<cl_uint>() << " v" << s << " = l_id >= " << s
+                << " ? shared[l_id - " << s << "] : 0;";
+            src.new_line().barrier();
+            src.new_line() << "shared[l_id] += v" << s << ";";
+        }
+        src.new_line().barrier();
+
+        src.new_line() << type_name<cl_uint>() << " rank = shared[l_id] - flag;";
+        src.new_line() << type_name<cl_uint>() << " tile_count = shared[" << NT - 1 << "];";
+
+        src.new_line() << "if (idx < stop && (flag || write_false))";
+        src.open("{");
+        src.new_line() << "size_t p = flag ? true_base + pos_true + rank"
+                          " : false_base + pos_false + l_id - rank;";
+        value.local(src, queue);
+        src.new_line() << type_name<T>() << " val = ";
+        value.value(src, queue);
+        src << ";";
+        src.new_line() << "if (p < lo) spill[p - true_base] = val;";
+        src.new_line() << "else if (p >= hi) spill[spill_lo + p - spill_hi_base] = val;";
+        src.new_line() << "else output[p - lo] = val;";
+        src.close("}");
+
+        src.new_line() << "pos_true  += tile_count;";
+        src.new_line() << "pos_false += (stop - tile < " << NT << " ? stop - tile : " << NT << ") - tile_count;";
+        src.new_line().barrier();
+        src.close("}");
+
+        src.close("}");
+
+        backend::kernel krn(queue, src.str(), "compact_scatter");
+        kernel = cache.insert(std::make_pair(cache_key, krn)).first;
+    }
+
+    return kernel->second;
+}
+
+//---------------------------------------------------------------------------
+// Stores the selected elements to the beginning of the output, and, if
+// write_false is set, the rejected elements after them. The relative order
+// of the elements is preserved. Returns the number of selected elements.
+template <typename T, class Value, class Pred>
+size_t compact(const Value &value, const Pred &pred, vector<T> &out,
+        bool negate, bool write_false)
+{
+    const std::vector<backend::command_queue> &queue = out.queue_list();
+    const size_t ndev = queue.size();
+
+    const int NT_cpu = 1;
+    const int NT_gpu = 256;
+
+    int neg = negate      ? 1 : 0;
+    int wf  = write_false ? 1 : 0;
+
+    std::vector<size_t> chunk(ndev, 0), nblocks(ndev, 0);
+    std::vector< backend::device_vector<cl_uint> > counts(ndev);
+
+    // Count selected elements in each block.
+    for(unsigned d = 0; d < ndev; ++d) {
+        size_t psize = out.part_size(d);
+        if (!psize) continue;
+
+        backend::select_context(queue[d]);
+
+        const int NT = backend::is_cpu(queue[d]) ? NT_cpu : NT_gpu;
+
+        size_t ntiles  = (psize + NT - 1) / NT;
+        size_t ngroups = backend::kernel::num_workgroups(queue[d]);
+
+        chunk[d]   = NT * ((ntiles + ngroups - 1) / ngroups);
+        nblocks[d] = (psize + chunk[d] - 1) / chunk[d];
+        counts[d]  = backend::device_vector<cl_uint>(queue[d], nblocks[d]);
+
+        auto krn = backend::is_cpu(queue[d]) ?
+            compact_count<NT_cpu>(queue[d], pred) :
+            compact_count<NT_gpu>(queue[d], pred);
+
+        krn.push_arg(psize);
+        krn.push_arg(chunk[d]);
+        krn.push_arg(neg);
+        pred.set_args(krn, d, out.part_start(d));
+        krn.push_arg(counts[d]);
+
+        krn.config(nblocks[d], NT);
+        krn(queue[d]);
+    }
+
+    std::vector<size_t> selected(ndev, 0);
+    for(unsigned d = 0; d < ndev; ++d) {
+        if (!nblocks[d]) continue;
+
+        std::vector<cl_uint> c(nblocks[d]);
+        counts[d].read(queue[d], 0, nblocks[d], c.data(), true);
+        selected[d] = std::accumulate(c.begin(), c.end(), size_t(0));
+    }
+
+    std::vector<size_t> offset(ndev + 1, 0);
+    std::partial_sum(selected.begin(), selected.end(), offset.begin() + 1);
+    const size_t total = offset.back();
+
+    // Scatter the elements. Elements that belong to the other devices are
+    // only possible with multi-device vectors; these are staged through the
+    // host after the kernels are done.
+    std::vector< backend::device_vector<T> > spill(ndev);
+    std::vector<size_t> spill_lo(ndev, 0), spill_hi(ndev, 0), spill_hi_base(ndev, 0);
+
+    for(unsigned d = 0; d < ndev; ++d) {
+        size_t psize = out.part_size(d);
+        if (!psize) continue;
+
+        backend::select_context(queue[d]);
+
+        const int NT = backend::is_cpu(queue[d]) ? NT_cpu : NT_gpu;
+
+        size_t lo = out.part_start(d);
+        size_t hi = lo + psize;
+
+        size_t false_base = total + lo - offset[d];
+
+        spill_lo[d] = std::min(selected[d], lo - offset[d]);
+        spill_hi_base[d] = hi;
+
+        if (write_false) {
+            size_t false_end = false_base + psize - selected[d];
+
+            spill_hi_base[d] = std::max(false_base, hi);
+            if (false_end > spill_hi_base[d])
+                spill_hi[d] = false_end - spill_hi_base[d];
+        }
+
+        if (size_t nspill = spill_lo[d] + spill_hi[d])
+            spill[d] = backend::device_vector<T>(queue[d], nspill);
+        else
+            spill[d] = out(d);
+
+        auto krn = backend::is_cpu(queue[d]) ?
+            compact_scatter<NT_cpu, T>(queue[d], value, pred) :
+            compact_scatter<NT_gpu, T>(queue[d], value, pred);
+
+        krn.push_arg(psize);
+        krn.push_arg(chunk[d]);
+        krn.push_arg(neg);
+        krn.push_arg(wf);
+        krn.push_arg(offset[d]);
+        krn.push_arg(false_base);
+        krn.push_arg(lo);
+        krn.push_arg(hi);
+        krn.push_arg(spill_lo[d]);
+        krn.push_arg(spill_hi_base[d]);
+        krn.push_arg(counts[d]);
+        krn.push_arg(out(d));
+        krn.push_arg(spill[d]);
+        value.set_args(krn, d, lo);
+        pred.set_args(krn, d, lo);
+
+        krn.config(nblocks[d], NT);
+        krn(queue[d]);
+    }
+
+    for(unsigned d = 0; d < ndev; ++d) {
+        size_t nspill = spill_lo[d] + spill_hi[d];
+        if (!nspill) continue;
+
+        std::vector<T> h(nspill);
+        spill[d].read(queue[d], 0, nspill, h.data(), true);
+
+        if (spill_lo[d])
+            vex::copy(h.begin(), h.begin() + spill_lo[d], out.begin() + offset[d]);
+
+        if (spill_hi[d])
+            vex::copy(h.begin() + spill_lo[d], h.end(), out.begin() + spill_hi_base[d]);
+    }
+
+    return total;
+}
+
+template <typename T, class Pred>
+size_t compact_inplace(vector<T> &x, const Pred &pred, bool negate, bool write_false)
+{
+    if (!x.size()) return 0;
+
+    vector<T> tmp(x.queue_list(), x.size());
+
+    size_t n = compact(compact_expression< vector<T> >(x, "val"), pred, tmp,
+            negate, write_false);
+
+    x.swap(tmp);
+    return n;
+}
+
+template <class Expr, typename T>
+void check_compact_sizes(const Expr &expr, const vector<T> &x) {
+    get_expression_properties prop;
+    extract_terminals()(boost::proto::as_child(expr), prop);
+
+    precondition(
+            prop.queue.empty() || prop.queue.size() == x.nparts(),
+            "Incompatible queue lists"
+            );
+
+    precondition(
+            prop.size == 0 || prop.size == x.size(),
+            "Incompatible expression sizes"
+            );
+
+    precondition(
+            prop.part.empty() || prop.part == x.partition(),
+            "Incompatible partitioning"
+            );
+}
+
+} // namespace detail
+/// \endcond
+
+/// Copies the elements for which the predicate holds to the output vector.
+/**
+ * Both the input and the predicate are vector expressions, and the
+ * predicate is evaluated inside the compaction kernels, so no vector of
+ * flags is ever stored:
+ \code
+ size_t m = vex::copy_if(x, x > 0 && y < 1, z);
+ \endcode
+ * The output should have the same size and partitioning as the input and
+ * should not alias it. The relative order of the copied elements is
+ * preserved. Returns the number of copied elements; the rest of the output
+ * is left untouched.
+ */
+template <class Expr, class Pred, typename T>
+#ifdef DOXYGEN
+size_t
+#else
+typename std::enable_if<
+    boost::proto::matches<Expr, vector_expr_grammar>::value &&
+    boost::proto::matches<Pred, vector_expr_grammar>::value,
+    size_t
+>::type
+#endif
+copy_if(const Expr &input, const Pred &pred, vector<T> &output)
+{
+    if (!output.size()) return 0;
+
+    detail::check_compact_sizes(input, output);
+    detail::check_compact_sizes(pred,  output);
+
+    return detail::compact(
+            detail::compact_expression<Expr>(input, "val"),
+            detail::compact_expression<Pred>(pred,  "prd"),
+            output, false, false);
+}
+
+/// Removes the elements for which the predicate holds.
+/**
+ * The remaining elements are moved to the beginning of the vector with
+ * their relative order preserved. Returns the number of remaining elements;
+ * the values past it are unspecified.
+ */
+template <typename T, class Pred>
+#ifdef DOXYGEN
+size_t
+#else
+typename std::enable_if<
+    boost::proto::matches<Pred, vector_expr_grammar>::value,
+    size_t
+>::type
+#endif
+remove_if(vector<T> &x, const Pred &pred)
+{
+    detail::check_compact_sizes(pred, x);
+
+    return detail::compact_inplace(x,
+            detail::compact_expression<Pred>(pred, "prd"), true, false);
+}
+
+/// Reorders the vector so that the elements satisfying the predicate come first.
+/**
+ * The partitioning is stable: the relative order of the elements within
+ * each of the two groups is preserved. Returns the number of elements in the
+ * first group.
+ */
+template <typename T, class Pred>
+#ifdef DOXYGEN
+size_t
+#else
+typename std::enable_if<
+    boost::proto::matches<Pred, vector_expr_grammar>::value,
+    size_t
+>::type
+#endif
+partition(vector<T> &x, const Pred &pred)
+{
+    detail::check_compact_sizes(pred, x);
+
+    return detail::compact_inplace(x,
+            detail::compact_expression<Pred>(pred, "prd"), false, true);
+}
+
+/// Removes all but the first element from each group of consecutive equal elements.
+/**
+ * Elements are compared with the given VexCL function taking two elements
+ * and returning true when they are equal. Returns the number of remaining
+ * elements; the values past it are unspecified.
+ */
+template <typename T, class Comp>
+size_t unique(vector<T> &x, Comp)
+{
+    return detail::compact_inplace(x,
+            detail::compact_unique<T, Comp>(x), false, false);
+}
+
+/// Removes all but the first element from each group of consecutive equal elements.
+template <typename T>
+size_t unique(vector<T> &x)
+{
+    VEX_FUNCTION(equal, bool(T, T), "return prm1 == prm2;");
+    return unique(x, equal);
+}
+
+} // namespace vex
+
+#endif
@@ -35,6 +35,7 @@ THE SOFTWARE.
 #include <functional>
 #include <string>
 #include <cstdlib>
+#include <memory>
 
 #include <vexcl/backend.hpp>
 #include <vexcl/util.hpp>
@@ -279,6 +280,7 @@ class Context {
                 backend::command_queue_properties properties = 0)
         {
             std::tie(c, q) = backend::queue_list(std::forward<DevFilter>(filter), properties);
+            attach_buffer_pool();
 
 #ifdef VEXCL_THROW_ON_EMPTY_CONTEXT
             precondition(!q.empty(), "No compute devices found");
@@ -296,6 +298,8 @@ class Context {
                 q.push_back(u->second);
             }
 
+            attach_buffer_pool();
+
             StaticContext<>::set(*this);
         }
 
@@ -339,9 +343,33 @@ class Context {
             for(auto queue = q.begin(); queue != q.end(); ++queue)
                 queue->finish();
         }
+
+        /// Device memory allocated by VexCL on the d-th device.
+        /**
+         * Queues sharing a device report the same statistics.
+         */
+        device_memory_usage memory_usage(unsigned d) const {
+            return backend::memory_usage(q[d]);
+        }
+
+        /// Resets device memory high-water marks to the current usage.
+        void reset_memory_peak() const {
+            for(auto queue = q.begin(); queue != q.end(); ++queue)
+                backend::reset_memory_peak(*queue);
+        }
     private:
         std::vector<backend::context>       c;
         std::vector<backend::command_queue> q;
+
+        // Cached device buffers of a context are released once the last
+        // copy of the last vex::Context holding the context is destroyed.
+        std::vector< std::shared_ptr<void> > pool;
+
+        void attach_buffer_pool() {
+            pool.reserve(c.size());
+            for(auto ctx = c.begin(); ctx != c.end(); ++ctx)
+                pool.push_back(backend::attach_buffer_pool(*ctx));
+        }
 };
 
 } // namespace vex
@@ -28,7 +28,7 @@ THE SOFTWARE.
 /**
  * \file   vexcl/gather.hpp
  * \author Denis Demidov <dennis.demidov@gmail.com>
- * \brief  Gather scattered points from OpenCL device vector.
+ * \brief  Gather/scatter of scattered points from/to device vector.
  */
 
 #include <vector>
@@ -41,19 +41,24 @@ THE SOFTWARE.
 
 namespace vex {
 
+/// \cond INTERNAL
+namespace detail {
+
+// Sorted indices split between the devices, along with device buffers for
+// the indices and the values.
 template <typename T>
-class gather {
-    public:
-        gather(
+class scattered_indices {
+    protected:
+        scattered_indices(
                 const std::vector<backend::command_queue> &queue,
-                size_t src_size, std::vector<size_t> indices
-              )
-            : queue(queue), ptr(queue.size() + 1, 0),
-              idx(queue.size()), val(queue.size())
+                size_t vec_size, std::vector<size_t> indices, unsigned nbuf
+                )
+            : queue(queue), ptr(queue.size() + 1, 0), idx(queue.size()),
+              val(nbuf, std::vector< backend::device_vector<T> >(queue.size()))
         {
             assert(std::is_sorted(indices.begin(), indices.end()));
 
-            std::vector<size_t> part = partition(src_size, queue);
+            std::vector<size_t> part = partition(vec_size, queue);
             column_owner owner(part);
 
             for(auto i = indices.begin(); i != indices.end(); ++i) {
@@ -66,7 +71,9 @@ class gather {
 
             for(unsigned d = 0; d < queue.size(); d++) {
                 if (size_t n = ptr[d + 1] - ptr[d]) {
-                    val[d] = backend::device_vector<T>(queue[d], n, static_cast<const T*>(0));
+                    for(unsigned b = 0; b < nbuf; ++b)
+                        val[b][d] = backend::device_vector<T>(queue[d], n, static_cast<const T*>(0));
+
                     idx[d] = backend::device_vector<size_t>(
                             queue[d], n, &indices[ptr[d]], backend::MEM_READ_ONLY);
                 }
@@ -76,21 +83,170 @@ class gather {
                 if (ptr[d + 1] - ptr[d]) queue[d].finish();
         }
 
+        std::vector<backend::command_queue> queue;
+        std::vector<size_t>                           ptr;
+        std::vector< backend::device_vector<size_t> > idx;
+        std::vector< std::vector< backend::device_vector<T> > > val;
+};
+
+} // namespace detail
+/// \endcond
+
+/// Gathers values at the given positions of a device vector to host memory.
+/**
+ * The gather is double-buffered: async() launches the gather kernel into one
+ * set of device buffers and reads the results back on separate transfer
+ * queues, so that the kernel of the next step overlaps with the readback of
+ * the previous one. With the OpenCL backend the readback is ordered after the
+ * kernel with an event, so the host does not wait for the kernel either.
+ \code
+ vex::gather<double> get(ctx, x.size(), probe_idx);
+ std::vector<double> probe[2];
+
+ for(int step = 0; step < nsteps; ++step) {
+     advance(x);
+     get.async(x, probe[step % 2]);
+     if (step) process(probe[(step + 1) % 2]); // results of the previous step
+ }
+ get.wait();
+ \endcode
+ */
+template <typename T>
+class gather : private detail::scattered_indices<T> {
+    public:
+        /// Constructor.
+        /**
+         * \param queue    command queues of the source vector.
+         * \param src_size size of the source vector.
+         * \param indices  sorted positions to gather values from.
+         */
+        gather(
+                const std::vector<backend::command_queue> &queue,
+                size_t src_size, std::vector<size_t> indices
+              )
+            : Base(queue, src_size, std::move(indices), 2), current(0)
+        {
+            for(unsigned d = 0; d < queue.size(); d++)
+                xfer.push_back(backend::duplicate_queue(queue[d]));
+        }
+
+        ~gather() {
+            try {
+                wait();
+            } catch(...) {}
+        }
+
+        /// Gathers the values into the host vector.
         template <class HostVector>
         void operator()(const vex::vector<T> &src, HostVector &dst) {
-            using namespace detail;
-
-            static kernel_cache cache;
+            async(src, dst);
+            wait();
+        }
 
+        /// Starts gathering the values into the host vector.
+        /**
+         * Returns as soon as the gather kernels and the readback are
+         * enqueued; the readback waits for the kernels on the device. The
+         * host vector should not be accessed until the next call to async()
+         * or wait() returns.
+         */
+        template <class HostVector>
+        void async(const vex::vector<T> &src, HostVector &dst) {
             for(unsigned d = 0; d < queue.size(); d++) {
-                if (size_t n = ptr[d + 1] - ptr[d]) {
-                    vector<T>      v(queue[d], val[d]);
+                if (ptr[d + 1] - ptr[d]) {
+                    vector<T>      v(queue[d], val[current][d]);
                     vector<T>      s(queue[d], src(d));
                     vector<size_t> i(queue[d], idx[d]);
 
                     v = permutation(i)(s);
+                }
+            }
 
-                    val[d].read(queue[d], 0, n, &dst[ptr[d]]);
+#if defined(VEXCL_BACKEND_OPENCL)
+            std::vector< std::vector<cl::Event> > ready(queue.size());
+
+            for(unsigned d = 0; d < queue.size(); d++) {
+                if (ptr[d + 1] - ptr[d]) {
+                    ready[d].push_back(backend::enqueue_marker(queue[d]));
+                    queue[d].flush();
+                }
+            }
+#else
+            for(unsigned d = 0; d < queue.size(); d++)
+                if (ptr[d + 1] - ptr[d]) queue[d].finish();
+#endif
+
+            // The previous readback runs from the other buffer set while the
+            // kernels above execute; complete it before starting a new one.
+            wait();
+
+            for(unsigned d = 0; d < queue.size(); d++) {
+                if (size_t n = ptr[d + 1] - ptr[d]) {
+#if defined(VEXCL_BACKEND_OPENCL)
+                    val[current][d].read(xfer[d], 0, n, &dst[ptr[d]], false, 0, &ready[d]);
+#else
+                    val[current][d].read(xfer[d], 0, n, &dst[ptr[d]]);
+#endif
+                }
+            }
+
+            current = 1 - current;
+        }
+
+        /// Waits for the started readback to complete.
+        void wait() {
+            for(unsigned d = 0; d < queue.size(); d++)
+                if (ptr[d + 1] - ptr[d]) xfer[d].finish();
+        }
+    private:
+        typedef detail::scattered_indices<T> Base;
+
+        using Base::queue;
+        using Base::ptr;
+        using Base::idx;
+        using Base::val;
+
+        std::vector<backend::command_queue> xfer;
+        unsigned current;
+};
+
+/// Scatters host values to the given positions of a device vector.
+/**
+ * The values are uploaded to the devices, and written to their positions
+ * with a single kernel per device.
+ \code
+ vex::scatter<double> put(ctx, x.size(), probe_idx);
+ put(probe, x); // x[probe_idx[i]] = probe[i]
+ \endcode
+ */
+template <typename T>
+class scatter : private detail::scattered_indices<T> {
+    public:
+        /// Constructor.
+        /**
+         * \param queue    command queues of the destination vector.
+         * \param dst_size size of the destination vector.
+         * \param indices  sorted positions to scatter values to.
+         */
+        scatter(
+                const std::vector<backend::command_queue> &queue,
+                size_t dst_size, std::vector<size_t> indices
+               )
+            : Base(queue, dst_size, std::move(indices), 1)
+        {}
+
+        /// Scatters the host values into the device vector.
+        template <class HostVector>
+        void operator()(const HostVector &src, vex::vector<T> &dst) {
+            for(unsigned d = 0; d < queue.size(); d++) {
+                if (size_t n = ptr[d + 1] - ptr[d]) {
+                    val[0][d].write(queue[d], 0, n, &src[ptr[d]]);
+
+                    vector<T>      v(queue[d], val[0][d]);
+                    vector<T>      s(queue[d], dst(d));
+                    vector<size_t> i(queue[d], idx[d]);
+
+                    permutation(i)(s) = v;
                 }
             }
 
@@ -98,10 +254,12 @@ class gather {
                 if (ptr[d + 1] - ptr[d]) queue[d].finish();
         }
     private:
-        std::vector<backend::command_queue> queue;
-        std::vector<size_t>                           ptr;
-        std::vector< backend::device_vector<size_t> > idx;
-        std::vector< backend::device_vector<T> >      val;
+        typedef detail::scattered_indices<T> Base;
+
+        using Base::queue;
+        using Base::ptr;
+        using Base::idx;
+        using Base::val;
 };
 
 } // namespace vex
@@ -34,8 +34,11 @@ THE SOFTWARE.
 #include <iostream>
 #include <iomanip>
 #include <sstream>
+#include <fstream>
 #include <string>
+#include <vector>
 #include <stdexcept>
+#include <algorithm>
 #include <memory>
 
 #include <boost/proto/proto.hpp>
@@ -47,6 +50,7 @@ THE SOFTWARE.
 #include <vexcl/util.hpp>
 #include <vexcl/operations.hpp>
 #include <vexcl/vector.hpp>
+#include <vexcl/reductor.hpp>
 #include <boost/preprocessor/repetition.hpp>
 #ifndef VEXCL_MAX_ARITY
 #  define VEXCL_MAX_ARITY BOOST_PROTO_MAX_ARITY
@@ -56,6 +60,7 @@ THE SOFTWARE.
 namespace vex {
 
 template <typename T> class symbolic;
+template <typename T, class RDC> class symbolic_reduction;
 
 /// Sends name of the symbolic variable to output stream.
 template <typename T>
@@ -79,6 +84,9 @@ class recorder {
 
             // Reset preamble.
             preamble.reset(new backend::source_generator);
+
+            // Reset control flow scopes.
+            scope.clear();
         }
 
         static std::ostream& get() {
@@ -92,10 +100,16 @@ class recorder {
         static size_t var_id() {
             return ++index;
         }
+
+        // Stack of open control flow blocks.
+        static std::vector<char>& scopes() {
+            return scope;
+        }
     private:
         static size_t index;
         static std::ostream *os;
         static std::unique_ptr<backend::source_generator> preamble;
+        static std::vector<char> scope;
 };
 
 template <bool dummy>
@@ -107,6 +121,9 @@ std::ostream *recorder<dummy>::os = 0;
 template <bool dummy>
 std::unique_ptr<backend::source_generator> recorder<dummy>::preamble;
 
+template <bool dummy>
+std::vector<char> recorder<dummy>::scope;
+
 inline size_t var_id() {
     return recorder<>::var_id();
 }
@@ -237,6 +254,20 @@ struct symbolic_context {
 
 #undef VEXCL_UNARY_POST_OPERATION
 
+    template <typename Expr>
+    struct eval<Expr, boost::proto::tag::if_else_> {
+        typedef void result_type;
+        void operator()(const Expr &expr, symbolic_context &ctx) const {
+            get_recorder() << "( ";
+            boost::proto::eval(boost::proto::child_c<0>(expr), ctx);
+            get_recorder() << " ? ";
+            boost::proto::eval(boost::proto::child_c<1>(expr), ctx);
+            get_recorder() << " : ";
+            boost::proto::eval(boost::proto::child_c<2>(expr), ctx);
+            get_recorder() << " )";
+        }
+    };
+
     template <class Expr>
     struct eval<Expr, boost::proto::tag::function> {
         typedef void result_type;
@@ -318,6 +349,11 @@ struct symbolic_context {
         void operator()(const symbolic<T> &v, symbolic_context &) const {
             get_recorder() << v;
         }
+
+        template <typename T, class RDC>
+        void operator()(const symbolic_reduction<T, RDC> &v, symbolic_context &) const {
+            get_recorder() << v;
+        }
     };
 };
 
@@ -341,7 +377,8 @@ class symbolic
         enum scope_type {
             LocalVar        = 0, ///< Local variable.
             VectorParameter = 1, ///< Vector kernel parameter.
-            ScalarParameter = 2  ///< Scalar kernel parameter.
+            ScalarParameter = 2, ///< Scalar kernel parameter.
+            Reduction       = 3  ///< Reduction result (see vex::symbolic_reduction).
         };
 
         /// Constness of vector parameter.
@@ -429,6 +466,7 @@ class symbolic
                         s << ";\n";
                         break;
                     case LocalVar:
+                    case Reduction:
                         break;
                 }
             }
@@ -453,15 +491,18 @@ class symbolic
             if (constness == Const)
                 s << "const ";
 
-            if (scope == VectorParameter)
-                s << type_name< global_ptr<T> >();
-            else
-                s << type_name< T >();
-
-            s << " p_" << *this;
+            s << prmtype() << " p_" << *this;
 
             return s.str();
         }
+
+        /// Returns type of the kernel parameter.
+        std::string prmtype() const {
+            if (scope == VectorParameter)
+                return type_name< global_ptr<T> >();
+            else
+                return type_name< T >();
+        }
     private:
         size_t         num;
         scope_type     scope;
@@ -479,8 +520,268 @@ std::ostream& operator<<(std::ostream &os, const symbolic<T> &sym) {
     return os << "var" << sym.id();
 }
 
+/// Symbolic variable that is reduced over all elements of a generated kernel.
+/**
+ * For each element, the variable starts with the initial value of the
+ * reduction kind (vex::SUM, vex::MIN, vex::MAX, or a user-defined one), and
+ * its final value is combined with the values of the other elements. The
+ * reduction is done in local memory as in vex::Reductor, so that the kernel
+ * does a map and a reduction in a single pass. The result is returned
+ * through a pointer to a host variable that is passed to the kernel in place
+ * of the symbolic variable:
+ \code
+ vex::symbolic_reduction<double, vex::MAX> err;
+ err = fabs(sym_y - sym_x);
+
+ auto kernel = vex::generator::build_kernel(ctx, "step", body.str(), sym_x, sym_y, err);
+
+ double max_err;
+ kernel(x, y, &max_err);
+ \endcode
+ */
+template <typename T, class RDC>
+class symbolic_reduction : public symbolic<T> {
+    public:
+        symbolic_reduction() : symbolic<T>(symbolic<T>::Reduction) {}
+
+        using symbolic<T>::operator=;
+
+        /// Assignment operator. Results in assignment written to recorder.
+        const symbolic_reduction& operator=(const symbolic_reduction &c) const {
+            symbolic<T>::operator=(static_cast<const symbolic<T>&>(c));
+            return *this;
+        }
+
+        /// Initialize the variable for each element.
+        std::string init() const {
+            std::ostringstream s;
+            s << "\t\t" << type_name<T>() << " " << *this << " = " << initial() << ";\n";
+            return s.str();
+        }
+
+        /// Combine the variable with the partial result of the work item.
+        std::string write() const {
+            std::ostringstream s;
+            s << "\t\tsum_" << *this << " = reduce_" << *this
+              << "(sum_" << *this << ", " << *this << ");\n";
+            return s.str();
+        }
+
+        /// Returns string for parameter declaration.
+        std::string prmdecl() const {
+            std::ostringstream s;
+            s << type_name< global_ptr<T> >() << " p_" << *this;
+            return s.str();
+        }
+
+        /// Returns type of the kernel parameter.
+        std::string prmtype() const {
+            return type_name< global_ptr<T> >();
+        }
+
+        /// Initial value of the reduction.
+        static std::string initial() {
+            std::ostringstream s;
+            s << "(" << type_name<T>() << ")" << std::scientific
+              << std::setprecision(std::numeric_limits<T>::digits10 + 2)
+              << RDC::template initial<T>();
+            return s.str();
+        }
+};
+
 namespace generator {
 
+/// \cond INTERNAL
+namespace detail {
+
+template <class Expr>
+void record(const Expr &expr) {
+    symbolic_context ctx;
+    boost::proto::eval(boost::proto::as_expr(expr), ctx);
+}
+
+inline void open_scope(char kind) {
+    get_recorder() << " {\n";
+    recorder<>::scopes().push_back(kind);
+}
+
+inline void close_scope(char kind, const char *what) {
+    std::vector<char> &scope = recorder<>::scopes();
+
+    precondition(!scope.empty() && scope.back() == kind,
+            std::string(what) + " does not match an open block");
+
+    scope.pop_back();
+    get_recorder() << "\t\t}\n";
+}
+
+inline bool inside_loop() {
+    const std::vector<char> &scope = recorder<>::scopes();
+    return std::find_if(scope.begin(), scope.end(),
+            [](char k) { return k == 'w' || k == 'f'; }) != scope.end();
+}
+
+} // namespace detail
+/// \endcond
+
+/// Starts a conditional block in the recorded kernel.
+/**
+ * The block is closed with end_if(), and may contain else_if() and else_()
+ * branches:
+ \code
+ vex::generator::if_(x > 0);
+     y = sqrt(x);
+ vex::generator::else_();
+     y = 0;
+ vex::generator::end_if();
+ \endcode
+ * Symbolic variables declared inside a block are local to the block.
+ */
+template <class Expr>
+void if_(const Expr &cond) {
+    get_recorder() << "\t\tif ( ";
+    detail::record(cond);
+    get_recorder() << " )";
+    detail::open_scope('i');
+}
+
+/// Starts an alternative conditional branch of the current block.
+template <class Expr>
+void else_if(const Expr &cond) {
+    detail::close_scope('i', "else_if()");
+    get_recorder() << "\t\telse if ( ";
+    detail::record(cond);
+    get_recorder() << " )";
+    detail::open_scope('i');
+}
+
+/// Starts the branch taken when the conditions of the current block fail.
+inline void else_() {
+    detail::close_scope('i', "else_()");
+    get_recorder() << "\t\telse";
+    detail::open_scope('e');
+}
+
+/// Closes a conditional block.
+inline void end_if() {
+    std::vector<char> &scope = recorder<>::scopes();
+    detail::close_scope(!scope.empty() && scope.back() == 'e' ? 'e' : 'i', "end_if()");
+}
+
+/// Starts a loop that runs while the condition holds.
+/**
+ * The condition is evaluated on the device, so the number of iterations may
+ * depend on data. The loop is closed with end_while().
+ */
+template <class Expr>
+void while_(const Expr &cond) {
+    get_recorder() << "\t\twhile ( ";
+    detail::record(cond);
+    get_recorder() << " )";
+    detail::open_scope('w');
+}
+
+/// Closes a while_() loop.
+inline void end_while() {
+    detail::close_scope('w', "end_while()");
+}
+
+/// Starts a loop over the range [begin, end) of the symbolic variable i.
+/**
+ * Both bounds may be symbolic expressions. The loop is closed with
+ * end_for().
+ */
+template <typename T, class Begin, class End>
+void for_(const symbolic<T> &i, const Begin &begin, const End &end) {
+    get_recorder() << "\t\tfor ( " << i << " = ";
+    detail::record(begin);
+    get_recorder() << "; " << i << " < ";
+    detail::record(end);
+    get_recorder() << "; ++" << i << " )";
+    detail::open_scope('f');
+}
+
+/// Closes a for_() loop.
+inline void end_for() {
+    detail::close_scope('f', "end_for()");
+}
+
+/// Exits the innermost loop.
+inline void break_() {
+    precondition(detail::inside_loop(), "break_() outside of a loop");
+    get_recorder() << "\t\tbreak;\n";
+}
+
+/// Skips to the next iteration of the innermost loop.
+inline void continue_() {
+    precondition(detail::inside_loop(), "continue_() outside of a loop");
+    get_recorder() << "\t\tcontinue;\n";
+}
+
+/// \cond INTERNAL
+namespace detail {
+
+// Partial results of a kernel reduction and their host side finalization.
+struct kernel_reduction {
+    std::string type, local_type, initial, function;
+    size_t size;
+
+    virtual ~kernel_reduction() {}
+
+    virtual void allocate(const std::vector<backend::command_queue> &queue) = 0;
+    virtual void push_arg(backend::kernel &krn, unsigned d) const = 0;
+    virtual void read(const backend::command_queue &q, unsigned d) = 0;
+    virtual void finalize(void *result) = 0;
+};
+
+template <typename T, class RDC>
+struct kernel_reduction_impl : kernel_reduction {
+    std::vector<size_t> idx;
+    std::vector< backend::device_vector<T> > dbuf;
+    std::vector<T> hbuf;
+
+    kernel_reduction_impl(const std::string &name) {
+        type       = type_name<T>();
+        local_type = type_name< shared_ptr<T> >();
+        initial    = symbolic_reduction<T, RDC>::initial();
+        size       = sizeof(T);
+
+        backend::source_generator src;
+        RDC::template function<T>::define(src, "reduce_" + name);
+        function = src.str();
+    }
+
+    void allocate(const std::vector<backend::command_queue> &queue) {
+        idx.assign(1, 0);
+        dbuf.clear();
+
+        for(auto q = queue.begin(); q != queue.end(); ++q) {
+            size_t bufsize = backend::kernel::num_workgroups(*q);
+            idx.push_back(idx.back() + bufsize);
+            dbuf.push_back(backend::device_vector<T>(*q, bufsize));
+        }
+
+        hbuf.resize(idx.back());
+        std::fill(hbuf.begin(), hbuf.end(), RDC::template initial<T>());
+    }
+
+    void push_arg(backend::kernel &krn, unsigned d) const {
+        krn.push_arg(dbuf[d]);
+    }
+
+    void read(const backend::command_queue &q, unsigned d) {
+        dbuf[d].read(q, 0, idx[d + 1] - idx[d], &hbuf[idx[d]]);
+    }
+
+    void finalize(void *result) {
+        *static_cast<T*>(result) = RDC::reduce(hbuf.begin(), hbuf.end());
+        std::fill(hbuf.begin(), hbuf.end(), RDC::template initial<T>());
+    }
+};
+
+} // namespace detail
+/// \endcond
+
 /// Autogenerated kernel.
 template <size_t NP>
 class Kernel {
@@ -490,41 +791,97 @@ class Kernel {
                 const std::vector<backend::command_queue> &queue,
                 const std::string &name, const std::string &body,
                 const ArgTuple& args
-              ) : queue(queue)
+              ) : queue(queue), name(name), body(body),
+                  preamble(get_preamble().str())
         {
             static_assert(
                     boost::tuples::length<ArgTuple>::value == NP,
                     "Wrong number of kernel parameters"
                     );
 
-            for(auto q = queue.begin(); q != queue.end(); q++) {
-                backend::source_generator source(*q);
+            precondition(recorder<>::scopes().empty(),
+                    "Unterminated control flow block in kernel body");
 
-                source << get_preamble().str();
+            boost::fusion::for_each(args, collect_params(prm));
 
-                source.kernel(name).open("(")
-                    .parameter<size_t>("n");
-
-                boost::fusion::for_each(args, declare_params(source));
-
-                source.close(")").open("{").grid_stride_loop().open("{");
+            compile();
+        }
 
-                boost::fusion::for_each(args, read_params(source));
+        /// Loads kernel saved with Kernel::save().
+        /**
+         * The symbolic recording is not repeated; the kernel source is
+         * regenerated from the saved parts and compiled for each device
+         * (the compilation is skipped when VEXCL_CACHE_KERNELS is defined
+         * and the program binaries are found in the cache).
+         */
+        Kernel(const std::vector<backend::command_queue> &queue, std::istream &is)
+            : queue(queue)
+        {
+            std::string magic;
+            unsigned version = 0;
+            size_t np = 0;
+
+            is >> magic >> version >> np;
+
+            precondition(is && magic == "vexcl-generator-kernel",
+                    "Not a saved generator kernel");
+            precondition(version == format_version,
+                    "Unsupported version of saved generator kernel");
+            precondition(np == NP, "Wrong number of kernel parameters");
+
+            name     = read_string(is);
+            preamble = read_string(is);
+            body     = read_string(is);
+
+            prm.resize(NP);
+            for(auto p = prm.begin(); p != prm.end(); ++p) {
+                p->type  = read_string(is);
+                p->decl  = read_string(is);
+                p->init  = read_string(is);
+                p->write = read_string(is);
+            }
 
-                source << body;
+            precondition(static_cast<bool>(is), "Failed to read generator kernel");
 
-                boost::fusion::for_each(args, write_params(source));
+            for(auto p = prm.begin(); p != prm.end(); ++p)
+                precondition(!p->type.empty() &&
+                        p->decl.find(p->type) != std::string::npos,
+                        "Inconsistent parameter of saved generator kernel");
 
-                source.close("}").close("}");
+            compile();
+        }
 
-                backend::select_context(*q);
-                cache.insert(std::make_pair(
-                            backend::cache_key(*q),
-                            backend::kernel(*q, source.str(), name.c_str())
-                            ));
+        /// Saves the kernel to a stream.
+        /**
+         * Saves everything that is needed to recreate the kernel without
+         * repeating the symbolic recording: the recorded body, the preamble
+         * with user functions, and the parameter signature.
+         */
+        void save(std::ostream &os) const {
+            for(auto p = prm.begin(); p != prm.end(); ++p)
+                precondition(!p->red, "Kernels with reductions can not be saved");
+
+            os << "vexcl-generator-kernel " << format_version << " " << NP << "\n";
+
+            write_string(os, name);
+            write_string(os, preamble);
+            write_string(os, body);
+
+            for(auto p = prm.begin(); p != prm.end(); ++p) {
+                write_string(os, p->type);
+                write_string(os, p->decl);
+                write_string(os, p->init);
+                write_string(os, p->write);
             }
         }
 
+        /// Saves the kernel to a file.
+        void save(const std::string &fname) const {
+            std::ofstream f(fname.c_str(), std::ios::binary);
+            precondition(static_cast<bool>(f), "Failed to open " + fname);
+            save(f);
+        }
+
 #ifndef BOOST_NO_VARIADIC_TEMPLATES
         /// Launches kernel with provided parameters.
         template <class... Param>
@@ -556,74 +913,294 @@ BOOST_PP_REPEAT_FROM_TO(1, VEXCL_MAX_ARITY, VEXCL_FUNCALL_OPERATOR, ~)
                     "Wrong number of kernel parameters"
                     );
 
+            boost::fusion::for_each(param, check_params(prm));
+
+            std::vector<bool> active(queue.size(), false);
+
             for(unsigned d = 0; d < queue.size(); d++) {
                 if (size_t psize = boost::fusion::fold(param, 0, param_size(d))) {
                     auto key = backend::cache_key(queue[d]);
                     auto krn = cache.find(key);
                     krn->second.push_arg(psize);
 
-                    set_params setprm(krn->second, d);
+                    set_params setprm(krn->second, d, prm);
                     boost::fusion::for_each(param, setprm);
 
+                    if (smem) krn->second.set_smem(smem);
+
                     krn->second(queue[d]);
+
+                    active[d] = true;
                 }
             }
+
+            if (!smem) return;
+
+            // Collect partial results of the reductions.
+            for(auto p = prm.begin(); p != prm.end(); ++p)
+                if (p->red)
+                    for(unsigned d = 0; d < queue.size(); d++)
+                        if (active[d]) p->red->read(queue[d], d);
+
+            for(unsigned d = 0; d < queue.size(); d++)
+                if (active[d]) queue[d].finish();
+
+            boost::fusion::for_each(param, get_results(prm));
         }
 
-        struct declare_params {
-            backend::source_generator &src;
+        // Parts of the kernel source that depend on a parameter.
+        struct param {
+            std::string type, decl, init, write;
 
-            declare_params(backend::source_generator &src) : src(src) {}
+            // Reduction result (if the parameter is a reduction).
+            std::string var;
+            std::shared_ptr<detail::kernel_reduction> red;
+        };
+
+        struct collect_params {
+            std::vector<param> &prm;
+
+            collect_params(std::vector<param> &prm) : prm(prm) {}
 
             template <class T>
             void operator()(const T &v) const {
-                src << ",\n\t" << v.prmdecl();
+                param p;
+
+                p.type  = v.prmtype();
+                p.decl  = v.prmdecl();
+                p.init  = v.init();
+                p.write = v.write();
+
+                prm.push_back(p);
             }
-        };
 
-        struct read_params {
-            backend::source_generator &src;
+            template <typename T, class RDC>
+            void operator()(const symbolic_reduction<T, RDC> &v) const {
+                std::ostringstream var;
+                var << v;
 
-            read_params(backend::source_generator &src) : src(src) {}
+                param p;
 
-            template <class T>
-            void operator()(const T &v) const {
-                src << v.init();
+                p.type  = v.prmtype();
+                p.decl  = v.prmdecl();
+                p.init  = v.init();
+                p.write = v.write();
+                p.var   = var.str();
+                p.red   = std::make_shared< detail::kernel_reduction_impl<T, RDC> >(p.var);
+
+                prm.push_back(p);
             }
         };
 
-        struct write_params {
-            backend::source_generator &src;
+        // Checks the arguments against the parameter types before any of
+        // them is set. Reduction results are received through pointers to
+        // host variables of the reduction's value type.
+        struct check_params {
+            const std::vector<param> &prm;
+            mutable size_t pos;
 
-            write_params(backend::source_generator &src) : src(src) {}
+            check_params(const std::vector<param> &prm) : prm(prm), pos(0) {}
 
             template <class T>
-            void operator()(const T &v) const {
-                src << v.write();
+            void operator()(const T&) const {
+                check(type_name<T>(), false);
+            }
+
+            template <class T>
+            void operator()(const vector<T>&) const {
+                check(type_name< global_ptr<T> >(), false);
+            }
+
+            template <class T>
+            void operator()(T*) const {
+                check(type_name< global_ptr<T> >(), true);
+            }
+
+            void check(const std::string &type, bool reduction) const {
+                const param &p = prm[pos++];
+
+                precondition(static_cast<bool>(p.red) == reduction,
+                        reduction ?
+                        "Pointer passed for a non-reduction parameter" :
+                        "Reduction parameter expects a pointer to the result");
+                precondition(p.type == type,
+                        "Wrong type of generator kernel parameter");
             }
         };
 
         struct set_params {
             backend::kernel &krn;
             unsigned d;
+            const std::vector<param> &prm;
+            mutable size_t pos;
 
-            set_params(backend::kernel &krn, unsigned d)
-                : krn(krn), d(d) {};
+            set_params(backend::kernel &krn, unsigned d, const std::vector<param> &prm)
+                : krn(krn), d(d), prm(prm), pos(0) {};
 
             template <class T>
             void operator()(const T &v) const {
                 krn.push_arg(v);
+                ++pos;
             }
+
             template <class T>
             void operator()(const vector<T> &v) const {
                 krn.push_arg(v(d));
+                ++pos;
+            }
+
+            // Host variable receiving the result of a reduction.
+            template <class T>
+            void operator()(T*) const {
+                prm[pos++].red->push_arg(krn, d);
+            }
+        };
+
+        struct get_results {
+            const std::vector<param> &prm;
+            mutable size_t pos;
+
+            get_results(const std::vector<param> &prm) : prm(prm), pos(0) {}
+
+            template <class T>
+            void operator()(const T&) const {
+                ++pos;
+            }
+
+            template <class T>
+            void operator()(T *result) const {
+                prm[pos++].red->finalize(result);
             }
         };
 
         std::vector<backend::command_queue> queue;
 
+        std::string name, body, preamble;
+        std::vector<param> prm;
+
+        // Version of the format written by save().
+        static const unsigned format_version = 1;
+
         vex::detail::kernel_cache cache;
 
+        // Local memory per work item needed for the reductions.
+        size_t smem;
+
+        void compile() {
+            smem = 0;
+
+            for(auto p = prm.begin(); p != prm.end(); ++p) {
+                if (!p->red) continue;
+
+                smem = std::max(smem, p->red->size);
+                p->red->allocate(queue);
+            }
+
+            for(auto q = queue.begin(); q != queue.end(); q++) {
+                backend::source_generator source(*q);
+
+                source << preamble;
+
+                for(auto p = prm.begin(); p != prm.end(); ++p)
+                    if (p->red) source << p->red->function;
+
+                source.kernel(name).open("(")
+                    .parameter<size_t>("n");
+
+                for(auto p = prm.begin(); p != prm.end(); ++p)
+                    source << ",\n\t" << p->decl;
+
+                if (smem) source.smem_parameter<char>();
+
+                source.close(")").open("{");
+
+                if (smem) {
+                    source.smem_declaration<char>();
+                    source.new_line() << "size_t tid = " << source.local_id(0) << ";";
+                    source.new_line() << "size_t block_size = " << source.local_size(0) << ";";
+
+                    for(auto p = prm.begin(); p != prm.end(); ++p)
+                        if (p->red) source.new_line() << p->red->type
+                            << " sum_" << p->var << " = " << p->red->initial << ";";
+                }
+
+                source.grid_stride_loop().open("{");
+
+                for(auto p = prm.begin(); p != prm.end(); ++p)
+                    source << p->init;
+
+                source << body;
+
+                for(auto p = prm.begin(); p != prm.end(); ++p)
+                    source << p->write;
+
+                source.close("}");
+
+                for(auto p = prm.begin(); p != prm.end(); ++p)
+                    if (p->red) reduce(source, *p);
+
+                source.close("}");
+
+                backend::select_context(*q);
+
+                const size_t bytes = smem;
+                cache.insert(std::make_pair(
+                            backend::cache_key(*q),
+                            backend::kernel(*q, source.str(), name.c_str(), bytes)
+                            ));
+            }
+        }
+
+        // Reduction of partial results inside a work group (same as in
+        // vex::Reductor). The local memory is shared by all reductions.
+        static void reduce(backend::source_generator &source, const param &p) {
+            const std::string sum = "sum_" + p.var, fun = "reduce_" + p.var;
+
+            source.open("{");
+            source.new_line() << p.red->local_type << " sdata = ("
+                << p.red->local_type << ")smem;";
+            source.new_line() << "sdata[tid] = " << sum << ";";
+            source.new_line().barrier();
+            for(unsigned bs = 512; bs > 32; bs /= 2) {
+                source.new_line() << "if (block_size >= " << bs * 2 << ")";
+                source.open("{").new_line() << "if (tid < " << bs << ") "
+                    "{ sdata[tid] = " << sum << " = " << fun << "(" << sum
+                    << ", sdata[tid + " << bs << "]); }";
+                source.new_line().barrier().close("}");
+            }
+            source.new_line() << "if (tid < 32)";
+            source.open("{");
+            source.new_line() << "volatile " << p.red->local_type << " vdata = sdata;";
+            for(unsigned bs = 32; bs > 0; bs /= 2) {
+                source.new_line() << "if (block_size >= " << 2 * bs << ") "
+                    "{ vdata[tid] = " << sum << " = " << fun << "(" << sum
+                    << ", vdata[tid + " << bs << "]); }";
+            }
+            source.close("}");
+            source.new_line() << "if (tid == 0) p_" << p.var << "["
+                << source.group_id(0) << "] = sdata[0];";
+            source.new_line().barrier();
+            source.close("}");
+        }
+
+        // Strings are stored with their length, so that they may contain
+        // arbitrary characters.
+        static void write_string(std::ostream &os, const std::string &s) {
+            os << s.size() << "\n" << s << "\n";
+        }
+
+        static std::string read_string(std::istream &is) {
+            size_t size = 0;
+            is >> size;
+            is.get();
+
+            std::string s(size, ' ');
+            if (size) is.read(&s[0], size);
+            is.get();
+
+            return s;
+        }
+
         struct param_size {
             unsigned device;
 
@@ -631,8 +1208,14 @@ BOOST_PP_REPEAT_FROM_TO(1, VEXCL_MAX_ARITY, VEXCL_FUNCALL_OPERATOR, ~)
 
             typedef size_t result_type;
 
+            // Scalar parameters do not affect the kernel size.
+            template <class T>
+            size_t operator()(size_t s, const T&) const {
+                return s;
+            }
+
             template <class T>
-            size_t operator()(size_t s, const T &v) const {
+            size_t operator()(size_t s, const vector<T> &v) const {
                 return std::max(s, v.part_size(device));
             }
         };
@@ -717,6 +1300,18 @@ BOOST_PP_REPEAT_FROM_TO(1, VEXCL_MAX_ARITY, VEXCL_MAKE_FUNCTION, ~)
 
 #endif
 
+/// Loads kernel saved with Kernel::save() from a file.
+template <size_t NP>
+Kernel<NP> load_kernel(
+        const std::vector<backend::command_queue> &queue,
+        const std::string &fname
+        )
+{
+    std::ifstream f(fname.c_str(), std::ios::binary);
+    precondition(static_cast<bool>(f), "Failed to open " + fname);
+    return Kernel<NP>(queue, f);
+}
+
 /// UserFunction implementation from a generic functor
 template <class Signature, class Functor>
 struct FunctorAdapter : UserFunction<FunctorAdapter<Signature, Functor>, Signature>
@@ -0,0 +1,579 @@
+#ifndef VEXCL_MASK_HPP
+#define VEXCL_MASK_HPP
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/mask.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Bit-packed boolean masks and masked assignments.
+ */
+
+#include <vector>
+#include <memory>
+#include <sstream>
+#include <algorithm>
+
+#include <vexcl/operations.hpp>
+#include <vexcl/vector.hpp>
+#include <vexcl/reductor.hpp>
+
+namespace vex {
+
+class mask;
+
+/// \cond INTERNAL
+namespace detail {
+
+// Number of mask bits packed into a single word.
+const size_t mask_word_bits = 32;
+
+// Number of words produced by a work group on GPUs.
+const size_t mask_words_per_group = 8;
+
+// Assigns vector expression to the elements of lhs that are set in the mask.
+template <class OP, class LHS, class RHS>
+void assign_masked_expression(const mask &m, LHS &lhs, const RHS &rhs);
+
+// Words of a mask as a vector expression terminal (used for reductions).
+struct mask_words_terminal {};
+
+typedef vector_expression<
+    typename boost::proto::terminal< mask_words_terminal >::type
+    > mask_words_terminal_expression;
+
+struct mask_words : public mask_words_terminal_expression {
+    const mask &m;
+
+    mask_words(const mask &m) : m(m) {}
+};
+
+#if defined(VEXCL_BACKEND_CUDA)
+#  define VEXCL_MASK_POPCOUNT "return __popc(prm1);"
+#else
+#  define VEXCL_MASK_POPCOUNT "return popcount(prm1);"
+#endif
+
+VEX_FUNCTION_TYPE(mask_popcount_t, cl_uint(cl_uint), "", VEXCL_MASK_POPCOUNT);
+
+#undef VEXCL_MASK_POPCOUNT
+
+} // namespace detail
+
+// Lvalue expression restricted to the elements set in a mask.
+template <class LHS>
+struct masked_expression {
+    const mask &m;
+    LHS &lhs;
+
+    masked_expression(const mask &m, LHS &lhs) : m(m), lhs(lhs) {}
+
+#define VEXCL_ASSIGNMENT(cop, op)                                              \
+  template <class RHS>                                                         \
+  typename std::enable_if<                                                     \
+      boost::proto::matches<                                                   \
+          typename boost::proto::result_of::as_expr<RHS>::type,               \
+          vector_expr_grammar>::value,                                         \
+      const masked_expression &>::type operator cop(const RHS & rhs) const {   \
+    detail::assign_masked_expression<op>(m, lhs, rhs);                         \
+    return *this;                                                              \
+  }
+
+    VEXCL_ASSIGNMENT(=,   assign::SET)
+    VEXCL_ASSIGNMENT(+=,  assign::ADD)
+    VEXCL_ASSIGNMENT(-=,  assign::SUB)
+    VEXCL_ASSIGNMENT(*=,  assign::MUL)
+    VEXCL_ASSIGNMENT(/=,  assign::DIV)
+    VEXCL_ASSIGNMENT(%=,  assign::MOD)
+    VEXCL_ASSIGNMENT(&=,  assign::AND)
+    VEXCL_ASSIGNMENT(|=,  assign::OR)
+    VEXCL_ASSIGNMENT(^=,  assign::XOR)
+    VEXCL_ASSIGNMENT(<<=, assign::LSH)
+    VEXCL_ASSIGNMENT(>>=, assign::RSH)
+
+#undef VEXCL_ASSIGNMENT
+};
+/// \endcond
+
+/// Bit-packed boolean mask.
+/**
+ * Each element of the mask takes a single bit of device memory. Masks are
+ * produced from boolean vector expressions, and restrict assignments to the
+ * active elements of a vector. Inactive elements are neither read nor
+ * written, and the right hand side is only evaluated for the active ones:
+ \code
+ vex::mask m(ctx, n);
+
+ m = x > y;
+ m(x) = sqrt(x - y);   // Only touches elements where x > y.
+
+ size_t k = m.count(); // Number of active elements.
+ \endcode
+ * The mask is partitioned across devices in the same way as vex::vector of
+ * the same size.
+ */
+class mask {
+    public:
+        /// Empty constructor.
+        mask() {}
+
+        /// Creates mask of the given size with all elements cleared.
+        mask(const std::vector<backend::command_queue> &queue, size_t size)
+            : queue(queue), part(vex::partition(size, queue)),
+              wpart(queue.size() + 1, 0), buf(queue.size()),
+              counter(std::make_shared<count_cache>(queue))
+        {
+            for(unsigned d = 0; d < queue.size(); ++d) {
+                size_t nw = (part[d + 1] - part[d] + detail::mask_word_bits - 1)
+                          / detail::mask_word_bits;
+
+                wpart[d + 1] = wpart[d] + nw;
+
+                if (nw) {
+                    std::vector<cl_uint> zeros(nw, 0);
+                    buf[d] = backend::device_vector<cl_uint>(queue[d], nw, zeros.data());
+                }
+            }
+        }
+
+        /// Sets mask elements to the values of a boolean vector expression.
+        template <class Expr>
+        typename std::enable_if<
+            boost::proto::matches<
+                typename boost::proto::result_of::as_expr<Expr>::type,
+                vector_expr_grammar
+            >::value,
+            const mask&
+        >::type
+        operator=(const Expr &expr);
+
+        /// Restricts assignments to the given vector by the mask.
+        template <class LHS>
+        masked_expression<LHS> operator()(LHS &lhs) const {
+            return masked_expression<LHS>(*this, lhs);
+        }
+
+        /// Number of set elements.
+        /**
+         * The result is kept until the mask is assigned again, so that
+         * any(), all(), and none() do not repeat the reduction.
+         */
+        size_t count() const {
+            if (!size()) return 0;
+
+            if (!counter->valid) {
+                detail::mask_popcount_t popcount;
+                counter->count = counter->sum( popcount(detail::mask_words(*this)) );
+                counter->valid = true;
+            }
+
+            return counter->count;
+        }
+
+        /// Returns true if any element is set.
+        bool any() const { return count() > 0; }
+
+        /// Returns true if all elements are set.
+        bool all() const { return count() == size(); }
+
+        /// Returns true if no element is set.
+        bool none() const { return count() == 0; }
+
+        /// Mask size.
+        size_t size() const { return part.empty() ? 0 : part.back(); }
+
+        /// Number of elements located on the given device.
+        size_t part_size(unsigned d) const { return part[d + 1] - part[d]; }
+
+        /// Index of the first element located on the given device.
+        size_t part_start(unsigned d) const { return part[d]; }
+
+        const std::vector<backend::command_queue>& queue_list() const {
+            return queue;
+        }
+
+        const std::vector<size_t>& partition() const {
+            return part;
+        }
+
+        /// Partitioning of the mask words across devices.
+        const std::vector<size_t>& word_partition() const {
+            return wpart;
+        }
+
+        /// Buffer with the mask words located on the given device.
+        /**
+         * Bit j of word i corresponds to the element i * 32 + j of the
+         * device partition.
+         */
+        const backend::device_vector<cl_uint>& operator()(unsigned d = 0) const {
+            return buf[d];
+        }
+    private:
+        std::vector<backend::command_queue>           queue;
+        std::vector<size_t>                           part;
+        std::vector<size_t>                           wpart;
+        std::vector< backend::device_vector<cl_uint> > buf;
+
+        // Shared between copies of the mask, since these share the buffers.
+        struct count_cache {
+            Reductor<size_t, SUM> sum;
+            size_t count;
+            bool   valid;
+
+            count_cache(const std::vector<backend::command_queue> &queue)
+                : sum(queue), count(0), valid(false) {}
+        };
+
+        std::shared_ptr<count_cache> counter;
+};
+
+/// \cond INTERNAL
+namespace traits {
+
+// Hold mask word terminals by reference:
+template <class T>
+struct hold_terminal_by_reference< T,
+        typename std::enable_if<
+            boost::proto::matches<
+                typename boost::proto::result_of::as_expr< T >::type,
+                boost::proto::terminal< detail::mask_words_terminal >
+            >::value
+        >::type
+    >
+    : std::true_type
+{ };
+
+template <>
+struct is_vector_expr_terminal< detail::mask_words_terminal > : std::true_type {};
+
+template <>
+struct proto_terminal_is_value< detail::mask_words_terminal > : std::true_type {};
+
+template <>
+struct kernel_param_declaration< detail::mask_words > {
+    static void get(backend::source_generator &src,
+            const detail::mask_words&,
+            const backend::command_queue&, const std::string &prm_name,
+            detail::kernel_generator_state_ptr)
+    {
+        src.parameter< global_ptr<const cl_uint> >(prm_name);
+    }
+};
+
+template <>
+struct partial_vector_expr< detail::mask_words > {
+    static void get(backend::source_generator &src,
+            const detail::mask_words&,
+            const backend::command_queue&, const std::string &prm_name,
+            detail::kernel_generator_state_ptr)
+    {
+        src << prm_name << "[idx]";
+    }
+};
+
+template <>
+struct kernel_arg_setter< detail::mask_words > {
+    static void set(const detail::mask_words &term,
+            backend::kernel &kernel, unsigned device, size_t/*index_offset*/,
+            detail::kernel_generator_state_ptr)
+    {
+        kernel.push_arg(term.m(device));
+    }
+};
+
+template <>
+struct expression_properties< detail::mask_words > {
+    static void get(const detail::mask_words &term,
+            std::vector<backend::command_queue> &queue_list,
+            std::vector<size_t> &partition,
+            size_t &size
+            )
+    {
+        queue_list = term.m.queue_list();
+        partition  = term.m.word_partition();
+        size       = partition.back();
+    }
+};
+
+} // namespace traits
+
+template <class Expr>
+typename std::enable_if<
+    boost::proto::matches<
+        typename boost::proto::result_of::as_expr<Expr>::type,
+        vector_expr_grammar
+    >::value,
+    const mask&
+>::type
+mask::operator=(const Expr &expr) {
+    using namespace detail;
+
+#if (VEXCL_CHECK_SIZES > 0)
+    {
+        get_expression_properties prop;
+        extract_terminals()(boost::proto::as_child(expr), prop);
+
+        precondition(
+                prop.queue.empty() || prop.queue.size() == queue.size(),
+                "Incompatible queue lists"
+                );
+
+        precondition(
+                prop.size == 0 || prop.size == size(),
+                "Incompatible expression sizes"
+                );
+    }
+#endif
+
+    if (counter) counter->valid = false;
+
+    static kernel_cache cache;
+
+    for(unsigned d = 0; d < queue.size(); d++) {
+        auto key    = backend::cache_key(queue[d]);
+        auto kernel = cache.find(key);
+
+        backend::select_context(queue[d]);
+
+        if (kernel == cache.end()) {
+            backend::source_generator source(queue[d]);
+
+            output_terminal_preamble termpream(source, queue[d], "prm", empty_state());
+            boost::proto::eval(boost::proto::as_child(expr), termpream);
+
+            source.kernel("vexcl_mask_kernel")
+                .open("(")
+                    .parameter<size_t>("n")
+                    .parameter<size_t>("nw")
+                    .parameter< global_ptr<cl_uint> >("mask");
+
+            declare_expression_parameter declare(source, queue[d], "prm", empty_state());
+            extract_terminals()(boost::proto::as_child(expr), declare);
+
+            source.close(")").open("{");
+
+            if (backend::is_cpu(queue[d])) {
+                // Each work item packs whole words of a contiguous chunk.
+                source.grid_stride_loop("w", "nw").open("{");
+
+                source.new_line() << type_name<cl_uint>() << " bits = 0;";
+                source.new_line() << "for(" << type_name<cl_uint>() << " j = 0; j < "
+                    << mask_word_bits << "; ++j)";
+                source.open("{");
+                source.new_line() << type_name<size_t>() << " idx = w * "
+                    << mask_word_bits << " + j;";
+                source.new_line() << "if (idx >= n) break;";
+
+                output_local_preamble loc_init(source, queue[d], "prm", empty_state());
+                boost::proto::eval(boost::proto::as_child(expr), loc_init);
+
+                vector_expr_context expr_ctx(source, queue[d], "prm", empty_state());
+
+                source.new_line() << "if (";
+                boost::proto::eval(boost::proto::as_child(expr), expr_ctx);
+                source << ") bits |= (1u << j);";
+
+                source.close("}");
+                source.new_line() << "mask[w] = bits;";
+                source.close("}");
+            } else {
+                // Each work item evaluates a single element, so that the
+                // loads are coalesced. The bits are combined into words in
+                // local memory and written by the first work items of the
+                // group.
+                const size_t nwords = mask_words_per_group;
+                const size_t NT     = nwords * mask_word_bits;
+
+                {
+                    std::ostringstream bits;
+                    bits << "bits[" << NT << "]";
+                    source.smem_static_var(type_name<cl_uint>(), bits.str());
+                }
+
+                source.new_line() << type_name<size_t>() << " l_id = " << source.local_id(0) << ";";
+                source.new_line() << "for(" << type_name<size_t>() << " base = "
+                    << source.group_id(0) << " * " << NT << "; base < n; base += "
+                    << source.global_size(0) << ")";
+                source.open("{");
+                source.new_line() << type_name<size_t>() << " idx = base + l_id;";
+                source.new_line() << type_name<cl_uint>() << " bit = 0;";
+                source.new_line() << "if (idx < n)";
+                source.open("{");
+
+                output_local_preamble loc_init(source, queue[d], "prm", empty_state());
+                boost::proto::eval(boost::proto::as_child(expr), loc_init);
+
+                vector_expr_context expr_ctx(source, queue[d], "prm", empty_state());
+
+                source.new_line() << "if (";
+                boost::proto::eval(boost::proto::as_child(expr), expr_ctx);
+                source << ") bit = 1u << (l_id % " << mask_word_bits << ");";
+
+                source.close("}");
+                source.new_line() << "bits[l_id] = bit;";
+                source.new_line().barrier();
+                source.new_line() << "if (l_id < " << nwords << " && base + l_id * "
+                    << mask_word_bits << " < n)";
+                source.open("{");
+                source.new_line() << type_name<cl_uint>() << " w = 0;";
+                source.new_line() << "for(int j = 0; j < " << mask_word_bits
+                    << "; ++j) w |= bits[l_id * " << mask_word_bits << " + j];";
+                source.new_line() << "mask[base / " << mask_word_bits << " + l_id] = w;";
+                source.close("}");
+                source.new_line().barrier();
+                source.close("}");
+            }
+
+            source.close("}");
+
+            backend::kernel krn(queue[d], source.str(), "vexcl_mask_kernel");
+
+            kernel = cache.insert(std::make_pair(key, krn)).first;
+        }
+
+        if (size_t psize = part[d + 1] - part[d]) {
+            kernel->second.push_arg(psize);
+            kernel->second.push_arg(wpart[d + 1] - wpart[d]);
+            kernel->second.push_arg(buf[d]);
+
+            set_expression_argument setarg(kernel->second, d, part[d], empty_state());
+            extract_terminals()(boost::proto::as_child(expr), setarg);
+
+            if (!backend::is_cpu(queue[d])) {
+                const size_t NT = mask_words_per_group * mask_word_bits;
+
+                kernel->second.config(std::min(
+                            backend::kernel::num_workgroups(queue[d]),
+                            (psize + NT - 1) / NT), NT);
+            }
+
+            kernel->second(queue[d]);
+        }
+    }
+
+    return *this;
+}
+
+namespace detail {
+
+template <class OP, class LHS, class RHS>
+void assign_masked_expression(const mask &m, LHS &lhs, const RHS &rhs)
+{
+    const std::vector<backend::command_queue> &queue = m.queue_list();
+    const std::vector<size_t> &part = m.partition();
+
+#if (VEXCL_CHECK_SIZES > 0)
+    {
+        get_expression_properties prop;
+        extract_terminals()(boost::proto::as_child(lhs), prop);
+        extract_terminals()(boost::proto::as_child(rhs), prop);
+
+        precondition(
+                prop.queue.empty() || prop.queue.size() == queue.size(),
+                "Incompatible queue lists"
+                );
+
+        precondition(
+                prop.size == 0 || prop.size == part.back(),
+                "Incompatible expression sizes"
+                );
+    }
+#endif
+
+    static kernel_cache cache;
+
+    for(unsigned d = 0; d < queue.size(); d++) {
+        auto key    = backend::cache_key(queue[d]);
+        auto kernel = cache.find(key);
+
+        backend::select_context(queue[d]);
+
+        if (kernel == cache.end()) {
+            backend::source_generator source(queue[d]);
+
+            output_terminal_preamble termpream(source, queue[d], "prm", empty_state());
+
+            boost::proto::eval(boost::proto::as_child(lhs), termpream);
+            boost::proto::eval(boost::proto::as_child(rhs), termpream);
+
+            source.kernel("vexcl_masked_kernel")
+                .open("(")
+                    .parameter<size_t>("n")
+                    .parameter< global_ptr<const cl_uint> >("mask");
+
+            declare_expression_parameter declare(source, queue[d], "prm", empty_state());
+
+            extract_terminals()(boost::proto::as_child(lhs), declare);
+            extract_terminals()(boost::proto::as_child(rhs), declare);
+
+            source.close(")")
+                .open("{")
+                    .grid_stride_loop()
+                    .open("{");
+
+            // Inactive elements skip both the loads and the store.
+            source.new_line() << "if (!(mask[idx / " << mask_word_bits << "]"
+                " & (1u << (idx % " << mask_word_bits << ")))) continue;";
+
+            output_local_preamble loc_init(source, queue[d], "prm", empty_state());
+            boost::proto::eval(boost::proto::as_child(lhs), loc_init);
+            boost::proto::eval(boost::proto::as_child(rhs), loc_init);
+
+            vector_expr_context expr_ctx(source, queue[d], "prm", empty_state());
+
+            source.new_line();
+            boost::proto::eval(boost::proto::as_child(lhs), expr_ctx);
+            source << " " << OP::string() << " ";
+            boost::proto::eval(boost::proto::as_child(rhs), expr_ctx);
+
+            source << ";";
+            source.close("}").close("}");
+
+            backend::kernel krn(queue[d], source.str(), "vexcl_masked_kernel");
+
+            kernel = cache.insert(std::make_pair(key, krn)).first;
+        }
+
+        if (size_t psize = part[d + 1] - part[d]) {
+            kernel->second.push_arg(psize);
+            kernel->second.push_arg(m(d));
+
+            set_expression_argument setarg(kernel->second, d, part[d], empty_state());
+
+            extract_terminals()( boost::proto::as_child(lhs), setarg);
+            extract_terminals()( boost::proto::as_child(rhs), setarg);
+
+            kernel->second(queue[d]);
+        }
+    }
+}
+
+} // namespace detail
+/// \endcond
+
+} // namespace vex
+
+#endif
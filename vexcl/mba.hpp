@@ -33,10 +33,12 @@ THE SOFTWARE.
 
 #include <vector>
 #include <array>
+#include <map>
 #include <sstream>
 #include <memory>
 #include <algorithm>
 #include <numeric>
+#include <iterator>
 #include <type_traits>
 #include <cassert>
 
@@ -45,6 +47,14 @@ THE SOFTWARE.
 
 #include <vexcl/operations.hpp>
 
+#ifdef _OPENMP
+#  include <omp.h>
+#endif
+
+#ifdef VEXCL_MBA_VERBOSE
+#  include <vexcl/profiler.hpp>
+#endif
+
 // Include boost.preprocessor header if variadic templates are not available.
 // Also include it if we use gcc v4.6.
 // This is required due to bug http://gcc.gnu.org/bugzilla/show_bug.cgi?id=35722
@@ -202,41 +212,114 @@ class mba {
          * \param grid   initial control lattice size (excluding boundary points).
          * \param levels number of levels in hierarchy.
          * \param tol    stop if residual is less than this.
+         * \param appendable keep the hierarchy in host memory, so that
+         *               points may be added with append().
          */
         mba(
                 const std::vector<backend::command_queue> &queue,
                 const point &cmin, const point &cmax,
                 const std::vector<point> &coo, std::vector<real> val,
-                std::array<size_t, NDIM> grid, size_t levels = 8, real tol = 1e-8
+                std::array<size_t, NDIM> grid, size_t levels = 8, real tol = 1e-8,
+                bool appendable = false
            ) : queue(queue)
         {
-            init(cmin, cmax, coo.begin(), coo.end(), val.begin(), grid, levels, tol);
+            init(cmin, cmax, coo.begin(), coo.end(), val.begin(), grid, levels, tol, appendable);
         }
 
         /**
          * \param queue     command queue list.
          * \param cmin      corner of bounding box with smallest coordinates.
          * \param cmax      corner of bounding box with largest coordinates.
-         * \param coo_begin input iterator to the initial position in a
+         * \param coo_begin random access iterator to the initial position in
+         *                  a sequence of scattered data coordinates.
+         * \param coo_end   random access iterator to the final position in a
          *                  sequence of scattered data coordinates.
-         * \param coo_end   input iterator to the final position in a sequence
-         *                  of scattered data coordinates.
-         * \param val_begin input iterator to the initial position in a
-         *                  sequence of scattered data values.
+         * \param val_begin random access iterator to the initial position in
+         *                  a sequence of scattered data values. The values
+         *                  are overwritten with the final residuals.
          * \param grid      initial control lattice size (excluding boundary
          *                  points).
          * \param levels    number of levels in hierarchy.
          * \param tol       stop if residual is less than this.
+         * \param appendable keep the hierarchy in host memory, so that
+         *                  points may be added with append().
          */
         template <class CooIter, class ValIter>
         mba(
                 const std::vector<backend::command_queue> &queue,
                 const point &cmin, const point &cmax,
                 CooIter coo_begin, CooIter coo_end, ValIter val_begin,
-                std::array<size_t, NDIM> grid, size_t levels = 8, real tol = 1e-8
+                std::array<size_t, NDIM> grid, size_t levels = 8, real tol = 1e-8,
+                bool appendable = false
            ) : queue(queue)
         {
-            init(cmin, cmax, coo_begin, coo_end, val_begin, grid, levels, tol);
+            init(cmin, cmax, coo_begin, coo_end, val_begin, grid, levels, tol, appendable);
+        }
+
+        /// Add data points to the interpolation.
+        /**
+         * Residuals of the new points with respect to the coarser levels of
+         * the hierarchy are added to the finest control lattice. Only the
+         * lattice cells touched by the new points are updated, and only the
+         * changed parts of the lattice are copied to the compute devices.
+         *
+         * The coarser levels are left intact, so the result is an
+         * approximation of the one obtained by constructing the object from
+         * the complete set of points. Points outside of the initial bounding
+         * box are ignored.
+         *
+         * The object has to be constructed with the appendable flag set.
+         */
+        void append(const std::vector<point> &coo, const std::vector<real> &val) {
+            append(coo.begin(), coo.end(), val.begin());
+        }
+
+        /// Add data points to the interpolation.
+        template <class CooIter, class ValIter>
+        void append(CooIter coo_begin, CooIter coo_end, ValIter val_begin) {
+            precondition(!hierarchy.empty(),
+                    "mba has to be constructed as appendable to add points");
+
+            std::vector<point> coo;
+            std::vector<real>  val;
+
+            for(; coo_begin != coo_end; ++coo_begin, ++val_begin) {
+                if (!lattice::contained(cmin, cmax, *coo_begin)) continue;
+
+                coo.push_back(*coo_begin);
+                val.push_back(*val_begin);
+            }
+
+            if (coo.empty()) return;
+
+            // Residuals with respect to the coarser levels.
+            for(size_t l = 0; l + 1 < hierarchy.size(); ++l)
+                hierarchy[l].update_data(coo.begin(), coo.end(), val.begin());
+
+            // The points are added to the finest lattice only, so that the
+            // changes stay local.
+            std::map<size_t, real> change;
+            hierarchy.back().insert(coo.begin(), coo.end(), val.begin(), change);
+
+            for(auto c = change.begin(); c != change.end(); ++c)
+                host[c->first] += c->second;
+
+            // Copy contiguous runs of changed cells (small gaps are copied
+            // as well to reduce the number of transfers).
+            const size_t gap = 64;
+
+            for(auto c = change.begin(); c != change.end(); ) {
+                size_t beg = c->first, end = beg + 1;
+
+                for(++c; c != change.end() && c->first < end + gap; ++c)
+                    end = c->first + 1;
+
+                for(unsigned d = 0; d < queue.size(); ++d)
+                    phi[d].write(queue[d], beg, end - beg, host.data() + beg);
+            }
+
+            for(unsigned d = 0; d < queue.size(); ++d)
+                queue[d].finish();
         }
 
 #if !defined(BOOST_NO_VARIADIC_TEMPLATES) && ((!defined(__GNUC__) || (__GNUC__ > 4 || __GNUC__ == 4 && __GNUC_MINOR__ > 6)) || defined(__clang__))
@@ -273,9 +356,19 @@ BOOST_PP_REPEAT_FROM_TO(1, VEXCL_MAX_ARITY, VEXCL_FUNCALL_OPERATOR, ~)
         void init(
                 const point &cmin, const point &cmax,
                 CooIter coo_begin, CooIter coo_end, ValIter val_begin,
-                std::array<size_t, NDIM> grid, size_t levels = 8, real tol = 1e-8
+                std::array<size_t, NDIM> grid, size_t levels, real tol,
+                bool appendable
                 )
         {
+            // The lattices are built from the points concurrently.
+            static_assert(
+                    std::is_base_of<std::random_access_iterator_tag,
+                        typename std::iterator_traits<CooIter>::iterator_category>::value &&
+                    std::is_base_of<std::random_access_iterator_tag,
+                        typename std::iterator_traits<ValIter>::iterator_category>::value,
+                    "mba requires random access iterators"
+                    );
+
             for(size_t k = 0; k < NDIM; ++k)
                 assert(grid[k] > 1);
 
@@ -285,47 +378,74 @@ BOOST_PP_REPEAT_FROM_TO(1, VEXCL_MAX_ARITY, VEXCL_FUNCALL_OPERATOR, ~)
                     [](real sum, real v) { return sum + v * v; }
                     );
 
-            std::unique_ptr<lattice> psi(
-                    new lattice(cmin, cmax, grid, coo_begin, coo_end, val_begin)
-                    );
-            double res = psi->update_data(coo_begin, coo_end, val_begin);
 #ifdef VEXCL_MBA_VERBOSE
-            std::cout << "level  0: res = " << std::scientific << res << std::endl;
+            stopwatch<> watch;
+#endif
+
+            this->cmin = cmin;
+            this->cmax = cmax;
+
+            hierarchy.push_back(lattice(cmin, cmax, grid, coo_begin, coo_end, val_begin));
+            double res = hierarchy.back().update_data(coo_begin, coo_end, val_begin);
+            host = hierarchy.back().phi;
+#ifdef VEXCL_MBA_VERBOSE
+            std::cout << "level  0: res = " << std::scientific << res
+                      << ", time = " << watch.toc() << "s" << std::endl;
 #endif
 
             for (size_t k = 1; (res > res0 * tol) && (k < levels); ++k) {
+#ifdef VEXCL_MBA_VERBOSE
+                watch.tic();
+#endif
                 for(size_t d = 0; d < NDIM; ++d) grid[d] = 2 * grid[d] - 1;
 
-                std::unique_ptr<lattice> f(
-                        new lattice(cmin, cmax, grid, coo_begin, coo_end, val_begin)
-                        );
-                res = f->update_data(coo_begin, coo_end, val_begin);
+                hierarchy.push_back(lattice(cmin, cmax, grid, coo_begin, coo_end, val_begin));
+
+                const lattice &f = hierarchy[k];
+                res = f.update_data(coo_begin, coo_end, val_begin);
+
+                std::vector<real> sum = f.phi;
+                f.refine(hierarchy[k - 1], host, sum);
+                host.swap(sum);
 #ifdef VEXCL_MBA_VERBOSE
-                std::cout << "level " << k << std::scientific << ": res = " << res << std::endl;
+                std::cout << "level " << k << std::scientific << ": res = " << res
+                          << ", time = " << watch.toc() << "s" << std::endl;
 #endif
+            }
 
-                f->append_refined(*psi);
-                psi = std::move(f);
+            // Accumulators are only needed for the finest level, where new
+            // points are added.
+            for(size_t k = 0; k + 1 < hierarchy.size(); ++k) {
+                std::vector<real>().swap(hierarchy[k].delta);
+                std::vector<real>().swap(hierarchy[k].omega);
             }
 
-            xmin   = psi->xmin;
-            hinv   = psi->hinv;
-            n      = psi->n;
-            stride = psi->stride;
+            const lattice &psi = hierarchy.back();
+
+            xmin   = psi.xmin;
+            hinv   = psi.hinv;
+            n      = psi.n;
+            stride = psi.stride;
 
             phi.reserve(queue.size());
 
             for(auto q = queue.begin(); q != queue.end(); ++q)
                 phi.push_back( backend::device_vector<real>(
-                            *q, psi->phi.size(), psi->phi.data(), backend::MEM_READ_ONLY
+                            *q, host.size(), host.data(), backend::MEM_READ_ONLY
                             ) );
+
+            // Only append() needs the host copies.
+            if (!appendable) {
+                std::vector<lattice>().swap(hierarchy);
+                std::vector<real>().swap(host);
+            }
         }
 
         // Control lattice.
         struct lattice {
             point xmin, hinv;
             index n, stride;
-            std::vector<real> phi;
+            std::vector<real> phi, delta, omega;
 
             template <class CooIter, class ValIter>
             lattice(
@@ -343,65 +463,86 @@ BOOST_PP_REPEAT_FROM_TO(1, VEXCL_MAX_ARITY, VEXCL_FUNCALL_OPERATOR, ~)
                 for(size_t d = NDIM - 1; d--; )
                     stride[d] = stride[d + 1] * n[d + 1];
 
-                std::vector<real> delta(n[0] * stride[0], 0.0);
-                std::vector<real> omega(n[0] * stride[0], 0.0);
+                const size_t    nlat = n[0] * stride[0];
+                const ptrdiff_t npts = coo_end - coo_begin;
+
+                phi.resize(nlat);
+                delta.resize(nlat, 0.0);
+                omega.resize(nlat, 0.0);
+
+                // The points are bucketed into strips of rows along the
+                // first dimension. A point touches four consecutive rows
+                // starting at its base row, so strips of at least four rows
+                // that are not adjacent never overlap, and may be scattered
+                // into the accumulators concurrently: even strips first,
+                // then odd ones.
+#ifdef _OPENMP
+                const size_t nstrips = std::max<size_t>(1, std::min<size_t>(
+                            2 * omp_get_max_threads(), n[0] / 4));
+#else
+                const size_t nstrips = 1;
+#endif
+                const size_t width = (n[0] + nstrips - 1) / nstrips;
 
-                auto p = coo_begin;
-                auto v = val_begin;
-                for(; p != coo_end; ++p, ++v) {
-                    if (!contained(cmin, cmax, *p)) continue;
+                std::vector<size_t> strip(npts);
 
-                    index i;
-                    point s;
+#ifdef _OPENMP
+#  pragma omp parallel for
+#endif
+                for(ptrdiff_t j = 0; j < npts; ++j) {
+                    const point &p = coo_begin[j];
 
-                    for(size_t d = 0; d < NDIM; ++d) {
-                        real u = ((*p)[d] - xmin[d]) * hinv[d];
-                        i[d] = static_cast<size_t>(std::floor(u) - 1);
-                        s[d] = u - std::floor(u);
-                    }
+                    strip[j] = contained(cmin, cmax, p) ?
+                        static_cast<size_t>(std::floor((p[0] - xmin[0]) * hinv[0]) - 1) / width :
+                        nstrips;
+                }
 
-                    std::array<real, detail::power<4, NDIM>::value> w;
-                    real sw2 = 0;
+                std::vector<size_t> sptr(nstrips + 2, 0);
+                for(ptrdiff_t j = 0; j < npts; ++j)
+                    if (strip[j] < nstrips) ++sptr[strip[j] + 2];
+                std::partial_sum(sptr.begin(), sptr.end(), sptr.begin());
 
-                    for(detail::scounter<4, NDIM> d; d.valid(); ++d) {
-                        real buf = 1;
-                        for(size_t k = 0; k < NDIM; ++k)
-                            buf *= B(d[k], s[k]);
+                std::vector<ptrdiff_t> order(sptr[nstrips + 1]);
+                for(ptrdiff_t j = 0; j < npts; ++j)
+                    if (strip[j] < nstrips) order[sptr[strip[j] + 1]++] = j;
 
-                        w[d] = buf;
-                        sw2 += buf * buf;
+                for(ptrdiff_t color = 0; color < 2; ++color) {
+#ifdef _OPENMP
+#  pragma omp parallel for schedule(dynamic)
+#endif
+                    for(ptrdiff_t s = color; s < static_cast<ptrdiff_t>(nstrips); s += 2) {
+                        for(size_t k = sptr[s]; k < sptr[s + 1]; ++k) {
+                            const ptrdiff_t j = order[k];
+                            scatter(coo_begin[j], val_begin[j], delta, omega);
+                        }
                     }
+                }
 
-                    for(detail::scounter<4, NDIM> d; d.valid(); ++d) {
-                        real phi = (*v) * w[d] / sw2;
-
-                        size_t idx = 0;
-                        for(size_t k = 0; k < NDIM; ++k) {
-                            assert(i[k] + d[k] < n[k]);
-
-                            idx += (i[k] + d[k]) * stride[k];
-                        }
+#ifdef _OPENMP
+#  pragma omp parallel for
+#endif
+                for(ptrdiff_t i = 0; i < static_cast<ptrdiff_t>(nlat); ++i)
+                    phi[i] = std::fabs(omega[i]) < 1e-32 ? 0 : delta[i] / omega[i];
+            }
 
-                        real w2 = w[d] * w[d];
+            // Add data points to the lattice and record changes of phi.
+            template <class CooIter, class ValIter>
+            void insert(CooIter coo_begin, CooIter coo_end, ValIter val_begin,
+                    std::map<size_t, real> &change)
+            {
+                std::vector<size_t> cells;
 
-                        assert(idx < delta.size());
+                for(; coo_begin != coo_end; ++coo_begin, ++val_begin)
+                    scatter(*coo_begin, *val_begin, delta, omega, &cells);
 
-                        delta[idx] += w2 * phi;
-                        omega[idx] += w2;
-                    }
-                }
+                std::sort(cells.begin(), cells.end());
+                cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
 
-                phi.resize(omega.size());
+                for(auto i = cells.begin(); i != cells.end(); ++i) {
+                    real f = std::fabs(omega[*i]) < 1e-32 ? 0 : delta[*i] / omega[*i];
 
-                for(auto w = omega.begin(), d = delta.begin(), f = phi.begin();
-                        w != omega.end();
-                        ++w, ++d, ++f
-                   )
-                {
-                    if (std::fabs(*w) < 1e-32)
-                        *f = 0;
-                    else
-                        *f = (*d) / (*w);
+                    change[*i] += f - phi[*i];
+                    phi[*i] = f;
                 }
             }
 
@@ -435,50 +576,128 @@ BOOST_PP_REPEAT_FROM_TO(1, VEXCL_MAX_ARITY, VEXCL_FUNCALL_OPERATOR, ~)
                     CooIter coo_begin, CooIter coo_end, ValIter val_begin
                     ) const
             {
-                auto c = coo_begin;
-                auto v = val_begin;
+                const ptrdiff_t npts = coo_end - coo_begin;
 
                 real res = 0;
 
-                for(; c != coo_end; ++c, ++v) {
-                    *v -= (*this)(*c);
+#ifdef _OPENMP
+#  pragma omp parallel for reduction(+:res)
+#endif
+                for(ptrdiff_t j = 0; j < npts; ++j) {
+                    real v = (val_begin[j] -= (*this)(coo_begin[j]));
 
-                    res += (*v) * (*v);
+                    res += v * v;
                 }
 
                 return res;
             }
 
-            // Refine r and append it to the current control lattice.
-            void append_refined(const lattice &r) {
+            // Refine values given on lattice r and add them to out.
+            void refine(const lattice &r, const std::vector<real> &in,
+                    std::vector<real> &out) const
+            {
                 static const std::array<real, 5> s = {{
                     0.125, 0.500, 0.750, 0.500, 0.125
                 }};
 
-                for(detail::dcounter<NDIM> i(r.n); i.valid(); ++i) {
-                    real f = r.phi[i];
+                // Every point of the fine lattice gathers contributions of
+                // the coarse points i with 2 * i + d - 3 = j, so that the
+                // points may be processed independently.
+#ifdef _OPENMP
+#  pragma omp parallel for
+#endif
+                for(ptrdiff_t idx = 0; idx < static_cast<ptrdiff_t>(out.size()); ++idx) {
+                    index j;
+                    for(size_t k = 0, m = idx; k < NDIM; ++k) {
+                        j[k] = m / stride[k];
+                        m   %= stride[k];
+                    }
+
+                    real f = 0;
+
                     for(detail::scounter<5, NDIM> d; d.valid(); ++d) {
-                        index j;
                         bool skip = false;
-                        size_t idx = 0;
+                        size_t src = 0;
+                        real   c   = 1;
+
                         for(size_t k = 0; k < NDIM; ++k) {
-                            j[k] = 2 * i[k] + d[k] - 3;
-                            if (j[k] >= n[k]) { skip = true; break; }
+                            size_t t = j[k] + 3 - d[k];
+                            if (t % 2 || t / 2 >= r.n[k]) { skip = true; break; }
 
-                            idx += j[k] * stride[k];
+                            src += (t / 2) * r.stride[k];
+                            c   *= s[d[k]];
                         }
 
-                        if (skip) continue;
+                        if (!skip) f += in[src] * c;
+                    }
 
-                        real c = 1;
-                        for(size_t k = 0; k < NDIM; ++k) c *= s[d[k]];
+                    out[idx] += f;
+                }
+            }
 
-                        phi[idx] += f * c;
-                    }
+            // x is within [xmin, xmax].
+            static bool contained(
+                    const point &xmin, const point &xmax, const point &x)
+            {
+                for(size_t d = 0; d < NDIM; ++d) {
+                    static const real eps = 1e-12;
+
+                    if (x[d] - eps <  xmin[d]) return false;
+                    if (x[d] + eps >= xmax[d]) return false;
                 }
+
+                return true;
             }
 
             private:
+                // Scatter B-spline weights of a data point into the
+                // accumulators.
+                void scatter(const point &p, real v,
+                        std::vector<real> &delta, std::vector<real> &omega,
+                        std::vector<size_t> *cells = 0) const
+                {
+                    index i;
+                    point s;
+
+                    for(size_t d = 0; d < NDIM; ++d) {
+                        real u = (p[d] - xmin[d]) * hinv[d];
+                        i[d] = static_cast<size_t>(std::floor(u) - 1);
+                        s[d] = u - std::floor(u);
+                    }
+
+                    std::array<real, detail::power<4, NDIM>::value> w;
+                    real sw2 = 0;
+
+                    for(detail::scounter<4, NDIM> d; d.valid(); ++d) {
+                        real buf = 1;
+                        for(size_t k = 0; k < NDIM; ++k)
+                            buf *= B(d[k], s[k]);
+
+                        w[d] = buf;
+                        sw2 += buf * buf;
+                    }
+
+                    for(detail::scounter<4, NDIM> d; d.valid(); ++d) {
+                        real phi = v * w[d] / sw2;
+
+                        size_t idx = 0;
+                        for(size_t k = 0; k < NDIM; ++k) {
+                            assert(i[k] + d[k] < n[k]);
+
+                            idx += (i[k] + d[k]) * stride[k];
+                        }
+
+                        real w2 = w[d] * w[d];
+
+                        assert(idx < delta.size());
+
+                        delta[idx] += w2 * phi;
+                        omega[idx] += w2;
+
+                        if (cells) cells->push_back(idx);
+                    }
+                }
+
                 // Value of k-th B-Spline at t.
                 static inline real B(size_t k, real t) {
                     assert(0 <= t && t < 1);
@@ -498,20 +717,6 @@ BOOST_PP_REPEAT_FROM_TO(1, VEXCL_MAX_ARITY, VEXCL_FUNCALL_OPERATOR, ~)
                     }
                 }
 
-                // x is within [xmin, xmax].
-                static bool contained(
-                        const point &xmin, const point &xmax, const point &x)
-                {
-                    for(size_t d = 0; d < NDIM; ++d) {
-                        static const real eps = 1e-12;
-
-                        if (x[d] - eps <  xmin[d]) return false;
-                        if (x[d] + eps >= xmax[d]) return false;
-                    }
-
-                    return true;
-                }
-
                 // Get value of phi at index (i + d).
                 template <class Shift>
                 inline real get(const index &i, const Shift &d) const {
@@ -527,6 +732,14 @@ BOOST_PP_REPEAT_FROM_TO(1, VEXCL_MAX_ARITY, VEXCL_FUNCALL_OPERATOR, ~)
                     return phi[idx];
                 }
         };
+
+        // Bounding box.
+        point cmin, cmax;
+
+        // Control lattices of each level and their combined values. Empty
+        // unless the object is appendable.
+        std::vector<lattice> hierarchy;
+        std::vector<real>    host;
 };
 
 /// \cond INTERNAL
@@ -340,6 +340,37 @@ class profiler {
             root->print(out, 0, length, root->max_line_width(0));
         }
 
+        /// Outputs device memory usage for each of the profiled queues.
+        /**
+         * Shows memory currently allocated by VexCL, its high-water mark,
+         * and the breakdown by owner (see vex::memory_owner).
+         */
+        void print_memory(std::ostream &out) const {
+            using namespace std;
+            boost::io::ios_all_saver stream_state(out);
+
+            const double mb = 1024.0 * 1024.0;
+
+            out << endl;
+            for(unsigned d = 0; d < queue.size(); ++d) {
+                device_memory_usage u = backend::memory_usage(queue[d]);
+
+                out << d + 1 << ". " << queue[d] << endl;
+                out << fixed << setprecision(2)
+                    << "  " << setw(12) << left << "total" << right
+                    << setw(10) << u.bytes / mb << " MB (peak: "
+                    << setw(10) << u.peak  / mb << " MB; "
+                    << setw(6) << u.buffers << " buffers)" << endl;
+
+                for(auto o = u.owners.begin(); o != u.owners.end(); ++o) {
+                    out << "  " << setw(12) << left << o->first << right
+                        << setw(10) << o->second.bytes / mb << " MB (peak: "
+                        << setw(10) << o->second.peak  / mb << " MB; "
+                        << setw(6) << o->second.buffers << " buffers)" << endl;
+                }
+            }
+        }
+
     private:
         const std::vector<backend::command_queue> &queue;
         std::deque<std::shared_ptr<profile_unit>> stack;
@@ -0,0 +1,249 @@
+#ifndef VEXCL_RECORD_VECTOR_HPP
+#define VEXCL_RECORD_VECTOR_HPP
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/record_vector.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Vectors of records with heterogeneous fields stored as structure of arrays.
+ */
+
+#include <tuple>
+#include <vector>
+
+#include <vexcl/operations.hpp>
+#include <vexcl/vector.hpp>
+#include <vexcl/vector_view.hpp>
+
+#ifdef BOOST_NO_VARIADIC_TEMPLATES
+#  error vex::record_vector requires variadic templates
+#endif
+
+namespace vex {
+
+/// \cond INTERNAL
+namespace detail {
+
+template <size_t... I>
+struct index_pack {};
+
+template <size_t N, size_t... I>
+struct make_index_pack : make_index_pack<N - 1, N - 1, I...> {};
+
+template <size_t... I>
+struct make_index_pack<0, I...> {
+    typedef index_pack<I...> type;
+};
+
+} // namespace detail
+/// \endcond
+
+/// Vector of records with heterogeneous fields.
+/**
+ * Each field is stored in its own vex::vector, so that the records are laid
+ * out as a structure of arrays on every device. All fields share the queue
+ * list and the partitioning. Fields are usual vector expression terminals,
+ * and whole-record operations are done with a single fused kernel:
+ \code
+ // position, velocity, mass, id:
+ vex::record_vector<cl_float4, cl_float4, float, int> p(ctx, n);
+
+ auto &x = p.field<0>();
+ auto &v = p.field<1>();
+
+ x += dt * v;
+
+ // Reorder whole records:
+ q = p.permuted(order);
+
+ // Sort whole records by key:
+ vex::sort_by_key(keys, p.fields(), vex::less<int>());
+ \endcode
+ */
+template <class... T>
+class record_vector {
+    public:
+        typedef std::tuple<T...> value_type;
+
+        /// Number of fields in a record.
+        static const size_t NFIELDS = sizeof...(T);
+
+        /// Type of the I-th field.
+        template <size_t I>
+        struct field_type {
+            typedef typename std::tuple_element<I, value_type>::type type;
+        };
+
+        /// Empty constructor.
+        record_vector() {}
+
+        /// Creates vector of the given size.
+        record_vector(const std::vector<backend::command_queue> &queue, size_t size)
+            : data(vector<T>(queue, size)...)
+        {}
+
+        /// Copy constructor.
+        record_vector(const record_vector &r)
+            : data(vector<T>(r.queue_list(), r.size())...)
+        {
+            *this = r;
+        }
+
+        /// Move constructor.
+        record_vector(record_vector &&r) noexcept : data(std::move(r.data)) {}
+
+        /// Move assignment.
+        const record_vector& operator=(record_vector &&r) {
+            data = std::move(r.data);
+            return *this;
+        }
+
+        /// Copies all fields of the other vector with a single kernel.
+        const record_vector& operator=(const record_vector &r) {
+            tie(typename detail::make_index_pack<sizeof...(T)>::type()) = r.fields();
+            return *this;
+        }
+
+        /// Assigns tuple of vector expressions to the fields with a single kernel.
+        template <class Tuple>
+        typename std::enable_if<
+            is_tuple<Tuple>::value &&
+            std::tuple_size<Tuple>::value == sizeof...(T),
+            const record_vector&
+        >::type
+        operator=(const Tuple &rhs) {
+            tie(typename detail::make_index_pack<sizeof...(T)>::type()) = rhs;
+            return *this;
+        }
+
+        /// Resizes all fields.
+        void resize(const std::vector<backend::command_queue> &queue, size_t size) {
+            resize(queue, size, typename detail::make_index_pack<sizeof...(T)>::type());
+        }
+
+        /// Number of records.
+        size_t size() const { return std::get<0>(data).size(); }
+
+        /// Number of devices the vector spans.
+        size_t nparts() const { return std::get<0>(data).nparts(); }
+
+        /// Number of records located on the given device.
+        size_t part_size(unsigned d) const { return std::get<0>(data).part_size(d); }
+
+        /// Index of the first record located on the given device.
+        size_t part_start(unsigned d) const { return std::get<0>(data).part_start(d); }
+
+        const std::vector<backend::command_queue>& queue_list() const {
+            return std::get<0>(data).queue_list();
+        }
+
+        const std::vector<size_t>& partition() const {
+            return std::get<0>(data).partition();
+        }
+
+        /// Vector holding the I-th field of the records.
+        template <size_t I>
+        vector<typename field_type<I>::type>& field() {
+            return std::get<I>(data);
+        }
+
+        /// Vector holding the I-th field of the records.
+        template <size_t I>
+        const vector<typename field_type<I>::type>& field() const {
+            return std::get<I>(data);
+        }
+
+        /// Tuple of references to the field vectors.
+        /**
+         * The tuple may be passed to vex::sort_by_key() as values in order to
+         * sort whole records, or used on the right hand side of assignment
+         * to another record vector.
+         */
+        std::tuple<vector<T>&...> fields() {
+            return fields(typename detail::make_index_pack<sizeof...(T)>::type());
+        }
+
+        /// Tuple of references to the field vectors.
+        std::tuple<const vector<T>&...> fields() const {
+            return fields(typename detail::make_index_pack<sizeof...(T)>::type());
+        }
+
+        /// Fields of the records permuted with the given index expression.
+        /**
+         * The I-th element of the result is the record at position idx[I].
+         * Assigning the result to another record vector gathers the records
+         * with a single kernel. The same restrictions as for
+         * vex::permutation() apply.
+         */
+        template <class Expr>
+        std::tuple<
+            decltype(vex::permutation(std::declval<const Expr&>())(std::declval<const vector<T>&>()))...
+            >
+        permuted(const Expr &idx) const {
+            return permuted(vex::permutation(idx),
+                    typename detail::make_index_pack<sizeof...(T)>::type());
+        }
+    private:
+        std::tuple<vector<T>...> data;
+
+        template <size_t... I>
+        void resize(const std::vector<backend::command_queue> &queue, size_t size,
+                detail::index_pack<I...>)
+        {
+            int dummy[] = {0, (std::get<I>(data).resize(queue, size), 0)...};
+            (void)dummy;
+        }
+
+        // Assignment target for all fields, so only available to the
+        // non-const assignment operators.
+        template <size_t... I>
+        expression_tuple< std::tuple<const vector<T>&...> >
+        tie(detail::index_pack<I...>) {
+            return vex::tie(std::get<I>(data)...);
+        }
+
+        template <size_t... I>
+        std::tuple<vector<T>&...> fields(detail::index_pack<I...>) {
+            return std::tuple<vector<T>&...>(std::get<I>(data)...);
+        }
+
+        template <size_t... I>
+        std::tuple<const vector<T>&...> fields(detail::index_pack<I...>) const {
+            return std::tuple<const vector<T>&...>(std::get<I>(data)...);
+        }
+
+        template <class Perm, size_t... I>
+        std::tuple<
+            decltype(std::declval<const Perm&>()(std::declval<const vector<T>&>()))...
+            >
+        permuted(const Perm &perm, detail::index_pack<I...>) const {
+            return std::make_tuple(perm(std::get<I>(data))...);
+        }
+};
+
+} // namespace vex
+
+#endif
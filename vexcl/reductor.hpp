@@ -191,6 +191,8 @@ template <typename real, class RDC>
 Reductor<real,RDC>::Reductor(const std::vector<backend::command_queue> &queue)
     : queue(queue)
 {
+    memory_owner owner("Reductor");
+
     idx.reserve(queue.size() + 1);
     idx.push_back(0);
 
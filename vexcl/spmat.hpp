@@ -77,23 +77,26 @@ class SpMat {
         SpMat(const std::vector<backend::command_queue> &queue,
               size_t n, size_t m, const idx_t *row, const col_t *col, const val_t *val
               )
-            : queue(queue), part(partition(n, queue)),
+            : queue(queue), part(partition(n, queue)), col_part(partition(m, queue)),
               mtx(queue.size()), exc(queue.size()),
               nrows(n), ncols(m), nnz(row[n])
         {
-            auto col_part = partition(m, queue);
+            memory_owner owner("SpMat");
 
             // Create secondary queues.
             for(auto q = queue.begin(); q != queue.end(); q++)
                 squeue.push_back(backend::duplicate_queue(*q));
 
-            std::vector<std::set<col_t>> ghost_cols = setup_exchange(col_part, row, col);
+            std::vector<std::set<col_t>> ghost_cols = setup_exchange(row, col);
 
             // Each device get it's own strip of the matrix.
 #ifdef _OPENMP
 #  pragma omp parallel for schedule(static,1)
 #endif
             for(int d = 0; d < static_cast<int>(queue.size()); d++) {
+                // The owner tag is thread-local.
+                memory_owner owner("SpMat");
+
                 if (part[d + 1] > part[d]) {
                     if ( backend::is_cpu(queue[d]) )
                         mtx[d].reset(
@@ -192,6 +195,103 @@ class SpMat {
             }
         }
 
+        /// Transposed matrix-vector multiplication.
+        /**
+         * Computes \f$y = \alpha A^T x\f$ or \f$y += \alpha A^T x\f$
+         * without building the transposed matrix explicitly: each row of
+         * the matrix scatters its contribution into the output vector with
+         * atomic additions. Contributions to columns owned by other devices
+         * are accumulated in ghost buffers, sent back to their owners and
+         * added to the result there.
+         * \param x      input vector (size equal to number of rows).
+         * \param y      output vector (size equal to number of columns).
+         * \param alpha  coefficient in front of matrix-vector product
+         * \param append if set, matrix-vector product is appended to y.
+         *               Otherwise, y is replaced with matrix-vector product.
+         */
+        void apply_transposed(const vex::vector<val_t> &x, vex::vector<val_t> &y,
+                 scalar_type alpha = 1, bool append = false) const
+        {
+            using namespace detail;
+
+            if (rx.size()) {
+                // Compute contribution to ghost columns first, ...
+                for(unsigned d = 0; d < queue.size(); d++) {
+                    if (exc[d].cols_to_recv.size()) {
+                        backend::select_context(queue[d]);
+
+                        vex::vector<val_t> gval(queue[d], exc[d].rx);
+                        gval = 0;
+
+                        mtx[d]->mul_transposed_remote(x(d), exc[d].rx, alpha);
+                    }
+                }
+
+                for(unsigned d = 0; d < queue.size(); d++)
+                    if (exc[d].cols_to_recv.size()) queue[d].finish();
+            }
+
+            // ... then start computing contribution from local part of the matrix.
+            for(unsigned d = 0; d < queue.size(); d++) {
+                if (!y.part_size(d)) continue;
+
+                backend::select_context(queue[d]);
+
+                if (!append) {
+                    vex::vector<val_t> yloc(queue[d], y(d));
+                    yloc = 0;
+                }
+
+                if (mtx[d]) mtx[d]->mul_transposed_local(x(d), y(d), alpha);
+            }
+
+            if (rx.size()) {
+                // Meanwhile, get ghost contributions to host, ...
+                for(unsigned d = 0; d < queue.size(); d++) {
+                    if (exc[d].cols_to_recv.size()) {
+                        backend::select_context(squeue[d]);
+                        exc[d].rx.read(squeue[d], 0, exc[d].vals_to_recv.size(),
+                                exc[d].vals_to_recv.data());
+                    }
+                }
+
+                for(unsigned d = 0; d < queue.size(); d++)
+                    if (exc[d].cols_to_recv.size()) squeue[d].finish();
+
+                // ... sum contributions to each ghost column, ...
+                std::fill(rx.begin(), rx.end(), val_t());
+
+                for(unsigned d = 0; d < queue.size(); d++)
+                    for(size_t i = 0; i < exc[d].cols_to_recv.size(); i++)
+                        rx[exc[d].cols_to_recv[i]] += exc[d].vals_to_recv[i];
+
+                // ... send the sums to devices owning the columns, ...
+                for(unsigned d = 0; d < queue.size(); d++) {
+                    if (cidx[d + 1] > cidx[d]) {
+                        backend::select_context(squeue[d]);
+                        exc[d].vals_to_send.write(squeue[d], 0, cidx[d + 1] - cidx[d],
+                                &rx[cidx[d]]);
+                    }
+                }
+
+                for(unsigned d = 0; d < queue.size(); d++)
+                    if (cidx[d + 1] > cidx[d]) squeue[d].finish();
+
+                // ... and add them to the local part of the result.
+                for(unsigned d = 0; d < queue.size(); d++) {
+                    if (cidx[d + 1] > cidx[d]) {
+                        backend::select_context(queue[d]);
+
+                        vex::vector<col_t> cols(queue[d], exc[d].cols_to_send);
+                        vex::vector<val_t> vals(queue[d], exc[d].vals_to_send);
+                        vex::vector<val_t> yloc(queue[d], y(d));
+
+                        permutation(cols)(yloc) += vals;
+                    }
+                }
+            }
+        }
+
         /// Number of rows.
         size_t rows() const { return nrows; }
         /// Number of columns.
@@ -256,6 +356,18 @@ class SpMat {
                     scalar_type alpha
                     ) const = 0;
 
+            virtual void mul_transposed_local(
+                    const backend::device_vector<val_t> &x,
+                    backend::device_vector<val_t> &y,
+                    scalar_type alpha
+                    ) const = 0;
+
+            virtual void mul_transposed_remote(
+                    const backend::device_vector<val_t> &x,
+                    backend::device_vector<val_t> &y,
+                    scalar_type alpha
+                    ) const = 0;
+
 #if defined(VEXCL_BACKEND_OPENCL) || !defined(VEXCL_USE_CUSPARSE)
             virtual void setArgs(backend::kernel &kernel, unsigned part, const vector<val_t> &x) const = 0;
 #endif
@@ -278,12 +390,13 @@ class SpMat {
 
             backend::device_vector<col_t> cols_to_send;
             backend::device_vector<val_t> vals_to_send;
-            backend::device_vector<val_t> rx;
+            mutable backend::device_vector<val_t> rx;
         };
 
         const std::vector<backend::command_queue> queue;
         std::vector<backend::command_queue>       squeue;
         const std::vector<size_t>           part;
+        const std::vector<size_t>           col_part;
 
         std::vector< std::unique_ptr<sparse_matrix> > mtx;
 
@@ -296,11 +409,12 @@ class SpMat {
         size_t nnz;
 
         std::vector<std::set<col_t>> setup_exchange(
-                const std::vector<size_t> &col_part,
                 const idx_t *row, const col_t *col
                 )
         {
-            auto is_local = [col_part](size_t c, int part) {
+            const std::vector<size_t> &col_part = this->col_part;
+
+            auto is_local = [&col_part](size_t c, int part) {
                 return c >= col_part[part] && c < col_part[part + 1];
             };
 
@@ -342,8 +456,7 @@ class SpMat {
                         exc[d].cols_to_recv.resize(rcols);
                         exc[d].vals_to_recv.resize(rcols);
 
-                        exc[d].rx = backend::device_vector<val_t>(queue[d], rcols,
-                                static_cast<const val_t*>(0), backend::MEM_READ_ONLY);
+                        exc[d].rx = backend::device_vector<val_t>(queue[d], rcols);
 
                         for(size_t i = 0, j = 0; i < cols_to_send.size(); i++)
                             if (ghost_cols[d].count(cols_to_send[i]))
@@ -406,6 +519,62 @@ operator*(const SpMat<val_t, col_t, idx_t> &A, const V &x) {
 }
 #endif
 
+template <typename val_t, typename col_t, typename idx_t>
+struct SpMatTransposed {
+    typedef val_t value_type;
+    typedef typename SpMat<val_t, col_t, idx_t>::scalar_type scalar_type;
+
+    const SpMat<val_t, col_t, idx_t> &A;
+
+    SpMatTransposed(const SpMat<val_t, col_t, idx_t> &A) : A(A) {}
+
+    void apply(const vex::vector<val_t> &x, vex::vector<val_t> &y,
+            scalar_type alpha = 1, bool append = false) const
+    {
+        A.apply_transposed(x, y, alpha, append);
+    }
+};
+
+/// \endcond
+
+/// Transposed view of a sparse matrix.
+/**
+ * Allows to compute products with transposed matrix without storing the
+ * transposed matrix explicitly. The returned object references the original
+ * matrix and should only be used inside a single expression.
+ *
+ * Example:
+ \code
+ y = vex::transpose(A) * x;
+ \endcode
+ */
+template <typename val_t, typename col_t, typename idx_t>
+SpMatTransposed<val_t, col_t, idx_t>
+transpose(const SpMat<val_t, col_t, idx_t> &A) {
+    return SpMatTransposed<val_t, col_t, idx_t>(A);
+}
+
+/// \cond INTERNAL
+
+template <typename val_t, typename col_t, typename idx_t>
+additive_operator< SpMatTransposed<val_t, col_t, idx_t>, vector<val_t> >
+operator*(const SpMatTransposed<val_t, col_t, idx_t> &A, const vector<val_t> &x)
+{
+    return additive_operator< SpMatTransposed<val_t, col_t, idx_t>, vector<val_t> >(A, x);
+}
+
+#ifdef VEXCL_MULTIVECTOR_HPP
+template <typename val_t, typename col_t, typename idx_t, class V>
+typename std::enable_if<
+    std::is_base_of<multivector_terminal_expression, V>::value &&
+    std::is_same<val_t, typename V::sub_value_type>::value,
+    multiadditive_operator< SpMatTransposed<val_t, col_t, idx_t>, V >
+>::type
+operator*(const SpMatTransposed<val_t, col_t, idx_t> &A, const V &x) {
+    return multiadditive_operator< SpMatTransposed<val_t, col_t, idx_t>, V >(A, x);
+}
+#endif
+
 /// \endcond
 
 /// Weights device wrt to additive_operator performance.
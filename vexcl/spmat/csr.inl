@@ -67,6 +67,9 @@ struct SpMatCSR : public sparse_matrix {
                 if (*row_begin > 0) vector<idx_t>(queue, loc.row) -= *row_begin;
             }
         } else {
+            loc.nnz = 0;
+            rem.nnz = 0;
+
             std::vector<idx_t> lrow;
             std::vector<col_t> lcol;
             std::vector<val_t> lval;
@@ -186,6 +189,78 @@ struct SpMatCSR : public sparse_matrix {
         kernel->second(queue);
     }
 
+    // Transposed product. Each row scatters its contribution into the output
+    // vector with atomic additions, so out should be initialized.
+    void mul_transposed(const matrix_part &part,
+            const backend::device_vector<val_t> &in,
+            backend::device_vector<val_t> &out,
+            scalar_type scale
+            ) const
+    {
+        using namespace detail;
+
+        static kernel_cache cache;
+
+        auto key    = backend::cache_key(queue);
+        auto kernel = cache.find(key);
+
+        backend::select_context(queue);
+
+        if (kernel == cache.end()) {
+            backend::source_generator source(queue);
+
+            source.template atomic_add_function<val_t>("atomic_add_val");
+
+            source.kernel("csr_spmv_t")
+                .open("(")
+                    .template parameter<size_t>("n")
+                    .template parameter<scalar_type>("scale")
+                    .template parameter< global_ptr< const idx_t > >("row")
+                    .template parameter< global_ptr< const col_t > >("col")
+                    .template parameter< global_ptr< const val_t > >("val")
+                    .template parameter< global_ptr< const val_t > >("in")
+                    .template parameter< global_ptr< val_t > >("out")
+                .close(")")
+                .open("{")
+                    .grid_stride_loop("i").open("{");
+            source.new_line() << type_name<val_t>() << " x = scale * in[i];";
+            source.new_line() << "for(size_t j = row[i], e = row[i + 1]; j < e; ++j)";
+            source.open("{");
+            source.new_line() << "atomic_add_val(out + col[j], val[j] * x);";
+            source.close("}");
+            source.close("}").close("}");
+
+            backend::kernel krn(queue, source.str(), "csr_spmv_t");
+            kernel = cache.insert(std::make_pair(key, krn)).first;
+        }
+
+        kernel->second.push_arg(n);
+        kernel->second.push_arg(scale);
+        kernel->second.push_arg(part.row);
+        kernel->second.push_arg(part.col);
+        kernel->second.push_arg(part.val);
+        kernel->second.push_arg(in);
+        kernel->second.push_arg(out);
+
+        kernel->second(queue);
+    }
+
+    void mul_transposed_local(
+            const backend::device_vector<val_t> &in,
+            backend::device_vector<val_t> &out,
+            scalar_type scale) const
+    {
+        if (loc.nnz) mul_transposed(loc, in, out, scale);
+    }
+
+    void mul_transposed_remote(
+            const backend::device_vector<val_t> &in,
+            backend::device_vector<val_t> &out,
+            scalar_type scale) const
+    {
+        if (rem.nnz) mul_transposed(rem, in, out, scale);
+    }
+
     void mul_local(
             const backend::device_vector<val_t> &in,
             backend::device_vector<val_t> &out,
@@ -301,6 +301,93 @@ struct SpMatHELL : public sparse_matrix {
         kernel->second(queue);
     }
 
+    // Transposed product. Each row scatters its contribution into the output
+    // vector with atomic additions, so out should be initialized.
+    void mul_transposed(
+            const matrix_part &part,
+            const backend::device_vector<val_t> &in,
+            backend::device_vector<val_t> &out,
+            scalar_type scale
+            ) const
+    {
+        using namespace detail;
+
+        static kernel_cache cache;
+
+        auto key    = backend::cache_key(queue);
+        auto kernel = cache.find(key);
+
+        backend::select_context(queue);
+
+        if (kernel == cache.end()) {
+            backend::source_generator source(queue);
+
+            source.template atomic_add_function<val_t>("atomic_add_val");
+
+            source.kernel("hybrid_ell_spmv_t")
+                .open("(")
+                    .template parameter<size_t>("n")
+                    .template parameter<scalar_type>("scale")
+                    .template parameter<size_t>("ell_w")
+                    .template parameter<size_t>("ell_pitch")
+                    .template parameter< global_ptr<const col_t> >("ell_col")
+                    .template parameter< global_ptr<const val_t> >("ell_val")
+                    .template parameter< global_ptr<const idx_t> >("csr_row")
+                    .template parameter< global_ptr<const col_t> >("csr_col")
+                    .template parameter< global_ptr<const val_t> >("csr_val")
+                    .template parameter< global_ptr<const val_t> >("in")
+                    .template parameter< global_ptr<val_t> >("out")
+                .close(")")
+                .open("{")
+                    .grid_stride_loop("i").open("{");
+
+            source.new_line() << type_name<val_t>() << " x = scale * in[i];";
+            source.new_line() << "for(size_t j = 0; j < ell_w; ++j)";
+            source.open("{");
+            source.new_line() << type_name<col_t>() << " c = ell_col[i + j * ell_pitch];";
+            source.new_line() << "if (c != ("<< type_name<col_t>() << ")(-1))";
+            source.open("{").new_line() << "atomic_add_val(out + c, ell_val[i + j * ell_pitch] * x);";
+            source.close("}").close("}");
+            source.new_line() << "if (csr_row)";
+            source.open("{");
+            source.new_line() << "for(size_t j = csr_row[i], e = csr_row[i + 1]; j < e; ++j)";
+            source.open("{");
+            source.new_line() << "atomic_add_val(out + csr_col[j], csr_val[j] * x);";
+            source.close("}").close("}");
+            source.close("}").close("}");
+
+            backend::kernel krn(queue, source.str(), "hybrid_ell_spmv_t");
+            kernel = cache.insert(std::make_pair(key, krn)).first;
+        }
+
+        kernel->second.push_arg(n);
+        kernel->second.push_arg(scale);
+        kernel->second.push_arg(part.ell.width);
+        kernel->second.push_arg(pitch);
+
+        if (part.ell.width) {
+            kernel->second.push_arg(part.ell.col);
+            kernel->second.push_arg(part.ell.val);
+        } else {
+            kernel->second.push_arg(static_cast<void*>(0));
+            kernel->second.push_arg(static_cast<void*>(0));
+        }
+
+        if (part.csr.nnz) {
+            kernel->second.push_arg(part.csr.row);
+            kernel->second.push_arg(part.csr.col);
+            kernel->second.push_arg(part.csr.val);
+        } else {
+            kernel->second.push_arg(static_cast<void*>(0));
+            kernel->second.push_arg(static_cast<void*>(0));
+            kernel->second.push_arg(static_cast<void*>(0));
+        }
+        kernel->second.push_arg(in);
+        kernel->second.push_arg(out);
+
+        kernel->second(queue);
+    }
+
     void mul_local(
             const backend::device_vector<val_t> &in,
             backend::device_vector<val_t> &out,
@@ -320,6 +407,24 @@ struct SpMatHELL : public sparse_matrix {
         mul<assign::ADD>(rem, in, out, scale);
     }
 
+    void mul_transposed_local(
+            const backend::device_vector<val_t> &in,
+            backend::device_vector<val_t> &out,
+            scalar_type scale) const
+    {
+        if (loc.ell.width || loc.csr.nnz)
+            mul_transposed(loc, in, out, scale);
+    }
+
+    void mul_transposed_remote(
+            const backend::device_vector<val_t> &in,
+            backend::device_vector<val_t> &out,
+            scalar_type scale) const
+    {
+        if (rem.ell.width || rem.csr.nnz)
+            mul_transposed(rem, in, out, scale);
+    }
+
     static void inline_preamble(backend::source_generator &src,
         const std::string &prm_name)
     {
@@ -32,6 +32,7 @@ THE SOFTWARE.
  */
 
 #include <vector>
+#include <array>
 #include <map>
 #include <sstream>
 #include <cassert>
@@ -48,9 +49,36 @@ class stencil_base {
                 unsigned width, unsigned center, Iterator begin, Iterator end
                 );
 
-        void exchange_halos(const vex::vector<T> &x) const;
+        void exchange_halos(const vex::vector<T> &x) const {
+            start_exchange(x);
+            finish_exchange();
+        }
+
+        void exchange_halos(const vex::vector<T> &x, int lhalo, int rhalo,
+                std::vector<T> &hbuf,
+                const std::vector< backend::device_vector<T> > &dbuf) const
+        {
+            start_exchange(x, lhalo, rhalo, hbuf, dbuf);
+            finish_exchange();
+        }
+
+        // Starts halo exchange. When each halo is owned by the nearest
+        // neighbour, halos are copied between device buffers on secondary
+        // queues, and the caller may process the interior points before
+        // calling finish_exchange().
+        void start_exchange(const vex::vector<T> &x) const {
+            start_exchange(x, lhalo, rhalo, hbuf, dbuf);
+        }
+
+        void start_exchange(const vex::vector<T> &x, int lhalo, int rhalo,
+                std::vector<T> &hbuf,
+                const std::vector< backend::device_vector<T> > &dbuf) const;
+
+        // Waits until the halos are in place.
+        void finish_exchange() const;
 
         const std::vector<backend::command_queue> &queue;
+        std::vector<backend::command_queue> squeue;
 
         mutable std::vector<T>  hbuf;
         std::vector< backend::device_vector<T> > dbuf;
@@ -58,6 +86,26 @@ class stencil_base {
 
         int lhalo;
         int rhalo;
+    private:
+        // Halo parts staged through host memory that still have to be
+        // written to the device.
+        struct staged_halo {
+            const backend::device_vector<T> *dbuf;
+            unsigned device;
+            size_t   offset;
+            size_t   size;
+            const T *host;
+        };
+
+        mutable std::vector<staged_halo> staged;
+
+        void copy_halo(const vex::vector<T> &x, unsigned dst, unsigned src,
+                size_t src_offset, size_t dst_offset, size_t size,
+                T *host, const backend::device_vector<T> &dbuf) const;
+
+        void exchange_halos_host(const vex::vector<T> &x, int lhalo, int rhalo,
+                std::vector<T> &hbuf,
+                const std::vector< backend::device_vector<T> > &dbuf) const;
 };
 
 template <typename T> template <class Iterator>
@@ -81,17 +129,92 @@ stencil_base<T>::stencil_base(
 
         // Allocate one element more than needed, to be sure size is nonzero.
         dbuf[d] = backend::device_vector<T>(queue[d], width);
+
+        // Secondary queues are used for halo transfers.
+        if (queue.size() > 1)
+            squeue.push_back(backend::duplicate_queue(queue[d]));
     }
 
     for(unsigned d = 0; d < queue.size(); d++) queue[d].finish();
 }
 
 template <typename T>
-void stencil_base<T>::exchange_halos(const vex::vector<T> &x) const {
+void stencil_base<T>::start_exchange(const vex::vector<T> &x,
+        int lhalo, int rhalo, std::vector<T> &hbuf,
+        const std::vector< backend::device_vector<T> > &dbuf) const
+{
     int width = lhalo + rhalo;
 
+    staged.clear();
+
     if ((queue.size() <= 1) || (width <= 0)) return;
 
+    // Halos that span several devices are exchanged through the host.
+    for(unsigned d = 0; d < queue.size(); d++) {
+        if (!x.part_size(d)) continue;
+
+        if (
+                (d > 0 && x.part_size(d - 1) < static_cast<size_t>(lhalo)) ||
+                (d + 1 < queue.size() && x.part_size(d + 1) < static_cast<size_t>(rhalo))
+           )
+        {
+            exchange_halos_host(x, lhalo, rhalo, hbuf, dbuf);
+            return;
+        }
+    }
+
+    // Make sure the input vector is ready.
+    for(unsigned d = 0; d < queue.size(); d++) queue[d].finish();
+
+    for(unsigned d = 0; d < queue.size(); d++) {
+        if (!x.part_size(d)) continue;
+
+        if (d > 0 && lhalo > 0)
+            copy_halo(x, d, d - 1, x.part_size(d - 1) - lhalo, 0, lhalo,
+                    &hbuf[d * width], dbuf[d]);
+
+        if (d + 1 < queue.size() && rhalo > 0)
+            copy_halo(x, d, d + 1, 0, lhalo, rhalo,
+                    &hbuf[d * width + lhalo], dbuf[d]);
+    }
+}
+
+template <typename T>
+void stencil_base<T>::copy_halo(const vex::vector<T> &x, unsigned dst, unsigned src,
+        size_t src_offset, size_t dst_offset, size_t size,
+        T *host, const backend::device_vector<T> &dbuf) const
+{
+    if (backend::cache_key(queue[dst]) == backend::cache_key(queue[src])) {
+        dbuf.copy_from(squeue[dst], x(src), src_offset, dst_offset, size);
+    } else {
+        x(src).read(squeue[src], src_offset, size, host, false);
+
+        staged_halo h = {&dbuf, dst, dst_offset, size, host};
+        staged.push_back(h);
+    }
+}
+
+template <typename T>
+void stencil_base<T>::finish_exchange() const {
+    for(unsigned d = 0; d < squeue.size(); d++) squeue[d].finish();
+
+    if (staged.empty()) return;
+
+    for(auto h = staged.begin(); h != staged.end(); ++h)
+        h->dbuf->write(squeue[h->device], h->offset, h->size, h->host);
+
+    for(unsigned d = 0; d < squeue.size(); d++) squeue[d].finish();
+
+    staged.clear();
+}
+
+template <typename T>
+void stencil_base<T>::exchange_halos_host(const vex::vector<T> &x,
+        int lhalo, int rhalo, std::vector<T> &hbuf,
+        const std::vector< backend::device_vector<T> > &dbuf) const
+{
+    int width = lhalo + rhalo;
+
     // Get halos from neighbours.
     for(unsigned d = 0; d < queue.size(); d++) {
         if (!x.part_size(d)) continue;
@@ -165,6 +288,9 @@ void stencil_base<T>::exchange_halos(const vex::vector<T> &x) const {
  \endcode
  * Stencil should be small enough to fit into local memory of all compute
  * devices it resides on.
+ *
+ * A stencil keeps its kernels and halo buffers between applications, so a
+ * single stencil object should not be applied from several threads at once.
  */
 template <typename T>
 class stencil : private stencil_base<T> {
@@ -234,6 +360,26 @@ class stencil : private stencil_base<T> {
          */
         void apply(const vex::vector<T> &x, vex::vector<T> &y,
                 T alpha = 1, bool append = false) const;
+
+        /// Apply the stencil several times in a row.
+        /**
+         * y = alpha * conv^steps(x) + y;
+         * Each workgroup loads its part of the input together with halos
+         * that are \p steps times wider than the stencil halos, and does all
+         * of the steps in local memory. This reduces global memory traffic
+         * and the number of halo exchanges between devices. When local memory
+         * is insufficient, falls back to a sequence of single applications.
+         * The setup for each distinct number of steps is kept for reuse; the
+         * halo buffers are allocated per call.
+         * \param x input vector.
+         * \param y output vector.
+         * \param steps number of stencil applications.
+         * \param alpha Scaling coefficient in front of y.
+         * \param append whether to append the result to the output vector
+         *               (alternative is to replace the output vector).
+         */
+        void apply_repeated(const vex::vector<T> &x, vex::vector<T> &y,
+                unsigned steps, T alpha = 1, bool append = false) const;
     private:
         typedef stencil_base<T> Base;
 
@@ -247,10 +393,28 @@ class stencil : private stencil_base<T> {
         mutable std::vector<backend::kernel> conv;
         std::vector<size_t>  smem;
 
+        // Temporal blocking setup for a given number of steps.
+        struct repeated_setup {
+            bool fast;
+            std::vector<backend::kernel> conv;
+            std::vector<size_t> smem;
+
+            // Halos for all of the steps.
+            std::vector<T> hbuf;
+            std::vector< backend::device_vector<T> > halo;
+        };
+
+        mutable std::map<unsigned, repeated_setup> rsetup;
+
         void init(unsigned width);
+        repeated_setup& init_repeated(unsigned steps) const;
+
+        void convolve(unsigned d, const vex::vector<T> &x, vex::vector<T> &y,
+                size_t begin, size_t end, T alpha, T beta) const;
 
         static const detail::kernel_cache_entry& slow_conv(const backend::command_queue &queue);
         static const detail::kernel_cache_entry& fast_conv(const backend::command_queue &queue);
+        static const detail::kernel_cache_entry& repeated_conv(const backend::command_queue &queue);
 };
 
 /// \cond INTERNAL
@@ -309,6 +473,8 @@ const detail::kernel_cache_entry& stencil<T>::slow_conv(const backend::command_q
         source.kernel("slow_conv")
             .open("(")
                 .template parameter<size_t>("n")
+                .template parameter<size_t>("begin")
+                .template parameter<size_t>("end")
                 .template parameter<char>("has_left")
                 .template parameter<char>("has_right")
                 .template parameter<int>("lhalo")
@@ -321,8 +487,9 @@ const detail::kernel_cache_entry& stencil<T>::slow_conv(const backend::command_q
                 .template parameter<T>("beta")
             .close(")").open("{");
 
-        source.grid_stride_loop().open("{");
+        source.grid_stride_loop("pos", "end - begin").open("{");
 
+        source.new_line() << type_name<size_t>() << " idx = begin + pos;";
         source.new_line() << type_name<T>() << " sum = 0;";
         source.new_line() << "for(int j = -lhalo; j <= rhalo; j++)";
         source.open("{");
@@ -360,6 +527,8 @@ const detail::kernel_cache_entry& stencil<T>::fast_conv(const backend::command_q
         source.kernel("fast_conv")
             .open("(")
                 .template parameter<size_t>("n")
+                .template parameter<size_t>("begin")
+                .template parameter<size_t>("end")
                 .template parameter<char>("has_left")
                 .template parameter<char>("has_right")
                 .template parameter<int>("lhalo")
@@ -381,14 +550,14 @@ const detail::kernel_cache_entry& stencil<T>::fast_conv(const backend::command_q
         source.new_line() << "int l_id = " << source.local_id(0) << ";";
         source.new_line() << "int block_size = " << source.local_size(0) << ";";
         source.new_line() << "for(int i = l_id; i < rhalo + lhalo + 1; i += block_size) S[i] = s[i];";
-        source.new_line() << "for(long g_id = " << source.global_id(0) << ", pos = 0; pos < n; g_id += grid_size, pos += grid_size)";
+        source.new_line() << "for(long g_id = begin + " << source.global_id(0) << ", pos = begin; pos < end; g_id += grid_size, pos += grid_size)";
         source.open("{");
         source.new_line() << "for(int i = l_id, j = g_id - lhalo; i < block_size + lhalo + rhalo; i += block_size, j += block_size)";
         source.open("{");
         source.new_line() << "X[i] = read_x(j, n, has_left, has_right, lhalo, rhalo, xloc, xrem);";
         source.close("}");
         source.new_line().barrier();
-        source.new_line() << "if (g_id < n)";
+        source.new_line() << "if (g_id < end)";
         source.open("{");
         source.new_line() << type_name<T>() << " sum = 0;";
         source.new_line() << "for(int j = -lhalo; j <= rhalo; j++)";
@@ -429,40 +598,343 @@ void stencil<T>::init(unsigned width) {
     }
 }
 
+template <typename T>
+void stencil<T>::convolve(unsigned d, const vex::vector<T> &x, vex::vector<T> &y,
+        size_t begin, size_t end, T alpha, T beta) const
+{
+    char has_left  = d > 0;
+    char has_right = d + 1 < queue.size();
+
+    conv[d].push_arg(x.part_size(d));
+    conv[d].push_arg(begin);
+    conv[d].push_arg(end);
+    conv[d].push_arg(has_left);
+    conv[d].push_arg(has_right);
+    conv[d].push_arg(lhalo);
+    conv[d].push_arg(rhalo);
+    conv[d].push_arg(s[d]);
+    conv[d].push_arg(x(d));
+    conv[d].push_arg(dbuf[d]);
+    conv[d].push_arg(y(d));
+    conv[d].push_arg(beta);
+    conv[d].push_arg(alpha);
+
+    if (smem[d]) conv[d].set_smem([&](size_t){ return smem[d]; });
+
+    conv[d](queue[d]);
+}
+
 template <typename T>
 void stencil<T>::apply(const vex::vector<T> &x, vex::vector<T> &y,
         T alpha, bool append) const
 {
-    Base::exchange_halos(x);
+    Base::start_exchange(x);
 
     T beta = static_cast<T>(append ? 1 : 0);
 
+    // Interior points do not depend on halos and are processed while the
+    // halos are in flight.
+    std::vector<size_t> ibeg(queue.size()), iend(queue.size());
+
     for(unsigned d = 0; d < queue.size(); d++) {
         if (size_t psize = x.part_size(d)) {
-            char has_left  = d > 0;
-            char has_right = d + 1 < queue.size();
+            ibeg[d] = d > 0                ? std::min<size_t>(lhalo, psize)  : 0;
+            iend[d] = d + 1 < queue.size() ? psize - std::min<size_t>(rhalo, psize) : psize;
 
-            conv[d].push_arg(psize);
-            conv[d].push_arg(has_left);
-            conv[d].push_arg(has_right);
-            conv[d].push_arg(lhalo);
-            conv[d].push_arg(rhalo);
-            conv[d].push_arg(s[d]);
-            conv[d].push_arg(x(d));
-            conv[d].push_arg(dbuf[d]);
-            conv[d].push_arg(y(d));
-            conv[d].push_arg(beta);
-            conv[d].push_arg(alpha);
+            if (ibeg[d] < iend[d])
+                convolve(d, x, y, ibeg[d], iend[d], alpha, beta);
+        }
+    }
 
-            if (smem[d]) conv[d].set_smem([&](size_t){ return smem[d]; });
+    Base::finish_exchange();
 
-            conv[d](queue[d]);
+    for(unsigned d = 0; d < queue.size(); d++) {
+        if (size_t psize = x.part_size(d)) {
+            if (ibeg[d] >= iend[d]) {
+                convolve(d, x, y, 0, psize, alpha, beta);
+            } else {
+                if (ibeg[d] > 0)     convolve(d, x, y, 0, ibeg[d], alpha, beta);
+                if (iend[d] < psize) convolve(d, x, y, iend[d], psize, alpha, beta);
+            }
+        }
+    }
+}
+
+template <typename T>
+const detail::kernel_cache_entry& stencil<T>::repeated_conv(const backend::command_queue &queue) {
+    using namespace detail;
+
+    static kernel_cache cache;
+
+    auto key    = backend::cache_key(queue);
+    auto kernel = cache.find(key);
+
+    backend::select_context(queue);
+
+    if (kernel == cache.end()) {
+        backend::source_generator source(queue);
+
+        define_read_x<T>(source);
+
+        source.kernel("repeated_conv")
+            .open("(")
+                .template parameter<size_t>("n")
+                .template parameter<size_t>("start")
+                .template parameter<size_t>("total")
+                .template parameter<char>("has_left")
+                .template parameter<char>("has_right")
+                .template parameter<int>("lhalo")
+                .template parameter<int>("rhalo")
+                .template parameter<int>("steps")
+                .template parameter< global_ptr<const T> >("s")
+                .template parameter< global_ptr<const T> >("xloc")
+                .template parameter< global_ptr<const T> >("xrem")
+                .template parameter< global_ptr<T> >("y")
+                .template parameter<T>("alpha")
+                .template parameter<T>("beta")
+                .template smem_parameter< T >()
+            .close(")").open("{");
+
+        source.smem_declaration<T>();
+
+        source.new_line() << "size_t grid_size = " << source.global_size(0) << ";";
+        source.new_line() << "int l_id = " << source.local_id(0) << ";";
+        source.new_line() << "int block_size = " << source.local_size(0) << ";";
+
+        // The window holds the workgroup's outputs and the halos for all
+        // steps. The valid part of the window shrinks by the stencil halos
+        // after each step.
+        source.new_line() << "int wl = steps * lhalo;";
+        source.new_line() << "int wr = steps * rhalo;";
+        source.new_line() << "int m  = block_size + wl + wr;";
+        source.new_line() << type_name< shared_ptr<T> >() << " S = smem;";
+        source.new_line() << type_name< shared_ptr<T> >() << " X = smem + lhalo + rhalo + 1;";
+        source.new_line() << type_name< shared_ptr<T> >() << " Y = X + m;";
+
+        // Global boundaries in local coordinates.
+        source.new_line() << "long lo = -(long)start;";
+        source.new_line() << "long hi = (long)total - (long)start - 1;";
+
+        source.new_line() << "for(int i = l_id; i < rhalo + lhalo + 1; i += block_size) S[i] = s[i];";
+        source.new_line() << "for(long g0 = " << source.group_id(0) << " * (long)block_size; g0 < n; g0 += grid_size)";
+        source.open("{");
+        source.new_line() << "long base = g0 - wl;";
+        source.new_line() << "for(int i = l_id; i < m; i += block_size)";
+        source.open("{");
+        source.new_line() << "X[i] = read_x(base + i, n, has_left, has_right, wl, wr, xloc, xrem);";
+        source.close("}");
+        source.new_line().barrier();
+        source.new_line() << "for(int t = 1; t <= steps; ++t)";
+        source.open("{");
+        source.new_line() << "for(int i = t * lhalo + l_id; i < m - t * rhalo; i += block_size)";
+        source.open("{");
+        source.new_line() << type_name<T>() << " sum = 0;";
+        source.new_line() << "for(int j = -lhalo; j <= rhalo; j++)";
+        source.open("{");
+        source.new_line() << "long p = min(max(base + i + j, lo), hi) - base;";
+        source.new_line() << "sum += S[lhalo + j] * X[p];";
+        source.close("}");
+        source.new_line() << "Y[i] = sum;";
+        source.close("}");
+        source.new_line().barrier();
+        source.new_line() << type_name< shared_ptr<T> >() << " tmp = X; X = Y; Y = tmp;";
+        source.close("}");
+        source.new_line() << "long g_id = g0 + l_id;";
+        source.new_line() << "if (g_id < n)";
+        source.open("{");
+        source.new_line() << type_name<T>() << " sum = X[wl + l_id];";
+        source.new_line() << "if (alpha) y[g_id] = alpha * y[g_id] + beta * sum;";
+        source.new_line() << "else y[g_id] = beta * sum;";
+        source.close("}");
+        source.new_line().barrier();
+        source.close("}").close("}");
+
+        backend::kernel krn(queue, source.str(), "repeated_conv");
+        kernel = cache.insert(std::make_pair(key, krn)).first;
+    }
+
+    return kernel->second;
+}
+
+template <typename T>
+typename stencil<T>::repeated_setup&
+stencil<T>::init_repeated(unsigned steps) const {
+    auto r = rsetup.find(steps);
+    if (r != rsetup.end()) return r->second;
+
+    int width = lhalo + rhalo + 1;
+
+    auto smem_required = [width, steps](size_t wgs) {
+        return sizeof(T) * (width + 2 * (wgs + steps * (width - 1)));
+    };
+
+    repeated_setup &setup = rsetup[steps];
+    setup.fast = true;
+
+    for(unsigned d = 0; d < queue.size(); d++) {
+        auto krn = repeated_conv(queue[d]);
+
+        if (backend::is_cpu(queue[d]) ||
+                krn.max_shared_memory_per_block(queue[d]) < smem_required(64))
+        {
+            setup.fast = false;
+            setup.conv.clear();
+            setup.smem.clear();
+            break;
         }
+
+        setup.conv.push_back(krn);
+        setup.conv.back().config(queue[d], smem_required);
+        setup.smem.push_back(smem_required(setup.conv.back().workgroup_size()));
+    }
+
+    if (setup.fast && queue.size() > 1) {
+        int wl = steps * lhalo;
+        int wr = steps * rhalo;
+
+        setup.hbuf.resize(queue.size() * (wl + wr));
+
+        for(unsigned d = 0; d < queue.size(); d++)
+            setup.halo.push_back(backend::device_vector<T>(queue[d], wl + wr + 1));
     }
+
+    return setup;
 }
 
+template <typename T>
+void stencil<T>::apply_repeated(const vex::vector<T> &x, vex::vector<T> &y,
+        unsigned steps, T alpha, bool append) const
+{
+    precondition(steps > 0, "Number of stencil applications should be positive");
+
+    if (steps == 1) {
+        apply(x, y, alpha, append);
+        return;
+    }
+
+    repeated_setup &setup = init_repeated(steps);
+
+    if (!setup.fast) {
+        vex::vector<T> a(queue, x.size());
+        vex::vector<T> b;
+
+        apply(x, a);
+        for(unsigned i = 2; i < steps; ++i) {
+            if (b.size() != x.size()) b.resize(queue, x.size());
+            apply(a, b);
+            a.swap(b);
+        }
+        apply(a, y, alpha, append);
+        return;
+    }
+
+    if (queue.size() > 1) {
+        int wl = steps * lhalo;
+        int wr = steps * rhalo;
+
+        Base::exchange_halos(x, wl, wr, setup.hbuf, setup.halo);
+    }
+
+    T beta = static_cast<T>(append ? 1 : 0);
+    int nsteps = steps;
+
+    for(unsigned d = 0; d < queue.size(); d++) {
+        if (size_t psize = x.part_size(d)) {
+            size_t start = x.part_start(d);
+            size_t total = x.size();
+
+            char has_left  = d > 0;
+            char has_right = d + 1 < queue.size();
+
+            backend::kernel krn = setup.conv[d];
+
+            krn.push_arg(psize);
+            krn.push_arg(start);
+            krn.push_arg(total);
+            krn.push_arg(has_left);
+            krn.push_arg(has_right);
+            krn.push_arg(lhalo);
+            krn.push_arg(rhalo);
+            krn.push_arg(nsteps);
+            krn.push_arg(s[d]);
+            krn.push_arg(x(d));
+            krn.push_arg(queue.size() > 1 ? setup.halo[d] : dbuf[d]);
+            krn.push_arg(y(d));
+            krn.push_arg(beta);
+            krn.push_arg(alpha);
+
+            size_t smem = setup.smem[d];
+            krn.set_smem([smem](size_t){ return smem; });
+
+            krn(queue[d]);
+        }
+    }
+}
+
+/// Stencil applied several times in a row.
+template <typename T>
+struct stencil_repeated {
+    typedef T value_type;
+
+    const stencil<T> &S;
+    unsigned steps;
+
+    stencil_repeated(const stencil<T> &S, unsigned steps) : S(S), steps(steps) {}
+
+    void apply(const vex::vector<T> &x, vex::vector<T> &y,
+            T alpha = 1, bool append = false) const
+    {
+        S.apply_repeated(x, y, steps, alpha, append);
+    }
+};
+
 /// \endcond
 
+/// Stencil that is applied the given number of times.
+/**
+ * The returned object references the original stencil and should only be
+ * used inside a single expression:
+ \code
+ y = vex::repeat(S, 10) * x; // Same as ten consecutive applications of S.
+ \endcode
+ */
+template <typename T>
+stencil_repeated<T> repeat(const stencil<T> &S, unsigned steps) {
+    return stencil_repeated<T>(S, steps);
+}
+
+/// Convolve the repeated stencil with the vector.
+template <typename T>
+additive_operator< stencil_repeated<T>, vector<T> >
+operator*( const stencil_repeated<T> &s, const vector<T> &x ) {
+    return additive_operator< stencil_repeated<T>, vector<T> >(s, x);
+}
+
+/// Convolve the repeated stencil with the vector.
+template <typename T>
+additive_operator< stencil_repeated<T>, vector<T> >
+operator*( const vector<T> &x, const stencil_repeated<T> &s ) {
+    return additive_operator< stencil_repeated<T>, vector<T> >(s, x);
+}
+
+#ifdef VEXCL_MULTIVECTOR_HPP
+
+/// Convolve the repeated stencil with the multivector.
+template <typename T, size_t N>
+multiadditive_operator< stencil_repeated<T>, multivector<T, N> >
+operator*( const stencil_repeated<T> &s, const multivector<T, N> &x ) {
+    return multiadditive_operator< stencil_repeated<T>, multivector<T, N> >(s, x);
+}
+
+/// Convolve the repeated stencil with the multivector.
+template <typename T, size_t N>
+multiadditive_operator< stencil_repeated<T>, multivector<T, N> >
+operator*( const multivector<T, N> &x, const stencil_repeated<T> &s ) {
+    return multiadditive_operator< stencil_repeated<T>, multivector<T, N> >(s, x);
+}
+
+#endif
+
 /// Convolve the stencil with the vector.
 template <typename T>
 additive_operator< stencil<T>, vector<T> >
@@ -495,6 +967,472 @@ operator*( const multivector<T, N> &x, const stencil<T> &s ) {
 
 #endif
 
+/// Stencil on a structured 2D or 3D grid.
+/**
+ * The grid is stored in vex::vector in row-major order (the last dimension
+ * changes fastest). Stencil coefficients are given as a dense
+ * multidimensional array in the same order; zero coefficients may be used to
+ * express sparse stencils, e.g. the 5-point Laplace operator:
+ \code
+ vex::grid_stencil<double, 2> L(ctx, {ny, nx}, {3, 3}, {1, 1}, {
+          0,  1,  0,
+          1, -4,  1,
+          0,  1,  0
+          });
+
+ y = L * x;
+ \endcode
+ * Grid boundaries are handled by replicating boundary values, as in
+ * vex::stencil. Each workgroup loads a tile of the grid together with its
+ * halo into local memory. For multi-device contexts the vector is split along
+ * the slowest dimension, and each device receives a halo of about one plane
+ * (or row, in 2D case) per unit of stencil extent from its neighbours.
+ */
+template <typename T, size_t NDIM>
+class grid_stencil : private stencil_base<T> {
+    static_assert(NDIM >= 1 && NDIM <= 3, "Only 1D, 2D, and 3D grids are supported");
+    public:
+        typedef T value_type;
+
+        /// Constructor.
+        /**
+         * \param queue  vector of queues. Each queue represents one
+         *               compute device.
+         * \param grid   grid dimensions.
+         * \param width  stencil dimensions.
+         * \param center center of the stencil.
+         * \param st     stencil coefficients stored in row-major order.
+         */
+        grid_stencil(const std::vector<backend::command_queue> &queue,
+                const std::array<size_t, NDIM> &grid,
+                const std::array<size_t, NDIM> &width,
+                const std::array<size_t, NDIM> &center,
+                const std::vector<T> &st
+                )
+            : Base(queue, halo_width(grid, width, center), halo_center(grid, width, center), st.begin(), st.end()),
+              conv(queue.size()), smem(queue.size()), tile_x(queue.size())
+        {
+            init(grid, width, center, st.size());
+        }
+
+#ifndef BOOST_NO_INITIALIZER_LISTS
+        /// Constructor.
+        /**
+         * \param queue  vector of queues. Each queue represents one
+         *               compute device.
+         * \param grid   grid dimensions.
+         * \param width  stencil dimensions.
+         * \param center center of the stencil.
+         * \param list   intializer list holding stencil coefficients.
+         */
+        grid_stencil(const std::vector<backend::command_queue> &queue,
+                const std::array<size_t, NDIM> &grid,
+                const std::array<size_t, NDIM> &width,
+                const std::array<size_t, NDIM> &center,
+                std::initializer_list<T> list
+                )
+            : Base(queue, halo_width(grid, width, center), halo_center(grid, width, center), list.begin(), list.end()),
+              conv(queue.size()), smem(queue.size()), tile_x(queue.size())
+        {
+            init(grid, width, center, list.size());
+        }
+#endif
+
+        /// Convolve stencil with a vector.
+        /**
+         * y = alpha * conv(x) + y;
+         * \param x input vector.
+         * \param y output vector.
+         * \param alpha Scaling coefficient in front of y.
+         * \param append whether to append the result to the output vector
+         *               (alternative is to replace the output vector).
+         */
+        void apply(const vex::vector<T> &x, vex::vector<T> &y,
+                T alpha = 1, bool append = false) const;
+    private:
+        typedef stencil_base<T> Base;
+
+        using Base::queue;
+        using Base::dbuf;
+        using Base::s;
+        using Base::lhalo;
+        using Base::rhalo;
+
+        // Grid and stencil dimensions, padded to 3D (z, y, x).
+        int n[3], w[3], c[3];
+
+        mutable std::vector<backend::kernel> conv;
+        std::vector<size_t> smem;
+        std::vector<int>    tile_x;
+
+        // Linear distance to the farthest stencil point on the left and on
+        // the right. This is the halo size exchanged between devices.
+        static size_t linear_halo(
+                const std::array<size_t, NDIM> &grid,
+                const std::array<size_t, NDIM> &width,
+                const std::array<size_t, NDIM> &center,
+                bool left
+                )
+        {
+            size_t halo = 0, stride = 1;
+            for(size_t i = NDIM; i-- > 0; ) {
+                precondition(width[i] > 0 && center[i] < width[i],
+                        "Wrong stencil dimensions");
+                halo += stride * (left ? center[i] : width[i] - center[i] - 1);
+                stride *= grid[i];
+            }
+            return halo;
+        }
+
+        static unsigned halo_width(
+                const std::array<size_t, NDIM> &grid,
+                const std::array<size_t, NDIM> &width,
+                const std::array<size_t, NDIM> &center
+                )
+        {
+            return static_cast<unsigned>(
+                    linear_halo(grid, width, center, true) +
+                    linear_halo(grid, width, center, false) + 1);
+        }
+
+        static unsigned halo_center(
+                const std::array<size_t, NDIM> &grid,
+                const std::array<size_t, NDIM> &width,
+                const std::array<size_t, NDIM> &center
+                )
+        {
+            return static_cast<unsigned>(linear_halo(grid, width, center, true));
+        }
+
+        // Tile width along the fastest dimension for the given workgroup size.
+        static int tile_width(size_t wgs, int nx) {
+            int tx = static_cast<int>(std::min<size_t>(wgs, 32));
+            while(tx > 1 && tx / 2 >= nx) tx /= 2;
+            return tx;
+        }
+
+        void init(
+                const std::array<size_t, NDIM> &grid,
+                const std::array<size_t, NDIM> &width,
+                const std::array<size_t, NDIM> &center,
+                size_t size
+                );
+
+        static const detail::kernel_cache_entry& slow_conv(const backend::command_queue &queue);
+        static const detail::kernel_cache_entry& fast_conv(const backend::command_queue &queue);
+};
+
+/// \cond INTERNAL
+
+template <typename T, size_t NDIM>
+void grid_stencil<T, NDIM>::init(
+        const std::array<size_t, NDIM> &grid,
+        const std::array<size_t, NDIM> &width,
+        const std::array<size_t, NDIM> &center,
+        size_t size
+        )
+{
+    for(int i = 0; i < 3; ++i) {
+        n[i] = 1;
+        w[i] = 1;
+        c[i] = 0;
+    }
+
+    for(size_t i = 0; i < NDIM; ++i) {
+        n[3 - NDIM + i] = static_cast<int>(grid[i]);
+        w[3 - NDIM + i] = static_cast<int>(width[i]);
+        c[3 - NDIM + i] = static_cast<int>(center[i]);
+    }
+
+    precondition(size == static_cast<size_t>(w[0] * w[1] * w[2]),
+            "Number of stencil coefficients does not match stencil dimensions");
+
+    for (unsigned d = 0; d < queue.size(); d++) {
+        auto   fast_krn = fast_conv(queue[d]);
+        size_t max_smem = fast_krn.max_shared_memory_per_block(queue[d]);
+
+        int nx = n[2], wx = w[2], wy = w[1], wz = w[0];
+
+        auto smem_required = [nx, wx, wy, wz](size_t wgs) {
+            int tx = tile_width(wgs, nx);
+            int ty = static_cast<int>(wgs) / tx;
+            return sizeof(T) * (wx * wy * wz + wz * (ty + wy - 1) * (tx + wx - 1));
+        };
+
+        if (backend::is_cpu(queue[d]) || max_smem < smem_required(64)) {
+            conv[d] = slow_conv(queue[d]);
+            conv[d].config(queue[d], [](size_t){ return 0; });
+            smem[d]   = 0;
+            tile_x[d] = 0;
+        } else {
+            conv[d] = fast_krn;
+            conv[d].config(queue[d], smem_required);
+            smem[d]   = smem_required(conv[d].workgroup_size());
+            tile_x[d] = tile_width(conv[d].workgroup_size(), nx);
+        }
+    }
+}
+
+namespace detail {
+
+template <typename T>
+inline void grid_stencil_parameters(backend::source_generator &source) {
+    source
+        .template parameter<size_t>("n")
+        .template parameter<size_t>("start")
+        .template parameter<char>("has_left")
+        .template parameter<char>("has_right")
+        .template parameter<int>("lhalo")
+        .template parameter<int>("rhalo")
+        .template parameter<int>("nx")
+        .template parameter<int>("ny")
+        .template parameter<int>("nz")
+        .template parameter<int>("wx")
+        .template parameter<int>("wy")
+        .template parameter<int>("wz")
+        .template parameter<int>("cx")
+        .template parameter<int>("cy")
+        .template parameter<int>("cz")
+        .template parameter<int>("tx")
+        .template parameter<int>("z0")
+        .template parameter<int>("z1")
+        .template parameter< global_ptr<const T> >("s")
+        .template parameter< global_ptr<const T> >("xloc")
+        .template parameter< global_ptr<const T> >("xrem")
+        .template parameter< global_ptr<T> >("y")
+        .template parameter<T>("alpha")
+        .template parameter<T>("beta");
+}
+
+} // namespace detail
+
+template <typename T, size_t NDIM>
+const detail::kernel_cache_entry& grid_stencil<T, NDIM>::slow_conv(const backend::command_queue &queue) {
+    using namespace detail;
+
+    static kernel_cache cache;
+
+    auto key    = backend::cache_key(queue);
+    auto kernel = cache.find(key);
+
+    backend::select_context(queue);
+
+    if (kernel == cache.end()) {
+        backend::source_generator source(queue);
+
+        define_read_x<T>(source);
+
+        source.kernel("grid_slow_conv").open("(");
+        grid_stencil_parameters<T>(source);
+        source.close(")").open("{");
+
+        source.new_line() << "long plane = (long)nx * ny;";
+        source.grid_stride_loop().open("{");
+        source.new_line() << "long g = start + idx;";
+        source.new_line() << "int i = g % nx;";
+        source.new_line() << "int j = (g / nx) % ny;";
+        source.new_line() << "int k = g / plane;";
+        source.new_line() << type_name<T>() << " sum = 0;";
+        source.new_line() << "for(int kk = 0, p = 0; kk < wz; ++kk)";
+        source.open("{");
+        source.new_line() << "long gz = min(max(k + kk - cz, 0), nz - 1) * plane;";
+        source.new_line() << "for(int jj = 0; jj < wy; ++jj)";
+        source.open("{");
+        source.new_line() << "long gy = gz + (long)min(max(j + jj - cy, 0), ny - 1) * nx;";
+        source.new_line() << "for(int ii = 0; ii < wx; ++ii, ++p)";
+        source.open("{");
+        source.new_line() << "long gx = gy + min(max(i + ii - cx, 0), nx - 1);";
+        source.new_line() << "sum += s[p] * read_x(gx - (long)start, n, has_left, has_right, lhalo, rhalo, xloc, xrem);";
+        source.close("}").close("}").close("}");
+        source.new_line() << "if (alpha) y[idx] = alpha * y[idx] + beta * sum;";
+        source.new_line() << "else y[idx] = beta * sum;";
+        source.close("}").close("}");
+
+        backend::kernel krn(queue, source.str(), "grid_slow_conv");
+        kernel = cache.insert(std::make_pair(key, krn)).first;
+    }
+
+    return kernel->second;
+}
+
+template <typename T, size_t NDIM>
+const detail::kernel_cache_entry& grid_stencil<T, NDIM>::fast_conv(const backend::command_queue &queue) {
+    using namespace detail;
+
+    static kernel_cache cache;
+
+    auto key    = backend::cache_key(queue);
+    auto kernel = cache.find(key);
+
+    backend::select_context(queue);
+
+    if (kernel == cache.end()) {
+        backend::source_generator source(queue);
+
+        define_read_x<T>(source);
+
+        source.kernel("grid_fast_conv").open("(");
+        grid_stencil_parameters<T>(source);
+        source.template smem_parameter<T>();
+        source.close(")").open("{");
+
+        source.smem_declaration<T>();
+        source.new_line() << type_name< shared_ptr<T> >() << " S = smem;";
+        source.new_line() << type_name< shared_ptr<T> >() << " X = smem + wx * wy * wz;";
+
+        source.new_line() << "int l_id = " << source.local_id(0) << ";";
+        source.new_line() << "int block_size = " << source.local_size(0) << ";";
+        source.new_line() << "long num_groups = " << source.global_size(0) << " / block_size;";
+
+        // Workgroup is mapped to a (ty x tx) tile in a single xy-plane.
+        source.new_line() << "int ty = block_size / tx;";
+        source.new_line() << "int lx = l_id % tx;";
+        source.new_line() << "int ly = l_id / tx;";
+        source.new_line() << "int mx = tx + wx - 1;";
+        source.new_line() << "int my = ty + wy - 1;";
+        source.new_line() << "int ntx = (nx + tx - 1) / tx;";
+        source.new_line() << "int nty = (ny + ty - 1) / ty;";
+        source.new_line() << "long plane = (long)nx * ny;";
+        source.new_line() << "long tiles = (long)(z1 - z0 + 1) * nty * ntx;";
+
+        source.new_line() << "for(int i = l_id; i < wx * wy * wz; i += block_size) S[i] = s[i];";
+
+        source.new_line() << "for(long t = " << source.group_id(0) << "; t < tiles; t += num_groups)";
+        source.open("{");
+        source.new_line() << "int x0 = (t % ntx) * tx;";
+        source.new_line() << "int y0 = ((t / ntx) % nty) * ty;";
+        source.new_line() << "int z  = z0 + t / ((long)ntx * nty);";
+
+        // Skip tiles that do not intersect with the local part.
+        source.new_line() << "long first = z * plane + (long)y0 * nx + x0 - (long)start;";
+        source.new_line() << "long last  = z * plane + (long)(min(y0 + ty, ny) - 1) * nx + min(x0 + tx, nx) - 1 - (long)start;";
+        source.new_line() << "if (last < 0 || first >= (long)n) continue;";
+
+        source.new_line() << "for(int i = l_id; i < wz * my * mx; i += block_size)";
+        source.open("{");
+        source.new_line() << "int ii = i % mx;";
+        source.new_line() << "int jj = (i / mx) % my;";
+        source.new_line() << "int kk = i / (mx * my);";
+        source.new_line() << "long g = min(max(z + kk - cz, 0), nz - 1) * plane"
+            " + (long)min(max(y0 + jj - cy, 0), ny - 1) * nx"
+            " + min(max(x0 + ii - cx, 0), nx - 1);";
+        source.new_line() << "X[i] = read_x(g - (long)start, n, has_left, has_right, lhalo, rhalo, xloc, xrem);";
+        source.close("}");
+        source.new_line().barrier();
+
+        source.new_line() << "long g = first + (long)ly * nx + lx;";
+        source.new_line() << "if (x0 + lx < nx && y0 + ly < ny && g >= 0 && g < (long)n)";
+        source.open("{");
+        source.new_line() << type_name<T>() << " sum = 0;";
+        source.new_line() << "for(int kk = 0, p = 0; kk < wz; ++kk)";
+        source.open("{");
+        source.new_line() << "for(int jj = 0; jj < wy; ++jj)";
+        source.open("{");
+        source.new_line() << type_name< shared_ptr<T> >() << " Xr = X + (kk * my + ly + jj) * mx + lx;";
+        source.new_line() << "for(int ii = 0; ii < wx; ++ii, ++p) sum += S[p] * Xr[ii];";
+        source.close("}").close("}");
+        source.new_line() << "if (alpha) y[g] = alpha * y[g] + beta * sum;";
+        source.new_line() << "else y[g] = beta * sum;";
+        source.close("}");
+        source.new_line().barrier();
+        source.close("}").close("}");
+
+        backend::kernel krn(queue, source.str(), "grid_fast_conv");
+        kernel = cache.insert(std::make_pair(key, krn)).first;
+    }
+
+    return kernel->second;
+}
+
+template <typename T, size_t NDIM>
+void grid_stencil<T, NDIM>::apply(const vex::vector<T> &x, vex::vector<T> &y,
+        T alpha, bool append) const
+{
+    precondition(x.size() == static_cast<size_t>(n[0]) * n[1] * n[2],
+            "Vector size does not match grid dimensions");
+
+    Base::exchange_halos(x);
+
+    T beta = static_cast<T>(append ? 1 : 0);
+
+    size_t plane = static_cast<size_t>(n[1]) * n[2];
+
+    for(unsigned d = 0; d < queue.size(); d++) {
+        if (size_t psize = x.part_size(d)) {
+            size_t start = x.part_start(d);
+
+            char has_left  = d > 0;
+            char has_right = d + 1 < queue.size();
+
+            int z0 = static_cast<int>(start / plane);
+            int z1 = static_cast<int>((start + psize - 1) / plane);
+
+            conv[d].push_arg(psize);
+            conv[d].push_arg(start);
+            conv[d].push_arg(has_left);
+            conv[d].push_arg(has_right);
+            conv[d].push_arg(lhalo);
+            conv[d].push_arg(rhalo);
+            conv[d].push_arg(n[2]);
+            conv[d].push_arg(n[1]);
+            conv[d].push_arg(n[0]);
+            conv[d].push_arg(w[2]);
+            conv[d].push_arg(w[1]);
+            conv[d].push_arg(w[0]);
+            conv[d].push_arg(c[2]);
+            conv[d].push_arg(c[1]);
+            conv[d].push_arg(c[0]);
+            conv[d].push_arg(tile_x[d]);
+            conv[d].push_arg(z0);
+            conv[d].push_arg(z1);
+            conv[d].push_arg(s[d]);
+            conv[d].push_arg(x(d));
+            conv[d].push_arg(dbuf[d]);
+            conv[d].push_arg(y(d));
+            conv[d].push_arg(beta);
+            conv[d].push_arg(alpha);
+
+            if (smem[d]) conv[d].set_smem([&](size_t){ return smem[d]; });
+
+            conv[d](queue[d]);
+        }
+    }
+}
+
+/// \endcond
+
+/// Convolve the grid stencil with the vector.
+template <typename T, size_t NDIM>
+additive_operator< grid_stencil<T, NDIM>, vector<T> >
+operator*( const grid_stencil<T, NDIM> &s, const vector<T> &x ) {
+    return additive_operator< grid_stencil<T, NDIM>, vector<T> >(s, x);
+}
+
+/// Convolve the grid stencil with the vector.
+template <typename T, size_t NDIM>
+additive_operator< grid_stencil<T, NDIM>, vector<T> >
+operator*( const vector<T> &x, const grid_stencil<T, NDIM> &s ) {
+    return additive_operator< grid_stencil<T, NDIM>, vector<T> >(s, x);
+}
+
+#ifdef VEXCL_MULTIVECTOR_HPP
+
+/// Convolve the grid stencil with the multivector.
+template <typename T, size_t NDIM, size_t N>
+multiadditive_operator< grid_stencil<T, NDIM>, multivector<T, N> >
+operator*( const grid_stencil<T, NDIM> &s, const multivector<T, N> &x ) {
+    return multiadditive_operator< grid_stencil<T, NDIM>, multivector<T, N> >(s, x);
+}
+
+/// Convolve the grid stencil with the multivector.
+template <typename T, size_t NDIM, size_t N>
+multiadditive_operator< grid_stencil<T, NDIM>, multivector<T, N> >
+operator*( const multivector<T, N> &x, const grid_stencil<T, NDIM> &s ) {
+    return multiadditive_operator< grid_stencil<T, NDIM>, multivector<T, N> >(s, x);
+}
+
+#endif
+
 /// User-defined stencil operator
 /**
  * Is used to define custom stencil operator. For example, to implement the
@@ -559,7 +1497,10 @@ void StencilOperator<T, width, center, Impl>::apply(
     static kernel_cache cache;
     static std::map<backend::kernel_cache_key, size_t> lmem;
 
-    Base::exchange_halos(x);
+    Base::start_exchange(x);
+
+    std::vector<backend::kernel*> conv(queue.size());
+    std::vector<size_t> smem_bytes(queue.size());
 
     for(unsigned d = 0; d < queue.size(); d++) {
         backend::select_context(queue[d]);
@@ -582,6 +1523,8 @@ void StencilOperator<T, width, center, Impl>::apply(
             source.kernel("convolve")
                 .open("(")
                     .template parameter<size_t>("n")
+                    .template parameter<size_t>("begin")
+                    .template parameter<size_t>("end")
                     .template parameter<char>("has_left")
                     .template parameter<char>("has_right")
                     .template parameter<int>("lhalo")
@@ -600,15 +1543,15 @@ void StencilOperator<T, width, center, Impl>::apply(
             source.new_line() << "size_t grid_size = " << source.global_size(0) << ";";
             source.new_line() << "int l_id = " << source.local_id(0) << ";";
             source.new_line() << "int block_size = " << source.local_size(0) << ";";
-            source.new_line() << "for(long g_id = " << source.global_id(0)
-                << ", pos = 0; pos < n; g_id += grid_size, pos += grid_size)";
+            source.new_line() << "for(long g_id = begin + " << source.global_id(0)
+                << ", pos = begin; pos < end; g_id += grid_size, pos += grid_size)";
             source.open("{");
             source.new_line() << "for(int i = l_id, j = g_id - lhalo; i < block_size + lhalo + rhalo; i += block_size, j += block_size)";
             source.open("{");
             source.new_line() << "X[i] = read_x(j, n, has_left, has_right, lhalo, rhalo, xloc, xrem);";
             source.close("}");
             source.new_line().barrier();
-            source.new_line() << "if (g_id < n)";
+            source.new_line() << "if (g_id < end)";
             source.open("{");
             source.new_line() << type_name<T>() << " sum = stencil_oper(X + lhalo + l_id);";
             source.new_line() << "if (alpha) y[g_id] = alpha * y[g_id] + beta * sum;";
@@ -625,25 +1568,56 @@ void StencilOperator<T, width, center, Impl>::apply(
             lmem[key] = sizeof(T) * (krn.workgroup_size() + width - 1);
         }
 
+        conv[d]        = &kernel->second;
+        smem_bytes[d] = lmem[key];
+    }
+
+    auto convolve = [&](unsigned d, size_t begin, size_t end) {
+        char has_left  = d > 0;
+        char has_right = d + 1 < queue.size();
+
+        conv[d]->push_arg(x.part_size(d));
+        conv[d]->push_arg(begin);
+        conv[d]->push_arg(end);
+        conv[d]->push_arg(has_left);
+        conv[d]->push_arg(has_right);
+        conv[d]->push_arg(lhalo);
+        conv[d]->push_arg(rhalo);
+        conv[d]->push_arg(x(d));
+        conv[d]->push_arg(dbuf[d]);
+        conv[d]->push_arg(y(d));
+        conv[d]->push_arg(beta);
+        conv[d]->push_arg(alpha);
+
+        size_t bytes = smem_bytes[d];
+        conv[d]->set_smem([bytes](size_t){ return bytes; });
+
+        (*conv[d])(queue[d]);
+    };
+
+    // Interior points do not depend on halos and are processed while the
+    // halos are in flight.
+    std::vector<size_t> ibeg(queue.size()), iend(queue.size());
+
+    for(unsigned d = 0; d < queue.size(); d++) {
         if (size_t psize = x.part_size(d)) {
-            char has_left  = d > 0;
-            char has_right = d + 1 < queue.size();
+            ibeg[d] = d > 0                ? std::min<size_t>(lhalo, psize)  : 0;
+            iend[d] = d + 1 < queue.size() ? psize - std::min<size_t>(rhalo, psize) : psize;
+
+            if (ibeg[d] < iend[d]) convolve(d, ibeg[d], iend[d]);
+        }
+    }
 
-            kernel->second.push_arg(psize);
-            kernel->second.push_arg(has_left);
-            kernel->second.push_arg(has_right);
-            kernel->second.push_arg(lhalo);
-            kernel->second.push_arg(rhalo);
-            kernel->second.push_arg(x(d));
-            kernel->second.push_arg(dbuf[d]);
-            kernel->second.push_arg(y(d));
-            kernel->second.push_arg(beta);
-            kernel->second.push_arg(alpha);
-
-            size_t smem_bytes = lmem[key];
-            kernel->second.set_smem([smem_bytes](size_t){ return smem_bytes; });
-
-            kernel->second(queue[d]);
+    Base::finish_exchange();
+
+    for(unsigned d = 0; d < queue.size(); d++) {
+        if (size_t psize = x.part_size(d)) {
+            if (ibeg[d] >= iend[d]) {
+                convolve(d, 0, psize);
+            } else {
+                if (ibeg[d] > 0)     convolve(d, 0, ibeg[d]);
+                if (iend[d] < psize) convolve(d, iend[d], psize);
+            }
         }
     }
 }
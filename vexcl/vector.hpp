@@ -794,6 +794,8 @@ class vector : public vector_terminal_expression {
         std::vector< backend::device_vector<T> > buf;
 
         void allocate_buffers(backend::mem_flags flags, const T *hostptr) {
+            memory_owner owner("vector");
+
             buf.clear();
             buf.reserve(queue.size());
 
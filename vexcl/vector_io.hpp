@@ -0,0 +1,250 @@
+#ifndef VEXCL_VECTOR_IO_HPP
+#define VEXCL_VECTOR_IO_HPP
+
+/*
+The MIT License
+
+Copyright (c) 2012-2014 Denis Demidov <dennis.demidov@gmail.com>
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in
+all copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+THE SOFTWARE.
+*/
+
+/**
+ * \file   vexcl/vector_io.hpp
+ * \author Denis Demidov <dennis.demidov@gmail.com>
+ * \brief  Saving and loading vectors to/from memory-mapped files.
+ */
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <cstring>
+
+#include <boost/interprocess/file_mapping.hpp>
+#include <boost/interprocess/mapped_region.hpp>
+
+#include <vexcl/vector.hpp>
+#include <vexcl/multivector.hpp>
+
+namespace vex {
+
+/// \cond INTERNAL
+namespace detail {
+
+// Binary vector file layout:
+//   header;
+//   partition boundaries at save time (parts + 1 values);
+//   components one after another, starting at 64-byte aligned offset.
+struct vector_file_header {
+    char     magic[8];
+    cl_uint  version;
+    cl_uint  value_size;
+    char     value_type[32];
+    cl_ulong size;
+    cl_ulong components;
+    cl_ulong parts;
+};
+
+inline size_t vector_file_data_offset(size_t parts) {
+    size_t bytes = sizeof(vector_file_header) + (parts + 1) * sizeof(cl_ulong);
+    return (bytes + 63) / 64 * 64;
+}
+
+template <typename T>
+void save_vectors(const std::string &fname, const std::vector<const vector<T>*> &vec) {
+    namespace ip = boost::interprocess;
+
+    const vector<T> &x0 = *vec.front();
+
+    const std::vector<backend::command_queue> &queue = x0.queue_list();
+
+    precondition(!queue.empty(), "Vector has no queues");
+
+    const size_t n      = x0.size();
+    const size_t offset = vector_file_data_offset(queue.size());
+    const size_t bytes  = offset + vec.size() * n * sizeof(T);
+
+    // Create the file of the required size.
+    {
+        std::filebuf f;
+        precondition(
+                f.open(fname.c_str(), std::ios_base::out | std::ios_base::trunc | std::ios_base::binary) != 0,
+                "Can not open " + fname + " for writing");
+        f.pubseekoff(bytes - 1, std::ios_base::beg);
+        f.sputc(0);
+    }
+
+    ip::file_mapping  file(fname.c_str(), ip::read_write);
+    ip::mapped_region region(file, ip::read_write);
+
+    char *ptr = static_cast<char*>(region.get_address());
+
+    vector_file_header h;
+    std::memset(&h, 0, sizeof(h));
+    std::memcpy(h.magic, "VEXCLVEC", 8);
+    std::strncpy(h.value_type, type_name<T>().c_str(), sizeof(h.value_type) - 1);
+
+    h.version    = 1;
+    h.value_size = sizeof(T);
+    h.size       = n;
+    h.components = vec.size();
+    h.parts      = queue.size();
+
+    std::memcpy(ptr, &h, sizeof(h));
+
+    for(unsigned d = 0; d <= queue.size(); ++d) {
+        cl_ulong p = x0.partition()[d];
+        std::memcpy(ptr + sizeof(h) + d * sizeof(p), &p, sizeof(p));
+    }
+
+    // Device partitions are transferred directly to the mapped file pages,
+    // concurrently for all devices.
+    T *data = reinterpret_cast<T*>(ptr + offset);
+
+    for(size_t i = 0; i < vec.size(); ++i) {
+        precondition(vec[i]->size() == n, "Components have different sizes");
+
+        for(unsigned d = 0; d < queue.size(); ++d)
+            (*vec[i])(d).read(queue[d], 0, vec[i]->part_size(d),
+                    data + i * n + vec[i]->part_start(d));
+    }
+
+    for(unsigned d = 0; d < queue.size(); ++d) queue[d].finish();
+
+    region.flush();
+}
+
+template <typename T>
+void load_vectors(const std::string &fname, const std::vector<vector<T>*> &vec,
+        const std::vector<backend::command_queue> &queue)
+{
+    namespace ip = boost::interprocess;
+
+    ip::file_mapping  file(fname.c_str(), ip::read_only);
+    ip::mapped_region region(file, ip::read_only);
+
+    const char *ptr = static_cast<const char*>(region.get_address());
+
+    vector_file_header h;
+
+    precondition(region.get_size() >= sizeof(h), fname + " is not a vector file");
+    std::memcpy(&h, ptr, sizeof(h));
+
+    // The file may be damaged or foreign.
+    h.value_type[sizeof(h.value_type) - 1] = 0;
+
+    precondition(std::memcmp(h.magic, "VEXCLVEC", 8) == 0 && h.version == 1,
+            fname + " is not a vector file");
+
+    precondition(h.value_size == sizeof(T) &&
+            std::string(h.value_type) == type_name<T>(),
+            fname + " holds values of type " + std::string(h.value_type));
+
+    precondition(h.components == vec.size(),
+            fname + " holds wrong number of components");
+
+    const size_t n      = h.size;
+    const size_t offset = vector_file_data_offset(h.parts);
+
+    precondition(region.get_size() >= offset + vec.size() * n * sizeof(T),
+            fname + " is truncated");
+
+    // The data is sent to the devices straight from the mapped pages. The
+    // current partitioning is used, since partitions are contiguous ranges.
+    const T *data = reinterpret_cast<const T*>(ptr + offset);
+
+    for(size_t i = 0; i < vec.size(); ++i) {
+        // Queue lists of the same length may still differ, so the vectors
+        // are always reallocated on the given queues.
+        vec[i]->resize(queue, n);
+
+        for(unsigned d = 0; d < queue.size(); ++d)
+            (*vec[i])(d).write(queue[d], 0, vec[i]->part_size(d),
+                    data + i * n + vec[i]->part_start(d));
+    }
+
+    // The pages should stay mapped until the transfers are complete.
+    for(unsigned d = 0; d < queue.size(); ++d) queue[d].finish();
+}
+
+} // namespace detail
+/// \endcond
+
+/// Saves vector to a binary file.
+/**
+ * The file consists of a header (value type, size, and partitioning), and
+ * the vector data. Each device partition is transferred directly to the
+ * memory-mapped file, so no intermediate host copy of the vector is made.
+ */
+template <typename T>
+void save(const vector<T> &x, const std::string &fname) {
+    detail::save_vectors(fname, std::vector<const vector<T>*>(1, &x));
+}
+
+/// Saves multivector to a binary file.
+template <typename T, size_t N>
+void save(const multivector<T, N> &x, const std::string &fname) {
+    std::vector<const vector<T>*> vec(N);
+    for(size_t i = 0; i < N; ++i) vec[i] = &x(i);
+    detail::save_vectors(fname, vec);
+}
+
+/// Loads vector from a binary file created with vex::save().
+/**
+ * The vector is resized to the size stored in the file and partitioned
+ * across the given queues. The data is transferred to the devices directly
+ * from the memory-mapped file.
+ */
+template <typename T>
+void load(vector<T> &x, const std::vector<backend::command_queue> &queue,
+        const std::string &fname)
+{
+    detail::load_vectors(fname, std::vector<vector<T>*>(1, &x), queue);
+}
+
+/// Loads vector from a binary file created with vex::save().
+/**
+ * The vector keeps its queue list.
+ */
+template <typename T>
+void load(vector<T> &x, const std::string &fname) {
+    precondition(!x.queue_list().empty(), "Vector has no queues");
+    load(x, std::vector<backend::command_queue>(x.queue_list()), fname);
+}
+
+/// Loads multivector from a binary file created with vex::save().
+template <typename T, size_t N>
+void load(multivector<T, N> &x, const std::vector<backend::command_queue> &queue,
+        const std::string &fname)
+{
+    std::vector<vector<T>*> vec(N);
+    for(size_t i = 0; i < N; ++i) vec[i] = &x(i);
+    detail::load_vectors(fname, vec, queue);
+}
+
+/// Loads multivector from a binary file created with vex::save().
+template <typename T, size_t N>
+void load(multivector<T, N> &x, const std::string &fname) {
+    precondition(!x.queue_list().empty(), "Multivector has no queues");
+    load(x, std::vector<backend::command_queue>(x.queue_list()), fname);
+}
+
+} // namespace vex
+
+#endif
@@ -55,6 +55,7 @@ THE SOFTWARE.
 #include <vexcl/sort.hpp>
 #include <vexcl/scan.hpp>
 #include <vexcl/reduce_by_key.hpp>
+#include <vexcl/compact.hpp>
 #include <vexcl/profiler.hpp>
 
 #endif